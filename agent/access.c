@@ -0,0 +1,201 @@
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <netinet/in.h>
+
+#include <abz/error.h>
+#include <debug/memory.h>
+
+#include "agent.h"
+#include "access.h"
+#include "fnv.h"
+
+struct access_prefix
+{
+   uint32_t address;				/* network byte order		*/
+   uint8_t length;
+   const struct allow *allow;		/* NULL if the slot is empty	*/
+};
+
+static uint32_t access_prefix_hash (uint32_t address,uint8_t length)
+{
+   return ((address ^ (length * 0x9e3779b9U)) * 0x85ebca6bU >> 7);
+}
+
+static __inline__ uint32_t access_netmask (uint8_t length)
+{
+   return (length ? htonl (~0U << (32 - length)) : 0);
+}
+
+static uint32_t access_buckets (size_t n)
+{
+   uint32_t size;
+
+   /* keep the tables at most half full */
+   for (size = 1; size < n * 2; size <<= 1) ;
+
+   return (size);
+}
+
+/*
+ * The configuration parser only accepts contiguous netmasks and
+ * addresses without any host bits set.
+ */
+static void access_add_prefix (struct access *access,const struct allow *allow,uint8_t *seen)
+{
+   uint32_t netmask = ntohl (allow->network.netmask),address = allow->network.address,i;
+   uint8_t length = 0;
+
+   while (length < 32 && (netmask & (0x80000000U >> length)))
+	 length++;
+
+   for (i = access_prefix_hash (address,length) & access->pmask;
+		access->prefix[i].allow != NULL;
+		i = (i + 1) & access->pmask)
+	 if (access->prefix[i].address == address && access->prefix[i].length == length)
+	   return;
+
+   access->prefix[i].address = address;
+   access->prefix[i].length = length;
+   access->prefix[i].allow = allow;
+   seen[length] = 1;
+}
+
+static int access_add_community (struct access *access,const struct community *community)
+{
+   uint32_t i;
+
+   for (i = fnv_hash ((const uint8_t *) community->name,community->len) & access->cmask;
+		access->community[i] != NULL;
+		i = (i + 1) & access->cmask)
+	 if (access->community[i]->len == community->len &&
+		 !memcmp (access->community[i]->name,community->name,community->len))
+	   {
+		  abz_set_error ("community `%s' defined more than once",community->name);
+		  return (-1);
+	   }
+
+   access->community[i] = community;
+
+   return (0);
+}
+
+int access_create (struct access *access,const struct allow *allow,const struct community *community)
+{
+   const struct allow *a;
+   const struct community *c;
+   uint8_t seen[33];
+   size_t n;
+   int i;
+
+   abz_clear_error ();
+
+   memset (access,0L,sizeof (struct access));
+   memset (seen,0L,sizeof (seen));
+
+   for (n = 0, a = allow; a != NULL; a = a->next) n++;
+   access->pmask = access_buckets (n) - 1;
+
+   for (n = 0, c = community; c != NULL; c = c->next) n++;
+   access->cmask = access_buckets (n) - 1;
+
+   if ((access->prefix = mem_alloc ((access->pmask + 1) * sizeof (struct access_prefix))) == NULL ||
+	   (access->community = mem_alloc ((access->cmask + 1) * sizeof (struct community *))) == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		access_destroy (access);
+		return (-1);
+	 }
+
+   memset (access->prefix,0L,(access->pmask + 1) * sizeof (struct access_prefix));
+   memset (access->community,0L,(access->cmask + 1) * sizeof (struct community *));
+
+   for (a = allow; a != NULL; a = a->next)
+	 access_add_prefix (access,a,seen);
+
+   for (c = community; c != NULL; c = c->next)
+	 if (access_add_community (access,c))
+	   {
+		  access_destroy (access);
+		  return (-1);
+	   }
+
+   for (i = 32; i >= 0; i--)
+	 if (seen[i])
+	   access->length[access->nlength++] = i;
+
+   return (0);
+}
+
+void access_destroy (struct access *access)
+{
+   if (access->prefix != NULL)
+	 mem_free (access->prefix);
+
+   if (access->community != NULL)
+	 mem_free (access->community);
+
+   memset (access,0L,sizeof (struct access));
+}
+
+const struct allow *access_allow (const struct access *access,uint32_t address)
+{
+   uint32_t i,j,masked;
+
+   for (j = 0; j < access->nlength; j++)
+	 {
+		masked = address & access_netmask (access->length[j]);
+
+		for (i = access_prefix_hash (masked,access->length[j]) & access->pmask;
+			 access->prefix[i].allow != NULL;
+			 i = (i + 1) & access->pmask)
+		  if (access->prefix[i].address == masked && access->prefix[i].length == access->length[j])
+			return (access->prefix[i].allow);
+	 }
+
+   return (NULL);
+}
+
+const struct community *access_community (const struct access *access,const octet_string_t *name)
+{
+   uint32_t i;
+
+   for (i = fnv_hash (name->buf,name->len) & access->cmask;
+		access->community[i] != NULL;
+		i = (i + 1) & access->cmask)
+	 if (access->community[i]->len == name->len &&
+		 !memcmp (access->community[i]->name,name->buf,name->len))
+	   return (access->community[i]);
+
+   return (NULL);
+}
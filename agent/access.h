@@ -0,0 +1,86 @@
+#ifndef ACCESS_H
+#define ACCESS_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <tinysnmp/tinysnmp.h>
+
+struct allow;
+struct community;
+struct access_prefix;
+
+/*
+ * The allow and community statements compiled into hash tables, so
+ * that checking a packet doesn't depend on the number of statements.
+ * Allowed networks are hashed by address and prefix length and
+ * looked up from the longest prefix to the shortest. Communities are
+ * hashed by name. Nothing changes once the tables are built, so all
+ * the listeners can share them without locking.
+ */
+struct access
+{
+   struct access_prefix *prefix;
+   uint32_t pmask;					/* number of prefix buckets - 1		*/
+   uint8_t length[33];				/* prefix lengths, longest first	*/
+   uint32_t nlength;
+   const struct community **community;
+   uint32_t cmask;					/* number of community buckets - 1	*/
+};
+
+/*
+ * Build the tables from the allow and community statements. Networks
+ * must have contiguous netmasks and no host bits set (the configuration
+ * parser checks that), and community strings must be unique.
+ * Returns 0 if successful, -1 if some error occurred. Call
+ * abz_get_error() to retrieve the error message.
+ */
+extern int access_create (struct access *access,const struct allow *allow,const struct community *community);
+
+/*
+ * Free all memory allocated for the tables.
+ */
+extern void access_destroy (struct access *access);
+
+/*
+ * Find the allow statement with the longest prefix matching the
+ * address (in network byte order). Returns NULL if the address isn't
+ * allowed.
+ */
+extern const struct allow *access_allow (const struct access *access,uint32_t address);
+
+/*
+ * Find the community with the specified name. Returns NULL if there
+ * is no such community.
+ */
+extern const struct community *access_community (const struct access *access,const octet_string_t *name);
+
+#endif	/* #ifndef ACCESS_H */
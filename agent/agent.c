@@ -32,6 +32,7 @@
 #include <pwd.h>
 #include <grp.h>
 #include <sys/types.h>
+#include <netinet/in.h>
 
 #include <debug/memory.h>
 
@@ -44,6 +45,8 @@
 
 #include "agent.h"
 #include "module.h"
+#include "network.h"
+#include "snmp.h"
 
 #define IGNORE	0x01
 #define ACCEPT	0x02
@@ -87,13 +90,34 @@ void agent_destroy (struct agent *agent)
 		mem_free (allow);
 	 }
 
-   if (agent->community != NULL)
-	 mem_free (agent->community);
+   while (agent->community != NULL)
+	 {
+		struct community *community = agent->community;
+
+		agent->community = agent->community->next;
+		mem_free (community->name);
+
+		if (community->view != NULL)
+		  mem_free (community->view);
+
+		mem_free (community);
+	 }
+
+   while (agent->sink != NULL)
+	 {
+		struct sink *sink = agent->sink;
+
+		agent->sink = agent->sink->next;
+		mem_free (sink->community);
+		mem_free (sink);
+	 }
+
+   access_destroy (&agent->access);
 }
 
 static int agent_parse_end (struct agent *agent)
 {
-   const char *missing;
+   const char *missing,*name;
 
    if (agent->parse_module != NULL)
 	 {
@@ -117,7 +141,22 @@ static int agent_parse_end (struct agent *agent)
 		return (-1);
 	 }
 
-   return (0);
+   /*
+	* Without a cache, modules are updated while looking up ObjectID's,
+	* which isn't safe if more than one thread does that. A lifetime
+	* set for a module or its subtree is as good as the default one.
+	*/
+
+   if (agent->listeners > 1 && (name = module_uncached (agent->timeout)) != NULL)
+	 {
+		abz_set_error ("module %s needs a cache lifetime if more than one listener is used",name);
+		return (-1);
+	 }
+
+   if (!agent->response)
+	 agent->response = SNMP_RESPONSE_DEFAULT;
+
+   return (access_create (&agent->access,agent->allow,agent->community));
 }
 
 static int parse_user (struct agent *agent,struct tokens *tokens)
@@ -247,6 +286,7 @@ static int parse_listen (struct agent *agent,struct tokens *tokens)
 static int parse_allow (struct agent *agent,struct tokens *tokens)
 {
    struct allow *allow;
+   uint32_t netmask;
 
    if (tokens->argc != 2)
 	 {
@@ -269,6 +309,23 @@ static int parse_allow (struct agent *agent,struct tokens *tokens)
 		return (-1);
 	 }
 
+   /* networks are looked up by prefix, so the netmask has to be one */
+   netmask = ntohl (allow->network.netmask);
+
+   if (~netmask & (~netmask + 1))
+	 {
+		abz_set_error ("non-contiguous netmask %u.%u.%u.%u",NIPQUAD (allow->network.netmask));
+		mem_free (allow);
+		return (-1);
+	 }
+
+   if (allow->network.address & ~allow->network.netmask)
+	 {
+		abz_set_error ("host bits set in %s",tokens->argv[1]);
+		mem_free (allow);
+		return (-1);
+	 }
+
    if (agent->allow != NULL)
 	 {
 		struct allow *tmp = agent->allow;
@@ -283,36 +340,197 @@ static int parse_allow (struct agent *agent,struct tokens *tokens)
    return (0);
 }
 
-static int parse_community (struct agent *agent,struct tokens *tokens)
+static int add_community (struct agent *agent,struct tokens *tokens,int writable)
 {
+   struct community *community;
+
+   if (tokens->argc != 2 && tokens->argc != 3)
+	 {
+		parse_error (tokens,"<community-string> [<subtree>]");
+		return (-1);
+	 }
+
+   if ((community = mem_alloc (sizeof (struct community))) == NULL)
+	 {
+		out_of_memory ();
+		return (-1);
+	 }
+
+   memset (community,0L,sizeof (struct community));
+
+   if (tokens->argc == 3 && (community->view = makeoid (tokens->argv[2])) == NULL)
+	 {
+		mem_free (community);
+		return (-1);
+	 }
+
+   community->len = strlen (tokens->argv[1]);
+   community->writable = writable;
+
+   if ((community->name = mem_alloc (community->len + 1)) == NULL)
+	 {
+		out_of_memory ();
+
+		if (community->view != NULL)
+		  mem_free (community->view);
+
+		mem_free (community);
+		return (-1);
+	 }
+
+   strcpy (community->name,tokens->argv[1]);
+
    if (agent->community != NULL)
 	 {
-		already_defined (tokens);
+		struct community *tmp = agent->community;
+
+		while (tmp->next != NULL)
+		  tmp = tmp->next;
+
+		tmp->next = community;
+	 }
+   else agent->community = community;
+
+   return (0);
+}
+
+static int parse_community (struct agent *agent,struct tokens *tokens)
+{
+   return (add_community (agent,tokens,0));
+}
+
+static int parse_rwcommunity (struct agent *agent,struct tokens *tokens)
+{
+   return (add_community (agent,tokens,1));
+}
+
+static int parse_sink (struct agent *agent,struct tokens *tokens,int inform)
+{
+   struct sink *sink;
+
+   if (tokens->argc != 3)
+	 {
+		parse_error (tokens,"{ <host> | <addr> } [ : { <service> | <port> } ] <community-string>");
 		return (-1);
 	 }
 
-   if (tokens->argc != 2)
+   if ((sink = mem_alloc (sizeof (struct sink))) == NULL)
 	 {
-		parse_error (tokens,"<community-string>");
+		out_of_memory ();
 		return (-1);
 	 }
 
-   if ((agent->community = mem_alloc (strlen (tokens->argv[1]) + 1)) == NULL)
-     {
+   memset (sink,0L,sizeof (struct sink));
+
+   if (atos (&sink->addr,tokens->argv[1]))
+	 {
+		abz_set_error ("failed to parse %s: %m",tokens->argv[1]);
+		mem_free (sink);
+		return (-1);
+	 }
+
+   if (!sink->addr.sin_port)
+	 {
+#ifdef GETSERVBYNAME
+		if (atop (&sink->addr.sin_port,"snmp-trap"))
+#endif	/* #ifdef GETSERVBYNAME */
+		  sink->addr.sin_port = htons (162);
+	 }
+
+   if ((sink->community = mem_alloc (strlen (tokens->argv[2]) + 1)) == NULL)
+	 {
 		out_of_memory ();
+		mem_free (sink);
 		return (-1);
 	 }
 
-   strcpy (agent->community,tokens->argv[1]);
+   strcpy (sink->community,tokens->argv[2]);
+   sink->inform = inform;
+
+   if (agent->sink != NULL)
+	 {
+		struct sink *tmp = agent->sink;
+
+		while (tmp->next != NULL)
+		  tmp = tmp->next;
+
+		tmp->next = sink;
+	 }
+   else agent->sink = sink;
 
    return (0);
 }
 
+static int parse_trapsink (struct agent *agent,struct tokens *tokens)
+{
+   return (parse_sink (agent,tokens,0));
+}
+
+static int parse_informsink (struct agent *agent,struct tokens *tokens)
+{
+   return (parse_sink (agent,tokens,1));
+}
+
 static int parse_cache (struct agent *agent,struct tokens *tokens)
+{
+   uint32_t value,*oid;
+   int result;
+
+   if ((tokens->argc != 2 && tokens->argc != 3) ||
+	   atou32 (tokens->argv[1],&value) || !value)
+	 {
+		parse_error (tokens,"<timeout-in-seconds> [<subtree>]");
+		return (-1);
+	 }
+
+   if (tokens->argc == 2)
+	 {
+		if (agent->timeout)
+		  {
+			 already_defined (tokens);
+			 return (-1);
+		  }
+
+		agent->timeout = value;
+
+		return (0);
+	 }
+
+   if ((oid = makeoid (tokens->argv[2])) == NULL)
+	 return (-1);
+
+   result = module_subtree (oid,value);
+   mem_free (oid);
+
+   return (result);
+}
+
+static int parse_workers (struct agent *agent,struct tokens *tokens)
 {
    uint32_t value;
 
-   if (agent->timeout)
+   if (agent->workers)
+	 {
+		already_defined (tokens);
+		return (-1);
+	 }
+
+   if (tokens->argc != 2 || atou32 (tokens->argv[1],&value) || !value)
+	 {
+		parse_error (tokens,"<number-of-threads>");
+		return (-1);
+	 }
+
+   agent->workers = value;
+
+   return (0);
+}
+
+static int parse_listeners (struct agent *agent,struct tokens *tokens)
+{
+   uint32_t value;
+
+   if (agent->listeners)
 	 {
 		already_defined (tokens);
 		return (-1);
@@ -320,11 +538,111 @@ static int parse_cache (struct agent *agent,struct tokens *tokens)
 
    if (tokens->argc != 2 || atou32 (tokens->argv[1],&value) || !value)
 	 {
-		parse_error (tokens,"<timeout-in-seconds>");
+		parse_error (tokens,"<number-of-threads>");
 		return (-1);
 	 }
 
-   agent->timeout = value;
+   agent->listeners = value;
+
+   return (0);
+}
+
+static int parse_batch (struct agent *agent,struct tokens *tokens)
+{
+   uint32_t value;
+
+   if (agent->batch)
+	 {
+		already_defined (tokens);
+		return (-1);
+	 }
+
+   if (tokens->argc != 2 || atou32 (tokens->argv[1],&value) || !value)
+	 {
+		parse_error (tokens,"<number-of-packets>");
+		return (-1);
+	 }
+
+   if (value > NETWORK_BATCH_MAX)
+	 {
+		abz_set_error ("at most %u packets can be batched",NETWORK_BATCH_MAX);
+		return (-1);
+	 }
+
+   agent->batch = value;
+
+   return (0);
+}
+
+static int parse_response (struct agent *agent,struct tokens *tokens)
+{
+   uint32_t value;
+
+   if (agent->response)
+	 {
+		already_defined (tokens);
+		return (-1);
+	 }
+
+   if (tokens->argc != 2 || atou32 (tokens->argv[1],&value))
+	 {
+		parse_error (tokens,"<bytes>");
+		return (-1);
+	 }
+
+   if (value < SNMP_RESPONSE_MIN || value > SNMP_RESPONSE_MAX)
+	 {
+		abz_set_error ("response size should be between %u and %u bytes",
+					   SNMP_RESPONSE_MIN,SNMP_RESPONSE_MAX);
+		return (-1);
+	 }
+
+   agent->response = value;
+
+   return (0);
+}
+
+static int parse_replies (struct agent *agent,struct tokens *tokens)
+{
+   uint32_t value;
+
+   if (agent->replies)
+	 {
+		already_defined (tokens);
+		return (-1);
+	 }
+
+   if (tokens->argc != 2 || atou32 (tokens->argv[1],&value) || !value)
+	 {
+		parse_error (tokens,"<number-of-responses>");
+		return (-1);
+	 }
+
+   agent->replies = value;
+
+   return (0);
+}
+
+static int parse_ratelimit (struct agent *agent,struct tokens *tokens)
+{
+   uint32_t rate,burst = 0;
+
+   if (agent->rate)
+	 {
+		already_defined (tokens);
+		return (-1);
+	 }
+
+   if ((tokens->argc != 2 && tokens->argc != 3) ||
+	   atou32 (tokens->argv[1],&rate) || !rate ||
+	   (tokens->argc == 3 && (atou32 (tokens->argv[2],&burst) || !burst)))
+	 {
+		parse_error (tokens,"<requests-per-second> [<burst>]");
+		return (-1);
+	 }
+
+   agent->rate = rate;
+   agent->burst = burst ? burst : rate;
 
    return (0);
 }
@@ -392,7 +710,16 @@ int agent_parse (struct agent *agent,struct tokens *tokens)
 		{ "listen", parse_listen },
 		{ "allow", parse_allow },
 		{ "community", parse_community },
+		{ "rwcommunity", parse_rwcommunity },
+		{ "trapsink", parse_trapsink },
+		{ "informsink", parse_informsink },
 		{ "cache", parse_cache },
+		{ "workers", parse_workers },
+		{ "listeners", parse_listeners },
+		{ "batch", parse_batch },
+		{ "response", parse_response },
+		{ "replies", parse_replies },
+		{ "ratelimit", parse_ratelimit },
 		{ "module", parse_module },
 		{ "ifdef", comment_open },
 		{ "endif", comment_close }
@@ -438,25 +765,50 @@ int agent_parse (struct agent *agent,struct tokens *tokens)
 }
 
 #ifdef DEBUG
+#include <stdio.h>
 #include <debug/log.h>
+
+static const char *print_view (char *buf,size_t size,const uint32_t *oid)
+{
+   size_t i,n;
+
+   if (oid == NULL || !oid[0])
+	 return ("");
+
+   n = snprintf (buf,size," %u.%u",oid[1] / 40,oid[1] % 40);
+
+   for (i = 2; i <= oid[0] && n < size; i++)
+	 n += snprintf (buf + n,size - n,".%u",oid[i]);
+
+   return (buf);
+}
+
 void agent_print_stub (const char *filename,int line,const char *function,int level,
 					   const struct agent *agent)
 {
    const struct allow *allow;
+   const struct community *community;
+   const struct sink *sink;
+   char buf[256];
 
    log_printf_stub (filename,line,function,level,
 					"# agent\n"
 					"user %u\n"
 					"group %u\n"
 					"pidfile \"%s\"\n"
-					"listen %u.%u.%u.%u:%u\n"
-					"community \"%s\"\n",
+					"listen %u.%u.%u.%u:%u\n",
 					agent->uid,
 					agent->gid,
 					agent->pidfile,
 					NIPQUAD (agent->listen.sin_addr.s_addr),
-					ntohs (agent->listen.sin_port),
-					agent->community);
+					ntohs (agent->listen.sin_port));
+
+   for (community = agent->community; community != NULL; community = community->next)
+	 log_printf_stub (filename,line,function,level,
+					  "%s \"%s\"%s\n",
+					  community->writable ? "rwcommunity" : "community",
+					  community->name,
+					  print_view (buf,sizeof (buf),community->view));
 
    if (agent->timeout)
 	 log_printf_stub (filename,line,function,level,
@@ -465,11 +817,49 @@ void agent_print_stub (const char *filename,int line,const char *function,int le
    else
 	 log_puts_stub (filename,line,function,level,"cache disabled\n");
 
+   if (agent->workers)
+	 log_printf_stub (filename,line,function,level,
+					  "workers %u\n",
+					  agent->workers);
+
+   if (agent->listeners)
+	 log_printf_stub (filename,line,function,level,
+					  "listeners %u\n",
+					  agent->listeners);
+
+   if (agent->batch)
+	 log_printf_stub (filename,line,function,level,
+					  "batch %u\n",
+					  agent->batch);
+
+   log_printf_stub (filename,line,function,level,
+					"response %u bytes\n",
+					agent->response);
+
+   if (agent->replies)
+	 log_printf_stub (filename,line,function,level,
+					  "replies %u\n",
+					  agent->replies);
+
+   if (agent->rate)
+	 log_printf_stub (filename,line,function,level,
+					  "ratelimit %u requests per second, burst %u\n",
+					  agent->rate,
+					  agent->burst);
+
    for (allow = agent->allow; allow != NULL; allow = allow->next)
 	 log_printf_stub (filename,line,function,level,
 					  "allow %u.%u.%u.%u/%u.%u.%u.%u\n",
 					  NIPQUAD (allow->network.address),
 					  NIPQUAD (allow->network.netmask));
+
+   for (sink = agent->sink; sink != NULL; sink = sink->next)
+	 log_printf_stub (filename,line,function,level,
+					  "%s %u.%u.%u.%u:%u \"%s\"\n",
+					  sink->inform ? "informsink" : "trapsink",
+					  NIPQUAD (sink->addr.sin_addr.s_addr),
+					  ntohs (sink->addr.sin_port),
+					  sink->community);
 }
 #endif	/* #ifdef DEBUG */
 
@@ -41,6 +41,7 @@
 #include <ber/ber.h>
 
 #include "module.h"
+#include "access.h"
 
 struct allow
 {
@@ -48,6 +49,28 @@ struct allow
    struct allow *next;
 };
 
+/*
+ * Requests with this community string may only see the ObjectID's
+ * below the view (if it isn't NULL) and may only change them if the
+ * community is writable.
+ */
+struct community
+{
+   char *name;
+   size_t len;
+   int writable;
+   uint32_t *view;
+   struct community *next;
+};
+
+struct sink
+{
+   struct sockaddr_in addr;
+   char *community;
+   int inform;
+   struct sink *next;
+};
+
 struct agent
 {
    uid_t uid;
@@ -55,13 +78,19 @@ struct agent
    char *pidfile;
    struct sockaddr_in listen;
    struct allow *allow;
-   char *community;
+   struct community *community;
    module_parse_t parse_module;
    uint8_t comment;
-   int fd;
-   struct event event;
-   ber_t packet;
    time_t timeout;
+   uint32_t workers;
+   uint32_t listeners;
+   uint32_t batch;
+   uint32_t response;
+   uint32_t replies;
+   uint32_t rate;
+   uint32_t burst;
+   struct sink *sink;
+   struct access access;
 };
 
 /*
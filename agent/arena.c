@@ -0,0 +1,158 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <abz/error.h>
+#include <debug/memory.h>
+
+#include "arena.h"
+
+/* default size of arena blocks (excluding the block header) */
+#define ARENA_BLOCK 32768
+
+/* alignment of memory returned by arena_alloc() */
+#define ARENA_ALIGN sizeof (uint64_t)
+
+#define ALIGN(x) (((x) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+struct arena_block
+{
+   struct arena_block *next;
+   size_t size;
+   size_t used;
+};
+
+/* offset of the first usable byte in a block */
+#define BLOCK_HEADER ALIGN (sizeof (struct arena_block))
+
+void arena_create (struct arena *arena)
+{
+   arena->block = arena->current = NULL;
+   arena->used = arena->size = 0;
+   arena->fixed = 0;
+}
+
+void arena_destroy (struct arena *arena)
+{
+   while (arena->block != NULL)
+	 {
+		struct arena_block *block = arena->block;
+
+		arena->block = arena->block->next;
+		mem_free (block);
+	 }
+
+   arena_create (arena);
+}
+
+void *arena_alloc (struct arena *arena,size_t size)
+{
+   struct arena_block *block;
+   void *ptr;
+
+   size = ALIGN (size);
+
+   /*
+	* Blocks left over from a previous generation are reused in
+	* order. The tail of a block which is too small is wasted.
+	*/
+
+   for (block = arena->current; block != NULL; block = block->next)
+	 if (block->size - block->used >= size)
+	   break;
+
+   if (block == NULL)
+	 {
+		size_t n = size > ARENA_BLOCK ? size : ARENA_BLOCK;
+
+		if (arena->fixed)
+		  {
+			 abz_set_error ("arena full (%lu bytes)",(unsigned long) arena->size);
+			 return (NULL);
+		  }
+
+		if ((block = mem_alloc (BLOCK_HEADER + n)) == NULL)
+		  {
+			 abz_set_error ("failed to allocate memory: %m");
+			 return (NULL);
+		  }
+
+		block->size = n;
+		block->used = 0;
+
+		if (arena->current != NULL)
+		  {
+			 while (arena->current->next != NULL)
+			   arena->current = arena->current->next;
+
+			 block->next = NULL;
+			 arena->current->next = block;
+		  }
+		else
+		  {
+			 block->next = arena->block;
+			 arena->block = block;
+		  }
+
+		arena->size += n;
+	 }
+
+   ptr = (uint8_t *) block + BLOCK_HEADER + block->used;
+   block->used += size;
+   arena->current = block;
+   arena->used += size;
+
+   return (ptr);
+}
+
+int arena_reserve (struct arena *arena,size_t size)
+{
+   abz_clear_error ();
+
+   if (arena_alloc (arena,size) == NULL)
+	 return (-1);
+
+   arena_reset (arena);
+   arena->fixed = 1;
+
+   return (0);
+}
+
+void arena_reset (struct arena *arena)
+{
+   struct arena_block *block;
+
+   for (block = arena->block; block != NULL; block = block->next)
+	 block->used = 0;
+
+   arena->current = arena->block;
+   arena->used = 0;
+}
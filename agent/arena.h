@@ -0,0 +1,80 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+
+struct arena_block;
+
+struct arena
+{
+   struct arena_block *block;		/* blocks, in the order they were allocated	*/
+   struct arena_block *current;		/* block we are currently allocating from	*/
+   size_t used;						/* number of bytes handed out				*/
+   size_t size;						/* number of bytes allocated for blocks		*/
+   int fixed;						/* never allocate more blocks				*/
+};
+
+/*
+ * Initialize an arena. No memory is allocated until the first
+ * call to arena_alloc().
+ */
+extern void arena_create (struct arena *arena);
+
+/*
+ * Allocate a single block of size bytes up front and never allocate
+ * any more, so that arena_alloc() never calls malloc (and fails once
+ * the block is used up). Returns 0 if successful, -1 if some error
+ * occurred. Call abz_get_error() to retrieve the error message.
+ */
+extern int arena_reserve (struct arena *arena,size_t size);
+
+/*
+ * Free all memory allocated by the arena. When this function returns,
+ * the arena is in exactly the same state as when initialized.
+ */
+extern void arena_destroy (struct arena *arena);
+
+/*
+ * Allocate size bytes from the arena. The memory is suitably aligned
+ * for any of the snmp types. Returns a pointer to the memory or NULL
+ * if some error occurred. Call abz_get_error() to retrieve the error
+ * message. Memory is never freed individually.
+ */
+extern void *arena_alloc (struct arena *arena,size_t size);
+
+/*
+ * Release everything allocated from the arena in one go. The blocks
+ * are kept so that the next generation can be allocated without
+ * calling malloc again.
+ */
+extern void arena_reset (struct arena *arena);
+
+#endif	/* #ifndef ARENA_H */
@@ -0,0 +1,109 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <sched.h>
+
+#include <abz/error.h>
+
+#include "epoch.h"
+
+/*
+ * Every reader has its own slot, which holds the epoch it entered its
+ * current critical section in, or zero when it is outside of one.
+ */
+static uint64_t epoch = 1;
+static uint64_t reader[EPOCH_READERS];
+static uint32_t readers = 0;
+static __thread int self = -1;
+
+int epoch_register (void)
+{
+   uint32_t n;
+
+   abz_clear_error ();
+
+   if (self >= 0)
+	 return (0);
+
+   if ((n = __atomic_fetch_add (&readers,1,__ATOMIC_SEQ_CST)) >= EPOCH_READERS)
+	 {
+		__atomic_fetch_sub (&readers,1,__ATOMIC_SEQ_CST);
+		abz_set_error ("too many reader threads");
+		return (-1);
+	 }
+
+   self = n;
+
+   return (0);
+}
+
+void epoch_enter (void)
+{
+   if (self >= 0)
+	 {
+		/*
+		 * This has to be visible before we load any shared pointers,
+		 * hence the full barrier.
+		 */
+
+		__atomic_store_n (&reader[self],__atomic_load_n (&epoch,__ATOMIC_SEQ_CST),__ATOMIC_SEQ_CST);
+		__atomic_thread_fence (__ATOMIC_SEQ_CST);
+	 }
+}
+
+void epoch_leave (void)
+{
+   if (self >= 0)
+	 __atomic_store_n (&reader[self],0,__ATOMIC_RELEASE);
+}
+
+void epoch_synchronize (void)
+{
+   uint64_t target = __atomic_add_fetch (&epoch,1,__ATOMIC_SEQ_CST);
+   uint32_t i,n = __atomic_load_n (&readers,__ATOMIC_SEQ_CST);
+
+   if (n > EPOCH_READERS)
+	 n = EPOCH_READERS;
+
+   /*
+	* Readers which entered in the new epoch (or later) already see
+	* whatever was published before we got here, so we only have to
+	* wait for the ones that entered earlier.
+	*/
+
+   for (i = 0; i < n; i++)
+	 if ((int) i != self)
+	   {
+		  uint64_t value;
+
+		  while ((value = __atomic_load_n (&reader[i],__ATOMIC_ACQUIRE)) && value < target)
+			sched_yield ();
+	   }
+}
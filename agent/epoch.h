@@ -0,0 +1,66 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Epoch based reclamation. Threads which look up ObjectID's register
+ * as readers and mark the start and end of each lookup. Writers which
+ * replace shared data call epoch_synchronize() before reusing or
+ * freeing the old copy. Readers never block or take any locks.
+ */
+
+/* maximum number of reader threads */
+#define EPOCH_READERS 64
+
+/*
+ * Register the calling thread as a reader. Returns 0 if successful,
+ * -1 if there are too many readers. Call abz_get_error() to retrieve
+ * the error message.
+ */
+extern int epoch_register (void);
+
+/*
+ * Mark the start of a read-side critical section. Shared data loaded
+ * after this call remains valid until epoch_leave() is called.
+ */
+extern void epoch_enter (void);
+
+/*
+ * Mark the end of a read-side critical section.
+ */
+extern void epoch_leave (void);
+
+/*
+ * Wait until all readers (other than the calling thread) have left
+ * the critical sections they were in when this function was called.
+ */
+extern void epoch_synchronize (void);
+
+#endif	/* #ifndef EPOCH_H */
@@ -0,0 +1,256 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <event.h>
+
+#include <debug/log.h>
+#include <debug/hex.h>
+
+#include <abz/error.h>
+
+#include "logger.h"
+#include "worker.h"
+
+struct message
+{
+   int level;
+   char text[LOGGER_TEXT];
+   size_t length;						/* number of bytes in data (if any)	*/
+   uint8_t data[LOGGER_DATA];
+};
+
+/*
+ * Messages are queued in a ring. Slots between first and first + n
+ * belong to the event loop, which logs them without holding the
+ * mutex, so other threads can keep queueing in the meantime. The
+ * event loop is woken up through a pipe whenever the queue stops
+ * being empty.
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct message queue[LOGGER_QUEUE];
+static size_t first = 0,n = 0;
+static uint32_t dropped = 0;
+static int wakeup[2] = { -1, -1 };
+static struct event event;
+static int watching = 0;
+
+/*
+ * Returns the next free slot, with the mutex held, or NULL if the
+ * queue is full.
+ */
+static struct message *logger_reserve (int level)
+{
+   struct message *message;
+
+   pthread_mutex_lock (&lock);
+
+   if (n == LOGGER_QUEUE)
+	 {
+		dropped++;
+		pthread_mutex_unlock (&lock);
+		return (NULL);
+	 }
+
+   message = queue + (first + n) % LOGGER_QUEUE;
+   message->level = level;
+   message->text[0] = '\0';
+   message->length = 0;
+
+   return (message);
+}
+
+static void logger_commit (void)
+{
+   int empty = !n++,fd = wakeup[1];
+
+   pthread_mutex_unlock (&lock);
+
+   /* if the pipe is full, the event loop has been woken up already */
+   if (empty && fd >= 0)
+	 while (write (fd,"",1) < 0 && errno == EINTR)
+	   ;
+}
+
+void logger_printf (int level,const char *fmt, ...)
+{
+   struct message *message;
+   va_list ap;
+
+   if ((message = logger_reserve (level)) != NULL)
+	 {
+		va_start (ap,fmt);
+		vsnprintf (message->text,sizeof (message->text),fmt,ap);
+		va_end (ap);
+
+		logger_commit ();
+	 }
+}
+
+void logger_hexdump (int level,const void *buf,size_t len)
+{
+   struct message *message;
+
+   if ((message = logger_reserve (level)) != NULL)
+	 {
+		message->length = len < LOGGER_DATA ? len : LOGGER_DATA;
+		memcpy (message->data,buf,message->length);
+
+		if (len > LOGGER_DATA)
+		  snprintf (message->text,sizeof (message->text),
+					"(%lu more bytes not shown)\n",(unsigned long) (len - LOGGER_DATA));
+
+		logger_commit ();
+	 }
+}
+
+/*
+ * Log everything in the queue. This is only called by the event loop
+ * with the worker lock held, or once the workers have been stopped.
+ */
+static void logger_flush (void)
+{
+   size_t i,count;
+   uint32_t lost;
+
+   do
+	 {
+		pthread_mutex_lock (&lock);
+		count = n;
+		lost = dropped;
+		dropped = 0;
+		pthread_mutex_unlock (&lock);
+
+		for (i = 0; i < count; i++)
+		  {
+			 const struct message *message = queue + (first + i) % LOGGER_QUEUE;
+
+			 if (message->length)
+			   hexdump (message->level,message->data,message->length);
+
+			 if (message->text[0] != '\0')
+			   log_printf (message->level,"%s",message->text);
+		  }
+
+		if (lost)
+		  log_printf (LOG_WARNING,"log queue full, %u messages dropped\n",lost);
+
+		pthread_mutex_lock (&lock);
+		first = (first + count) % LOGGER_QUEUE;
+		n -= count;
+		count = n;
+		pthread_mutex_unlock (&lock);
+	 }
+   while (count);
+}
+
+static void logger_event (int fd,short event,void *arg)
+{
+   uint8_t tmp[64];
+
+   while (read (fd,tmp,sizeof (tmp)) > 0)
+	 ;
+
+   worker_lock ();
+   logger_flush ();
+   worker_unlock ();
+}
+
+static int logger_nonblock (int fd)
+{
+   int flags;
+
+   if ((flags = fcntl (fd,F_GETFL)) < 0 || fcntl (fd,F_SETFL,flags | O_NONBLOCK))
+	 {
+		abz_set_error ("failed to set non-blocking i/o: %m");
+		return (-1);
+	 }
+
+   return (0);
+}
+
+int logger_open (void)
+{
+   abz_clear_error ();
+
+   if (pipe (wakeup))
+	 {
+		abz_set_error ("failed to create pipe: %m");
+		return (-1);
+	 }
+
+   if (logger_nonblock (wakeup[0]) || logger_nonblock (wakeup[1]))
+	 {
+		logger_close ();
+		return (-1);
+	 }
+
+   event_set (&event,wakeup[0],EV_READ | EV_PERSIST,logger_event,NULL);
+
+   if (event_add (&event,NULL))
+	 {
+		abz_set_error ("failed to add event handler: %m");
+		logger_close ();
+		return (-1);
+	 }
+
+   watching = 1;
+
+   return (0);
+}
+
+void logger_close (void)
+{
+   if (watching)
+	 {
+		event_del (&event);
+		watching = 0;
+	 }
+
+   pthread_mutex_lock (&lock);
+
+   if (wakeup[0] >= 0)
+	 {
+		close (wakeup[0]);
+		close (wakeup[1]);
+		wakeup[0] = wakeup[1] = -1;
+	 }
+
+   pthread_mutex_unlock (&lock);
+
+   logger_flush ();
+}
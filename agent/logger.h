@@ -0,0 +1,69 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stddef.h>
+
+/* maximum number of messages waiting to be logged */
+#define LOGGER_QUEUE 64
+
+/* maximum length of a message */
+#define LOGGER_TEXT 256
+
+/* maximum number of bytes of a hexdump */
+#define LOGGER_DATA 512
+
+/*
+ * Start logging queued messages from the event loop. This should be
+ * called after event_init(). Returns 0 if successful, -1 if some error
+ * occurred. Call abz_get_error() to retrieve the error message.
+ */
+extern int logger_open (void);
+
+/*
+ * Log the messages which are still queued and stop watching the queue.
+ */
+extern void logger_close (void);
+
+/*
+ * libdebug may only be called with the worker lock held, which the
+ * threads answering requests must not wait for. These queue a message
+ * (or a hexdump of up to LOGGER_DATA bytes) instead, which is logged
+ * by the event loop. Neither function blocks or allocates any memory,
+ * so they can be called from any thread. If the queue is full, the
+ * message is dropped.
+ */
+extern void logger_printf (int level,const char *fmt, ...)
+  __attribute__ ((format (printf,2,3)));
+
+extern void logger_hexdump (int level,const void *buf,size_t len);
+
+#endif	/* #ifndef LOGGER_H */
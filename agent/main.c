@@ -45,9 +45,12 @@
 #include "config.h"
 #include "module.h"
 #include "network.h"
+#include "notify.h"
+#include "worker.h"
+#include "logger.h"
 
-static const int sigset_ignore[] = { SIGUSR1, SIGUSR2, SIGTSTP };
-static const int sigset_accept[] = { SIGHUP, SIGINT, SIGTERM };
+static const int sigset_ignore[] = { SIGUSR2, SIGTSTP };
+static const int sigset_accept[] = { SIGHUP, SIGUSR1, SIGINT, SIGTERM };
 static struct event events[ARRAYSIZE (sigset_accept)];
 static struct agent agent;
 
@@ -105,15 +108,34 @@ static void signal_event (int fd,short event,void *arg)
 {
    int i;
 
+   worker_lock ();
+
    log_printf (LOG_VERBOSE,"caught signal %d\n",fd);
 
    if (fd == SIGHUP && !log_reset ())
-	 return;
+	 {
+		worker_unlock ();
+		return;
+	 }
+
+   if (fd == SIGUSR1)
+	 {
+		network_report ();
+		worker_unlock ();
+		return;
+	 }
 
    for (i = 0; i < ARRAYSIZE (sigset_accept); i++)
 	 signal_del (events + i);
 
+   /* the workers don't need the lock to quit */
+   worker_close ();
+   module_unschedule ();
    network_close (&agent);
+   notify_close ();
+   logger_close ();
+
+   worker_unlock ();
 }
 
 void signal_open (void)
@@ -138,7 +160,11 @@ void signal_close (void)
 	 {
 		int i;
 
+		worker_close ();
+		module_unschedule ();
 		network_close (&agent);
+		notify_close ();
+		logger_close ();
 
 		for (i = 0; i < ARRAYSIZE (sigset_accept); i++)
 		  {
@@ -213,6 +239,21 @@ int main (int argc,char *argv[])
 		exit (EXIT_FAILURE);
 	 }
 
+   /* threads don't survive daemon(), so this has to happen afterwards */
+   if (worker_open (agent.workers) ||
+	   logger_open () ||
+	   notify_open (&agent) ||
+	   module_schedule (agent.timeout) ||
+	   network_start (&agent))
+	 {
+		log_printf (LOG_ERROR,"%s\n",abz_get_error ());
+		worker_close ();
+		network_close (&agent);
+		notify_close ();
+		logger_close ();
+		exit (EXIT_FAILURE);
+	 }
+
    signal_open ();
    atexit (signal_close);
 
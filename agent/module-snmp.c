@@ -27,8 +27,12 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#include <pthread.h>
+
+#include <abz/error.h>
 
 #include <tinysnmp/tinysnmp.h>
 #include <tinysnmp/agent/odb.h>
@@ -70,51 +74,122 @@ enum
    SNMPPROXYDROPS			= 32
 };
 
-struct snmp_stats snmp_stats;
+/* maximum number of threads with their own counters */
+#define SNMP_SHARDS 64
+
+__thread struct snmp_stats snmp_stats;
+
+/*
+ * The shards of the running threads, and the sum of the counters of
+ * all the threads which have exited since.
+ */
+static pthread_mutex_t sharding = PTHREAD_MUTEX_INITIALIZER;
+static struct snmp_stats *shard[SNMP_SHARDS];
+static uint32_t shards = 0;
+static struct snmp_stats total;
 
-static int snmp_open (void)
+int snmp_stats_register (void)
 {
+   abz_clear_error ();
+
+   pthread_mutex_lock (&sharding);
+
+   if (shards == SNMP_SHARDS)
+	 {
+		pthread_mutex_unlock (&sharding);
+		abz_set_error ("too many threads");
+		return (-1);
+	 }
+
    memset (&snmp_stats,0L,sizeof (struct snmp_stats));
+   shard[shards++] = &snmp_stats;
+
+   pthread_mutex_unlock (&sharding);
+
    return (0);
 }
 
+void snmp_stats_unregister (void)
+{
+   uint32_t *sum = (uint32_t *) &total;
+   const uint32_t *counter = (const uint32_t *) &snmp_stats;
+   size_t i,j;
+
+   pthread_mutex_lock (&sharding);
+
+   for (i = 0; i < shards; i++)
+	 if (shard[i] == &snmp_stats)
+	   {
+		  shard[i] = shard[--shards];
+
+		  for (j = 0; j < sizeof (struct snmp_stats) / sizeof (uint32_t); j++)
+			sum[j] += counter[j];
+
+		  break;
+	   }
+
+   pthread_mutex_unlock (&sharding);
+}
+
+/*
+ * Add up the counters of all the threads. The other threads keep
+ * counting while we do this, but that doesn't matter since each
+ * counter is read in one go. The lock only keeps threads from
+ * leaving while their counters are being read.
+ */
+static uint32_t snmp_counter (size_t offset)
+{
+   uint32_t i,sum;
+
+   pthread_mutex_lock (&sharding);
+
+   sum = *(const uint32_t *) ((const uint8_t *) &total + offset);
+
+   for (i = 0; i < shards; i++)
+	 sum += __atomic_load_n ((const uint32_t *) ((const uint8_t *) shard[i] + offset),__ATOMIC_RELAXED);
+
+   pthread_mutex_unlock (&sharding);
+
+   return (sum);
+}
+
 static int snmp_update (struct odb **odb)
 {
-   static struct
+   static const struct
 	 {
 		uint32_t index;
-		uint32_t *value;
+		size_t offset;
 	 } list[] =
 	 {
-		{ SNMPINPKTS, &snmp_stats.snmpInPkts },
-		{ SNMPOUTPKTS, &snmp_stats.snmpOutPkts },
-		{ SNMPINBADVERSIONS, &snmp_stats.snmpInBadVersions },
-		{ SNMPINBADCOMMUNITYNAMES, &snmp_stats.snmpInBadCommunityNames },
-		{ SNMPINBADCOMMUNITYUSES, &snmp_stats.snmpInBadCommunityUses },
-		{ SNMPINASNPARSEERRS, &snmp_stats.snmpInASNParseErrs },
-		{ SNMPINTOOBIGS, &snmp_stats.snmpInTooBigs },
-		{ SNMPINNOSUCHNAMES, &snmp_stats.snmpInNoSuchNames },
-		{ SNMPINBADVALUES, &snmp_stats.snmpInBadValues },
-		{ SNMPINREADONLYS, &snmp_stats.snmpInReadOnlys },
-		{ SNMPINGENERRS, &snmp_stats.snmpInGenErrs },
-		{ SNMPINTOTALREQVARS, &snmp_stats.snmpInTotalReqVars },
-		{ SNMPINTOTALSETVARS, &snmp_stats.snmpInTotalSetVars },
-		{ SNMPINGETREQUESTS, &snmp_stats.snmpInGetRequests },
-		{ SNMPINGETNEXTS, &snmp_stats.snmpInGetNexts },
-		{ SNMPINSETREQUESTS, &snmp_stats.snmpInSetRequests },
-		{ SNMPINGETRESPONSES, &snmp_stats.snmpInGetResponses },
-		{ SNMPINTRAPS, &snmp_stats.snmpInTraps },
-		{ SNMPOUTTOOBIGS, &snmp_stats.snmpOutTooBigs },
-		{ SNMPOUTNOSUCHNAMES, &snmp_stats.snmpOutNoSuchNames },
-		{ SNMPOUTBADVALUES, &snmp_stats.snmpOutBadValues },
-		{ SNMPOUTGENERRS, &snmp_stats.snmpOutGenErrs },
-		{ SNMPOUTGETREQUESTS, &snmp_stats.snmpOutGetRequests },
-		{ SNMPOUTGETNEXTS, &snmp_stats.snmpOutGetNexts },
-		{ SNMPOUTSETREQUESTS, &snmp_stats.snmpOutSetRequests },
-		{ SNMPOUTGETRESPONSES, &snmp_stats.snmpOutGetResponses },
-		{ SNMPOUTTRAPS, &snmp_stats.snmpOutTraps },
-		{ SNMPSILENTDROPS, &snmp_stats.snmpSilentDrops },
-		{ SNMPPROXYDROPS, &snmp_stats.snmpProxyDrops }
+		{ SNMPINPKTS, offsetof (struct snmp_stats,snmpInPkts) },
+		{ SNMPOUTPKTS, offsetof (struct snmp_stats,snmpOutPkts) },
+		{ SNMPINBADVERSIONS, offsetof (struct snmp_stats,snmpInBadVersions) },
+		{ SNMPINBADCOMMUNITYNAMES, offsetof (struct snmp_stats,snmpInBadCommunityNames) },
+		{ SNMPINBADCOMMUNITYUSES, offsetof (struct snmp_stats,snmpInBadCommunityUses) },
+		{ SNMPINASNPARSEERRS, offsetof (struct snmp_stats,snmpInASNParseErrs) },
+		{ SNMPINTOOBIGS, offsetof (struct snmp_stats,snmpInTooBigs) },
+		{ SNMPINNOSUCHNAMES, offsetof (struct snmp_stats,snmpInNoSuchNames) },
+		{ SNMPINBADVALUES, offsetof (struct snmp_stats,snmpInBadValues) },
+		{ SNMPINREADONLYS, offsetof (struct snmp_stats,snmpInReadOnlys) },
+		{ SNMPINGENERRS, offsetof (struct snmp_stats,snmpInGenErrs) },
+		{ SNMPINTOTALREQVARS, offsetof (struct snmp_stats,snmpInTotalReqVars) },
+		{ SNMPINTOTALSETVARS, offsetof (struct snmp_stats,snmpInTotalSetVars) },
+		{ SNMPINGETREQUESTS, offsetof (struct snmp_stats,snmpInGetRequests) },
+		{ SNMPINGETNEXTS, offsetof (struct snmp_stats,snmpInGetNexts) },
+		{ SNMPINSETREQUESTS, offsetof (struct snmp_stats,snmpInSetRequests) },
+		{ SNMPINGETRESPONSES, offsetof (struct snmp_stats,snmpInGetResponses) },
+		{ SNMPINTRAPS, offsetof (struct snmp_stats,snmpInTraps) },
+		{ SNMPOUTTOOBIGS, offsetof (struct snmp_stats,snmpOutTooBigs) },
+		{ SNMPOUTNOSUCHNAMES, offsetof (struct snmp_stats,snmpOutNoSuchNames) },
+		{ SNMPOUTBADVALUES, offsetof (struct snmp_stats,snmpOutBadValues) },
+		{ SNMPOUTGENERRS, offsetof (struct snmp_stats,snmpOutGenErrs) },
+		{ SNMPOUTGETREQUESTS, offsetof (struct snmp_stats,snmpOutGetRequests) },
+		{ SNMPOUTGETNEXTS, offsetof (struct snmp_stats,snmpOutGetNexts) },
+		{ SNMPOUTSETREQUESTS, offsetof (struct snmp_stats,snmpOutSetRequests) },
+		{ SNMPOUTGETRESPONSES, offsetof (struct snmp_stats,snmpOutGetResponses) },
+		{ SNMPOUTTRAPS, offsetof (struct snmp_stats,snmpOutTraps) },
+		{ SNMPSILENTDROPS, offsetof (struct snmp_stats,snmpSilentDrops) },
+		{ SNMPPROXYDROPS, offsetof (struct snmp_stats,snmpProxyDrops) }
 	 };
    static uint32_t oid[9] = { 8, 43, 6, 1, 2, 1, 11, 0, 0 };
    snmp_value_t value;
@@ -125,7 +200,7 @@ static int snmp_update (struct odb **odb)
    for (i = 0; i < ARRAYSIZE (list); i++)
 	 {
 		oid[oid[0] - 1] = list[i].index;
-		value.data.Counter32 = *(list[i].value);
+		value.data.Counter32 = snmp_counter (list[i].offset);
 
 		if (odb_add (odb,oid,&value))
 		  return (-1);
@@ -148,7 +223,7 @@ struct module module_snmp =
    .mod_oid	= snmp,
    .con_oid	= NULL,
    .parse	= NULL,
-   .open	= snmp_open,
+   .open	= NULL,
    .update	= snmp_update,
    .close	= NULL
 };
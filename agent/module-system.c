@@ -56,6 +56,20 @@
 static char *contact = NULL;		/* contact person for this managed node		*/
 static char *location = NULL;		/* the physical location of this node		*/
 
+/*
+ * Entries in the sysORTable. These are kept here and added to the
+ * cache each time it is rebuilt since they aren't known to the
+ * module's update() callback.
+ */
+static struct
+{
+   const uint32_t *oid;
+   const char *descr;
+   uint32_t uptime;
+} *sysor = NULL;
+
+static uint32_t nsysor = 0;
+
 static void out_of_memory (void)
 {
    abz_set_error ("failed to allocate memory: %m");
@@ -212,8 +226,6 @@ static int update_uptime (struct odb **odb)
    snmp_value_t value;
    struct sysinfo si;
 
-   odb_remove (odb,sysUpTime);
-
    if (sysinfo (&si))
 	 {
 		abz_set_error ("sysinfo: %m");
@@ -280,44 +292,88 @@ static int update_services (struct odb **odb)
    return (odb_add (odb,sysServices,&value));
 }
 
+static int update_lastchange (struct odb **odb)
+{
+   static const uint32_t sysORLastChange[9] = { 8, 43, 6, 1, 2, 1, 1, 8, 0 };
+   snmp_value_t value;
+
+   if (!nsysor)
+	 return (0);
+
+   value.type = BER_TimeTicks;
+   value.data.TimeTicks = sysor[nsysor - 1].uptime;
+
+   return (odb_add (odb,sysORLastChange,&value));
+}
+
+static int update_sysor (struct odb **odb)
+{
+   static uint32_t sysOREntry[11] = { 10, 43, 6, 1, 2, 1, 1, 9, 1, 0, 0 };
+   snmp_value_t value;
+   uint32_t i,column;
+
+   /* column by column, so that the entries are added in order */
+
+   for (column = sysORIndex; column <= sysORUpTime; column++)
+	 for (i = 0; i < nsysor; i++)
+	   {
+		  sysOREntry[sysOREntry[0] - 1] = column;
+		  sysOREntry[sysOREntry[0]] = i + 1;
+
+		  switch (column)
+			{
+			 case sysORIndex:
+			   value.type = BER_INTEGER;
+			   value.data.INTEGER = i + 1;
+			   break;
+			 case sysORID:
+			   value.type = BER_OID;
+			   value.data.OID = (uint32_t *) sysor[i].oid;
+			   break;
+			 case sysORDescr:
+			   value.type = BER_OCTET_STRING;
+			   value.data.OCTET_STRING.len = strlen (sysor[i].descr);
+			   value.data.OCTET_STRING.buf = (uint8_t *) sysor[i].descr;
+			   break;
+			 default:
+			   value.type = BER_TimeTicks;
+			   value.data.TimeTicks = sysor[i].uptime;
+			}
+
+		  if (odb_add (odb,sysOREntry,&value))
+			return (-1);
+	   }
+
+   return (0);
+}
+
 /*
- * Note that object identifiers are NOT removed prior
- * to calling this function (or afterwards if the function
- * fails). The reason for this is explained in modules.c.
- *
- * All oids which are periodically updated (in this case
- * sysUpTime and sysORLastChange) should be removed before
- * adding by the module itself.
+ * The agent clears the cache before calling this function,
+ * so everything (including the sysORTable, which is registered
+ * via module_extend()) is added again each time.
  */
 
 static int system_update (struct odb **odb)
 {
-   static struct
-	 {
-		int (*update) (struct odb **);
-		int once;
-	 } list[] =
+   static int (*update[]) (struct odb **) =
 	 {
-		{ update_descr, 1 },
-		{ update_oid, 1 },
-		{ update_uptime, 0 },
-		{ update_contact, 1 },
-		{ update_hostname, 1 },
-		{ update_location, 1 },
-		{ update_services, 1 }
+		update_descr,
+		update_oid,
+		update_uptime,
+		update_contact,
+		update_hostname,
+		update_location,
+		update_services,
+		update_lastchange,
+		update_sysor
 	 };
    size_t i;
 
    abz_clear_error ();
 
-   for (i = 0; i < ARRAYSIZE (list); i++)
-	 if (list[i].once >= 0)
-	   {
-		  if (list[i].update (odb))
-			return (-1);
-
-		  list[i].once = -list[i].once;
-	   }
+   for (i = 0; i < ARRAYSIZE (update); i++)
+	 if (update[i] (odb))
+	   return (-1);
 
    return (0);
 }
@@ -329,6 +385,13 @@ static void system_close (void)
 
    if (location != NULL)
 	 mem_free (location);
+
+   if (sysor != NULL)
+	 {
+		mem_free (sysor);
+		sysor = NULL;
+		nsysor = 0;
+	 }
 }
 
 /* iso.org.dod.internet.mgmt.mib-2.system */
@@ -348,13 +411,8 @@ struct module module_system =
 
 int module_extend (const uint32_t *oid,const char *descr)
 {
-   static const uint32_t sysORLastChange[9] = { 8, 43, 6, 1, 2, 1, 1, 8, 0 };
-   static uint32_t sysOREntry[11] = { 10, 43, 6, 1, 2, 1, 1, 9, 1, 0, 0 };
-   static uint32_t n = 1;
    struct sysinfo si;
-   snmp_value_t value;
-
-   sysOREntry[sysOREntry[0]] = n++;
+   void *ptr;
 
    if (sysinfo (&si))
 	 {
@@ -362,37 +420,20 @@ int module_extend (const uint32_t *oid,const char *descr)
 		return (-1);
 	 }
 
-   sysOREntry[sysOREntry[0] - 1] = sysORIndex;
-   value.type = BER_INTEGER;
-   value.data.INTEGER = sysOREntry[sysOREntry[0]];
-
-   if (odb_add (&module_system.cache,sysOREntry,&value))
-	 return (-1);
-
-   sysOREntry[sysOREntry[0] - 1] = sysORID;
-   value.type = BER_OID;
-   value.data.OID = (uint32_t *) oid;
-
-   if (odb_add (&module_system.cache,sysOREntry,&value))
-	 return (-1);
-
-   sysOREntry[sysOREntry[0] - 1] = sysORDescr;
-   value.type = BER_OCTET_STRING;
-   value.data.OCTET_STRING.len = strlen (descr);
-   value.data.OCTET_STRING.buf = (uint8_t *) descr;
-
-   if (odb_add (&module_system.cache,sysOREntry,&value))
-	 return (-1);
-
-   sysOREntry[sysOREntry[0] - 1] = sysORUpTime;
-   value.type = BER_TimeTicks;
-   value.data.TimeTicks = si.uptime * 100;
+   if ((ptr = mem_realloc (sysor,(nsysor + 1) * sizeof (*sysor))) == NULL)
+	 {
+		out_of_memory ();
+		return (-1);
+	 }
 
-   if (odb_add (&module_system.cache,sysOREntry,&value))
-	 return (-1);
+   sysor = ptr;
+   sysor[nsysor].oid = oid;
+   sysor[nsysor].descr = descr;
+   sysor[nsysor].uptime = si.uptime * 100;
+   nsysor++;
 
-   odb_remove (&module_system.cache,sysORLastChange);
+   /* make sure the new entry shows up the next time we look */
+   module_system.timestamp = 0;
 
-   return (odb_add (&module_system.cache,sysORLastChange,&value));
+   return (0);
 }
-
@@ -27,11 +27,19 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdlib.h>
+#include <stdio.h>
 #include <time.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <dirent.h>
 #include <dlfcn.h>
+#include <event.h>
+#include <pthread.h>
 #include <sys/types.h>
+#include <sys/time.h>
 
 #include <debug/log.h>
 #include <debug/memory.h>
@@ -39,15 +47,74 @@
 #include <abz/typedefs.h>
 #include <abz/error.h>
 #include <abz/tokens.h>
+#include <abz/atou32.h>
 
 #include <tinysnmp/tinysnmp.h>
 #include <tinysnmp/agent/odb.h>
 #include <tinysnmp/agent/module.h>
 
 #include "module.h"
+#include "epoch.h"
+#include "worker.h"
+#include "oidcmp.h"
+
+/*
+ * Refresh timer of a module. When modules are scheduled, their
+ * caches are only updated from the event loop (or by the worker
+ * threads) and never while looking up ObjectID's.
+ */
+struct schedule
+{
+   struct job job;
+   struct event event;
+   struct module *module;
+   time_t interval;
+   int queued;
+   int failed;
+   char error[256];
+};
+
+/*
+ * Cache lifetime of all the modules in a subtree.
+ */
+struct subtree
+{
+   uint32_t *oid;
+   time_t timeout;
+   struct subtree *next;
+};
+
+/*
+ * Dispatch index. Modules are kept in an array (in the same order
+ * as the module list) and in a trie keyed on the sub-identifiers of
+ * their ObjectID's, so that we don't have to compare ObjectID's with
+ * every module for every lookup.
+ */
+struct index
+{
+   uint32_t arc;				/* sub-identifier						*/
+   struct module **module;		/* module rooted here (or NULL)			*/
+   struct index *child;			/* children, ordered by sub-identifier	*/
+   uint32_t n;					/* number of children					*/
+};
 
 static const char *library = NULL;
 static struct module *modules = NULL;
+static struct module **sorted = NULL;
+static size_t nsorted = 0;
+static struct index root = { 0, NULL, NULL, 0 };
+static struct module *parsing = NULL;
+static struct subtree *subtrees = NULL;
+static struct schedule *schedule = NULL;
+static size_t nschedule = 0;
+static uint32_t request = 0;
+static uint64_t generation = 0;
+static int scheduled = 0;
+
+/* set requests wake up the event loop through this pipe */
+static int wakeup[2] = { -1, -1 };
+static struct event changed;
+static int watching = 0;
 
 static void save_dl_error (const char *function)
 {
@@ -77,29 +144,6 @@ static __inline__ char *pathcat (const char *path,const char *name)
    return (filename);
 }
 
-static int oidsub (const uint32_t *base,const uint32_t *oid)
-{
-   uint32_t len = *base;
-
-   if (*base > *oid)
-	 return (0);
-
-   while (len && *++base == *++oid)
-	 len--;
-
-   return (len ? 0 : 1);
-}
-
-static int oidcmp (const uint32_t *base,const uint32_t *oid)
-{
-   uint32_t saved = *base - *oid,len = *base < *oid ? *base : *oid;
-
-   while (len && *++base == *++oid)
-	 len--;
-
-   return (len ? *base - *oid : saved);
-}
-
 static int module_register (struct module *module,int ext)
 {
    int failed = 1;
@@ -107,7 +151,13 @@ static int module_register (struct module *module,int ext)
    abz_clear_error ();
 
    odb_create (&module->cache);
+   odb_create (&module->shadow);
    module->timestamp = 0;
+   module->timeout = 0;
+   module->request = 0;
+   pthread_mutex_init (&module->lock,NULL);
+   module->dirty = 0;
+   module->stale = 0;
    module->parsing = 0;
    module->next = NULL;
 
@@ -187,10 +237,142 @@ static int module_register (struct module *module,int ext)
    return (0);
 }
 
+static void index_destroy (struct index *index)
+{
+   uint32_t i;
+
+   for (i = 0; i < index->n; i++)
+	 index_destroy (index->child + i);
+
+   if (index->child != NULL)
+	 mem_free (index->child);
+
+   index->child = NULL;
+   index->n = 0;
+}
+
+static int index_create (void)
+{
+   struct module *node;
+   size_t i;
+
+   abz_clear_error ();
+
+   for (node = modules, nsorted = 0; node != NULL; node = node->next)
+	 nsorted++;
+
+   if ((sorted = mem_alloc (nsorted * sizeof (struct module *))) == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		return (-1);
+	 }
+
+   for (node = modules, i = 0; node != NULL; node = node->next)
+	 sorted[i++] = node;
+
+   /*
+	* Since the modules are sorted, new sub-identifiers are always
+	* larger than those already in the trie, so they can simply be
+	* appended.
+	*/
+
+   for (i = 0; i < nsorted; i++)
+	 {
+		struct index *index = &root;
+		uint32_t j;
+
+		for (j = 1; j <= sorted[i]->mod_oid[0]; j++)
+		  {
+			 if (!index->n || index->child[index->n - 1].arc != sorted[i]->mod_oid[j])
+			   {
+				  struct index *ptr;
+
+				  if ((ptr = mem_realloc (index->child,(index->n + 1) * sizeof (struct index))) == NULL)
+					{
+					   abz_set_error ("failed to allocate memory: %m");
+					   return (-1);
+					}
+
+				  index->child = ptr;
+				  memset (index->child + index->n,0L,sizeof (struct index));
+				  index->child[index->n++].arc = sorted[i]->mod_oid[j];
+			   }
+
+			 index = index->child + index->n - 1;
+		  }
+
+		if (index->module == NULL)
+		  index->module = sorted + i;
+	 }
+
+   return (0);
+}
+
+/*
+ * Return the position of the module which ObjectID is the shortest
+ * prefix of oid, or -1 if there is no such module.
+ */
+static ssize_t index_find (const uint32_t *oid)
+{
+   const struct index *index = &root;
+   uint32_t i;
+
+   for (i = 1; i <= oid[0]; i++)
+	 {
+		uint32_t lo = 0,hi = index->n;
+
+		while (lo < hi)
+		  {
+			 uint32_t mid = lo + (hi - lo) / 2;
+
+			 if (index->child[mid].arc < oid[i])
+			   lo = mid + 1;
+			 else
+			   hi = mid;
+		  }
+
+		if (lo == index->n || index->child[lo].arc != oid[i])
+		  return (-1);
+
+		index = index->child + lo;
+
+		if (index->module != NULL)
+		  return (index->module - sorted);
+	 }
+
+   return (-1);
+}
+
+/*
+ * Return the position of the first module that could contain
+ * ObjectID's which lexographically succeed oid.
+ */
+static size_t index_find_next (const uint32_t *oid)
+{
+   ssize_t pos;
+   size_t lo = 0,hi = nsorted;
+
+   if ((pos = index_find (oid)) >= 0)
+	 return (pos);
+
+   while (lo < hi)
+	 {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (oidcmp (sorted[mid]->mod_oid,oid) < 0)
+		  lo = mid + 1;
+		else
+		  hi = mid;
+	 }
+
+   return (lo);
+}
+
 static __inline__ void module_load (const char *filename)
 {
    void *handle;
    struct module *module;
+   const uint32_t *abi;
 
    abz_clear_error ();
 
@@ -220,6 +402,16 @@ static __inline__ void module_load (const char *filename)
 		return;
 	 }
 
+   /* modules built for an older agent don't have a version at all */
+   if ((abi = dlsym (handle,"module_abi")) == NULL || *abi != MODULE_ABI)
+	 {
+		log_printf (LOG_WARNING,
+					"failed to load module %s: built for module api version %u instead of %u, "
+					"the module has to be rebuilt\n",
+					filename,abi != NULL ? *abi : 0,MODULE_ABI);
+		return;
+	 }
+
    if ((module = dlsym (handle,"module")) == NULL)
 	 {
 		save_dl_error ("dlsym");
@@ -282,6 +474,12 @@ int module_open (const char *path)
 		return (-1);
 	 }
 
+   if (index_create ())
+	 {
+		log_printf (LOG_ERROR,"failed to create module index: %s\n",abz_get_error ());
+		return (-1);
+	 }
+
    return (0);
 }
 
@@ -295,77 +493,568 @@ void module_close (void)
 		  modules->close ();
 
 		odb_destroy (&modules->cache);
+		odb_destroy (&modules->shadow);
+		pthread_mutex_destroy (&modules->lock);
 
 		node = modules, modules = modules->next;
 	 }
+
+   index_destroy (&root);
+
+   if (sorted != NULL)
+	 {
+		mem_free (sorted);
+		sorted = NULL;
+		nsorted = 0;
+	 }
+
+   while (subtrees != NULL)
+	 {
+		struct subtree *tmp = subtrees;
+
+		subtrees = subtrees->next;
+		mem_free (tmp->oid);
+		mem_free (tmp);
+	 }
+}
+
+/*
+ * Build a new cache in the shadow database. Clearing the shadow
+ * keeps the memory allocated previously, so after the first few
+ * updates there is usually nothing left to allocate. Returns 0 if
+ * successful, -1 if some error occurred.
+ */
+static int module_build (struct module *module)
+{
+   odb_clear (&module->shadow);
+
+   if (module->update != NULL &&
+	   (module->update (&module->shadow) || odb_sort (&module->shadow)))
+	 {
+		odb_clear (&module->shadow);
+		return (-1);
+	 }
+
+   return (0);
+}
+
+/*
+ * Swap the shadow database in. Lookups which started before the
+ * swap may still be using the old cache, so we have to wait for
+ * them before it can be reused as the next shadow.
+ */
+static void module_publish (struct module *module)
+{
+   struct odb *tmp = __atomic_exchange_n (&module->cache,module->shadow,__ATOMIC_ACQ_REL);
+
+   __atomic_add_fetch (&generation,1,__ATOMIC_RELEASE);
+   epoch_synchronize ();
+   module->shadow = tmp;
+}
+
+/*
+ * Build and publish a new cache. Only one thread builds the cache of
+ * a module at a time. A module changed by a set request is marked as
+ * dirty until its cache has been built again. The module is told once
+ * its new cache is in place. Returns 0 if successful, -1 if some
+ * error occurred.
+ */
+static int module_rebuild (struct module *module)
+{
+   int failed;
+
+   pthread_mutex_lock (&module->lock);
+   __atomic_store_n (&module->dirty,0,__ATOMIC_SEQ_CST);
+
+   if (!(failed = module_build (module)))
+	 {
+		module_publish (module);
+
+		if (module->published != NULL)
+		  module->published ();
+	 }
+
+   pthread_mutex_unlock (&module->lock);
+
+   return (failed ? -1 : 0);
+}
+
+/*
+ * If an update failed, the last good copy stays in place.
+ */
+static void module_report (struct module *module,int failed,const char *error)
+{
+   if (failed)
+	 {
+		log_printf (LOG_WARNING,"failed to update module %s: %s\n",module->name,error);
+
+		if (!module->stale)
+		  log_printf (LOG_WARNING,"serving stale data for module %s\n",module->name);
+
+		module->stale = 1;
+	 }
+   else module->stale = 0;
+
+   log_printf (LOG_DEBUG,"module %s: %lu bytes cached%s\n",
+			   module->name,(unsigned long) odb_size (module->cache),
+			   module->stale ? " (stale)" : "");
+}
+
+static void module_refresh (struct module *module)
+{
+   int failed = module_rebuild (module);
+
+   module_report (module,failed,failed ? abz_get_error () : NULL);
+}
+
+static __inline__ const struct odb *module_cache (const struct module *module)
+{
+   return (__atomic_load_n (&module->cache,__ATOMIC_ACQUIRE));
 }
 
 static void module_update (struct module *module,time_t timeout)
 {
-   static const char system[] = "system";
-   time_t now = time (NULL);
+   time_t now;
+
+   /* scheduled modules are only ever updated by their timers */
+   if (module->timeout || module->update == NULL ||
+	   module->request == __atomic_load_n (&request,__ATOMIC_RELAXED))
+	 return;
 
-   if (now - module->timestamp >= timeout)
+   module->request = request;
+   now = time (NULL);
+
+   if (now - module->timestamp >= timeout || __atomic_load_n (&module->dirty,__ATOMIC_SEQ_CST))
 	 {
 		module->timestamp = now;
+		module_refresh (module);
+	 }
+}
 
-		/*
-		 * We can't delete the system module's object identifiers
-		 * automatically since it exports the sysORID's which is
-		 * not added by its update() callback.
-		 */
+/*
+ * Arm the refresh timer of a module. If spread is non-zero, the
+ * timer fires anywhere within the first interval (so that modules
+ * don't all update at the same time), otherwise it fires after the
+ * interval give or take 10%.
+ */
+static int schedule_add (struct schedule *entry,int spread)
+{
+   uint64_t usec = (uint64_t) entry->interval * 1000000;
+   struct timeval tv;
 
-		if (module->con_oid != NULL || strcmp (module->name,system))
-		  odb_remove (&module->cache,module->mod_oid);
+   if (spread)
+	 usec = 1 + (uint64_t) random () % usec;
+   else if (usec >= 5)
+	 usec = usec - usec / 10 + (uint64_t) random () % (usec / 5);
 
-		if (module->update != NULL && module->update (&module->cache))
-		  {
-			 log_printf (LOG_WARNING,
-						 "failed to update module %s: %s\n",
-						 module->name,abz_get_error ());
+   tv.tv_sec = usec / 1000000;
+   tv.tv_usec = usec % 1000000;
 
-			 if (module->con_oid != NULL || strcmp (module->name,system))
-			   odb_remove (&module->cache,module->mod_oid);
-		  }
+   if (evtimer_add (&entry->event,&tv))
+	 {
+		abz_set_error ("failed to add refresh timer for module %s",entry->module->name);
+		return (-1);
 	 }
+
+   return (0);
 }
 
-const snmp_value_t *module_find (const uint32_t *oid,time_t timeout)
+/*
+ * Called by one of the worker threads. Nothing in here may touch
+ * libevent or the log, that is left to schedule_done().
+ */
+static void schedule_run (struct job *job)
 {
-   struct module *node;
+   struct schedule *entry = (struct schedule *) job;
 
-   for (node = modules; node != NULL; node = node->next)
-	 if (oidsub (node->mod_oid,oid))
+   if ((entry->failed = module_rebuild (entry->module)))
+	 snprintf (entry->error,sizeof (entry->error),"%s",abz_get_error ());
+}
+
+static void schedule_event (int fd,short event,void *arg);
+
+static void schedule_done (struct job *job)
+{
+   struct schedule *entry = (struct schedule *) job;
+
+   entry->queued = 0;
+   module_report (entry->module,entry->failed,entry->error);
+
+   /* changed by a set request after the update had finished */
+   if (__atomic_load_n (&entry->module->dirty,__ATOMIC_SEQ_CST))
+	 schedule_event (-1,EV_TIMEOUT,entry);
+   else if (schedule_add (entry,0))
+	 log_printf (LOG_ERROR,"%s\n",abz_get_error ());
+}
+
+static void schedule_event (int fd,short event,void *arg)
+{
+   struct schedule *entry = arg;
+
+   entry->module->timestamp = time (NULL);
+
+   /* the timer is armed again once the worker is done */
+   if (worker_present ())
+	 {
+		entry->queued = 1;
+		worker_queue (&entry->job);
+		return;
+	 }
+
+   worker_lock ();
+
+   module_refresh (entry->module);
+
+   if (schedule_add (entry,0))
+	 log_printf (LOG_ERROR,"%s\n",abz_get_error ());
+
+   worker_unlock ();
+}
+
+/*
+ * Modules changed by set requests are updated right away, instead
+ * of waiting for their timers. Modules which are already queued for
+ * an update don't need another one.
+ */
+static void schedule_changed (int fd,short event,void *arg)
+{
+   uint8_t tmp[64];
+   size_t i;
+
+   while (read (fd,tmp,sizeof (tmp)) > 0)
+	 ;
+
+   worker_lock ();
+
+   for (i = 0; i < nschedule; i++)
+	 if (!schedule[i].queued && __atomic_load_n (&schedule[i].module->dirty,__ATOMIC_SEQ_CST))
 	   {
-		  module_update (node,timeout);
-		  return (odb_find (node->cache,oid));
+		  evtimer_del (&schedule[i].event);
+		  schedule_event (-1,EV_TIMEOUT,schedule + i);
 	   }
 
-   return (NULL);
+   worker_unlock ();
+}
+
+static int schedule_nonblock (int fd)
+{
+   int flags;
+
+   if ((flags = fcntl (fd,F_GETFL)) < 0 || fcntl (fd,F_SETFL,flags | O_NONBLOCK))
+	 {
+		abz_set_error ("failed to set non-blocking i/o: %m");
+		return (-1);
+	 }
+
+   return (0);
 }
 
-snmp_next_value_t *module_find_next (const uint32_t *oid,time_t timeout)
+/*
+ * Return the cache lifetime of a module. In order of preference,
+ * this is the lifetime configured in the module's section, that
+ * of the smallest subtree containing the module, or the default.
+ */
+static time_t module_timeout (const struct module *module,time_t timeout)
+{
+   const struct subtree *subtree,*found = NULL;
+
+   if (module->timeout)
+	 return (module->timeout);
+
+   for (subtree = subtrees; subtree != NULL; subtree = subtree->next)
+	 if (oidsub (subtree->oid,module->mod_oid) &&
+		 (found == NULL || subtree->oid[0] > found->oid[0]))
+	   found = subtree;
+
+   return (found != NULL ? found->timeout : timeout);
+}
+
+int module_schedule (time_t interval)
 {
    struct module *node;
-   snmp_next_value_t *next;
+   size_t n = 0;
+
+   abz_clear_error ();
+
+   scheduled = 1;
 
    for (node = modules; node != NULL; node = node->next)
-	 if (oidsub (node->mod_oid,oid) || oidcmp (node->mod_oid,oid) >= 0)
-	   break;
+	 if ((node->timeout = module_timeout (node,interval)) && node->update != NULL)
+	   n++;
+	 else if (node->update != NULL)
+	   scheduled = 0;
+
+   if (!n)
+	 return (0);
 
-   while (node != NULL)
+   if ((schedule = mem_alloc (n * sizeof (struct schedule))) == NULL)
 	 {
-		module_update (node,timeout);
+		abz_set_error ("failed to allocate memory: %m");
+		return (-1);
+	 }
 
-		if ((next = odb_find_next (node->cache,oid)) != NULL)
-		  return (next);
+   if (pipe (wakeup))
+	 {
+		abz_set_error ("failed to create pipe: %m");
+		module_unschedule ();
+		return (-1);
+	 }
 
-		node = node->next;
+   if (schedule_nonblock (wakeup[0]) || schedule_nonblock (wakeup[1]))
+	 {
+		module_unschedule ();
+		return (-1);
 	 }
 
+   event_set (&changed,wakeup[0],EV_READ | EV_PERSIST,schedule_changed,NULL);
+
+   if (event_add (&changed,NULL))
+	 {
+		abz_set_error ("failed to add event handler: %m");
+		module_unschedule ();
+		return (-1);
+	 }
+
+   watching = 1;
+
+   srandom (time (NULL) ^ getpid ());
+
+   for (node = modules; node != NULL; node = node->next)
+	 if (node->timeout && node->update != NULL)
+	   {
+		  struct schedule *entry = schedule + nschedule;
+
+		  entry->job.run = schedule_run;
+		  entry->job.done = schedule_done;
+		  entry->module = node;
+		  entry->interval = node->timeout;
+		  entry->queued = 0;
+		  evtimer_set (&entry->event,schedule_event,entry);
+
+		  /* make sure there is something to serve right from the start */
+		  node->timestamp = time (NULL);
+		  module_refresh (node);
+
+		  if (schedule_add (entry,1))
+			{
+			   module_unschedule ();
+			   return (-1);
+			}
+
+		  nschedule++;
+	   }
+
+   log_printf (LOG_VERBOSE,"refreshing %u modules in the background\n",
+			   (unsigned) nschedule);
+
+   return (0);
+}
+
+void module_unschedule (void)
+{
+   if (watching)
+	 {
+		event_del (&changed);
+		watching = 0;
+	 }
+
+   /* set requests may still be handled by the listener threads */
+   worker_lock ();
+
+   if (wakeup[0] >= 0)
+	 {
+		close (wakeup[0]);
+		close (wakeup[1]);
+		wakeup[0] = wakeup[1] = -1;
+	 }
+
+   worker_unlock ();
+
+   if (schedule != NULL)
+	 {
+		size_t i;
+
+		for (i = 0; i < nschedule; i++)
+		  evtimer_del (&schedule[i].event);
+
+		mem_free (schedule);
+		schedule = NULL;
+		nschedule = 0;
+	 }
+}
+
+uint64_t module_generation (void)
+{
+   return (__atomic_load_n (&generation,__ATOMIC_ACQUIRE));
+}
+
+int module_scheduled (void)
+{
+   return (scheduled);
+}
+
+const char *module_uncached (time_t interval)
+{
+   const struct module *node;
+
+   for (node = modules; node != NULL; node = node->next)
+	 if (node->update != NULL && !module_timeout (node,interval))
+	   return (node->name);
+
    return (NULL);
 }
 
+void module_request (void)
+{
+   __atomic_add_fetch (&request,1,__ATOMIC_RELAXED);
+}
+
+const snmp_value_t *module_find (const uint32_t *oid,time_t timeout)
+{
+   ssize_t pos;
+
+   if ((pos = index_find (oid)) < 0)
+	 return (NULL);
+
+   module_update (sorted[pos],timeout);
+
+   return (odb_find (module_cache (sorted[pos]),oid));
+}
+
+int module_find_next (const uint32_t *oid,uint32_t *next,size_t size,time_t timeout,const snmp_value_t **value)
+{
+   size_t i;
+   int result;
+
+   for (i = index_find_next (oid); i < nsorted; i++)
+	 {
+		module_update (sorted[i],timeout);
+
+		if ((result = odb_find_next_ref (module_cache (sorted[i]),oid,next,size,value)) <= 0)
+		  return (result);
+	 }
+
+   return (1);
+}
+
+/*
+ * Return the module which can assign a value to oid or NULL if there
+ * is none. The error status is stored in status.
+ */
+static struct module *module_setter (const uint32_t *oid,int *status)
+{
+   ssize_t pos;
+
+   if ((pos = index_find (oid)) < 0)
+	 {
+		*status = noCreation;
+		return (NULL);
+	 }
+
+   if (sorted[pos]->set == NULL)
+	 {
+		*status = notWritable;
+		return (NULL);
+	 }
+
+   *status = noError;
+
+   return (sorted[pos]);
+}
+
+/*
+ * Set requests are handled one at a time, with the worker lock held
+ * since the modules may call into libabz and libdebug. All the values
+ * are tested before any of them are assigned, and if a module fails
+ * to assign a value, the values assigned before are restored in
+ * reverse order. The caches of the modules which were changed are
+ * not rebuilt here, that is left to the event loop (or to the next
+ * lookup if the module isn't scheduled), so that the request isn't
+ * held up by it.
+ */
+int module_set (uint32_t **oid,const snmp_value_t *value,uint32_t n,uint32_t *index)
+{
+   struct module *module;
+   int status = noError,dummy;
+   uint32_t i,j;
+
+   /* the worker holding the lock may be waiting for the readers */
+   epoch_leave ();
+   worker_lock ();
+
+   for (i = 0; i < n; i++)
+	 if ((module = module_setter (oid[i],&status)) == NULL ||
+		 (status = module->set (MODULE_SET_TEST,oid[i],value + i)) != noError)
+	   {
+		  worker_unlock ();
+		  epoch_enter ();
+		  *index = i + 1;
+		  return (status);
+	   }
+
+   for (i = 0; i < n; i++)
+	 if (module_setter (oid[i],&status)->set (MODULE_SET_COMMIT,oid[i],value + i) != noError)
+	   {
+		  status = commitFailed;
+		  *index = i + 1;
+
+		  for (j = i; j--; )
+			if (module_setter (oid[j],&dummy)->set (MODULE_SET_UNDO,oid[j],value + j) != noError)
+			  status = undoFailed;
+
+		  break;
+	   }
+
+   /* even a failed commit may have changed something */
+   for (j = 0; j < n && j <= i; j++)
+	 __atomic_store_n (&module_setter (oid[j],&dummy)->dirty,1,__ATOMIC_SEQ_CST);
+
+   /* cached responses may no longer be right */
+   __atomic_add_fetch (&generation,1,__ATOMIC_RELEASE);
+
+   if (wakeup[1] >= 0)
+	 while (write (wakeup[1],"",1) < 0 && errno == EINTR)
+	   ;
+
+   worker_unlock ();
+   epoch_enter ();
+
+   return (status);
+}
+
+static int parse_cache (struct module *module,struct tokens *tokens)
+{
+   uint32_t value;
+
+   if (module->timeout)
+	 {
+		abz_set_error ("`%s' already defined",tokens->argv[0]);
+		return (-1);
+	 }
+
+   if (tokens->argc != 2 || atou32 (tokens->argv[1],&value) || !value)
+	 {
+		abz_set_error ("usage: %s <timeout-in-seconds>",tokens->argv[0]);
+		return (-1);
+	 }
+
+   module->timeout = value;
+
+   return (1);
+}
+
+/*
+ * Parse a statement in a module section. The cache statement is
+ * handled here, everything else is passed on to the module.
+ */
+static int parse_section (struct tokens *tokens)
+{
+   if (tokens != NULL && !strcmp (tokens->argv[0],"cache"))
+	 return (parse_cache (parsing,tokens));
+
+   return (parsing->parse != NULL ? parsing->parse (tokens) : 0);
+}
+
 module_parse_t module_parse (const char *name)
 {
    struct module *node;
@@ -381,15 +1070,10 @@ module_parse_t module_parse (const char *name)
 			   return (NULL);
 			}
 
-		  if (node->parse == NULL)
-			{
-			   abz_set_error ("module %s does not have any configuration",name);
-			   return (NULL);
-			}
-
 		  node->parsing = 1;
+		  parsing = node;
 
-		  return (node->parse);
+		  return (parse_section);
 	   }
 
    abz_set_error ("no such module");
@@ -397,6 +1081,41 @@ module_parse_t module_parse (const char *name)
    return (NULL);
 }
 
+int module_subtree (const uint32_t *oid,time_t timeout)
+{
+   struct subtree *subtree;
+   size_t len = (oid[0] + 1) * sizeof (uint32_t);
+
+   abz_clear_error ();
+
+   for (subtree = subtrees; subtree != NULL; subtree = subtree->next)
+	 if (!oidcmp (subtree->oid,oid))
+	   {
+		  abz_set_error ("cache lifetime of subtree already defined");
+		  return (-1);
+	   }
+
+   if ((subtree = mem_alloc (sizeof (struct subtree))) == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		return (-1);
+	 }
+
+   if ((subtree->oid = mem_alloc (len)) == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		mem_free (subtree);
+		return (-1);
+	 }
+
+   memcpy (subtree->oid,oid,len);
+   subtree->timeout = timeout;
+   subtree->next = subtrees;
+   subtrees = subtree;
+
+   return (0);
+}
+
 int module_parse_end (void)
 {
    const struct module *node;
@@ -446,6 +1165,14 @@ void module_print_stub (const char *filename,int line,const char *function,int l
 		if (node->close != NULL)
 		  log_puts_stub (filename,line,function,level," close");
 
+		if (node->stale)
+		  log_puts_stub (filename,line,function,level,"\n stale");
+
+		if (node->timeout)
+		  log_printf_stub (filename,line,function,level,
+						   "\n cache %lu seconds",
+						   (unsigned long) node->timeout);
+
 		log_printf_stub (filename,line,function,level,
 						 "\n oid %" PRIu32 ".%" PRIu32,
 						 node->mod_oid[1] / 40,node->mod_oid[1] % 40);
@@ -79,8 +79,25 @@ typedef int (*module_parse_t) (struct tokens *);
 extern struct module module_system;
 extern struct module module_snmp;
 
-/* snmp counters */
-extern struct snmp_stats snmp_stats;
+/*
+ * snmp counters. Every thread which answers requests has its own
+ * copy, which should be registered with snmp_stats_register().
+ */
+extern __thread struct snmp_stats snmp_stats;
+
+/*
+ * Register the calling thread's snmp counters, so that they are
+ * included in the snmp group. Returns 0 if successful, -1 if some
+ * error occurred. Call abz_get_error() to retrieve the error message.
+ */
+extern int snmp_stats_register (void);
+
+/*
+ * Add the calling thread's snmp counters to those of the threads
+ * which have already exited and unregister them. This should be
+ * called by every registered thread before it exits.
+ */
+extern void snmp_stats_unregister (void);
 
 /*
  * Load modules. This function will print warnings if it encounter errors
@@ -95,6 +112,52 @@ extern int module_open (const char *modulepath);
  */
 extern void module_close (void);
 
+/*
+ * Update the caches of all modules once, then keep refreshing
+ * them (give or take a bit of jitter) from the event loop. Each
+ * module is refreshed at the interval configured in its section,
+ * that of the subtree it is in, or the specified default interval.
+ * This should be called after event_init(). Modules without a cache
+ * lifetime are not scheduled and are updated whenever ObjectID's
+ * are looked up. Returns 0 if successful, -1 if
+ * some error occurred. Call abz_get_error() to retrieve the error
+ * message.
+ */
+extern int module_schedule (time_t interval);
+
+/*
+ * Stop refreshing module caches.
+ */
+extern void module_unschedule (void);
+
+/*
+ * Returns a number which changes whenever one of the module caches
+ * is replaced.
+ */
+extern uint64_t module_generation (void);
+
+/*
+ * Returns non-zero if all modules are refreshed by their timers, in
+ * which case module caches never change while ObjectID's are looked
+ * up.
+ */
+extern int module_scheduled (void);
+
+/*
+ * Returns the name of a module which would not be refreshed by a
+ * timer if the specified default cache lifetime is used, or NULL if
+ * there is no such module. This can be called before the modules
+ * are scheduled.
+ */
+extern const char *module_uncached (time_t interval);
+
+/*
+ * Start a new request. Modules without a cache lifetime are updated
+ * at most once per request, so values returned by module_find() and
+ * module_find_next() stay valid until the next request starts.
+ */
+extern void module_request (void);
+
 /*
  * Find an ObjectID. Return the value of * an existing ObjectID if
  * successful, or NULL if the ObjectID doesn't exist.
@@ -102,12 +165,29 @@ extern void module_close (void);
 extern const snmp_value_t *module_find (const uint32_t *oid,time_t timeout);
 
 /*
- * Find an ObjectID that lexographically succeeds the specified one
- * or NULL if one doesn't exist. The specified ObjectID doesn't need
- * to exist in the database and can also be a partial ObjectID. The
- * returned object must be freed by the caller.
+ * Find an ObjectID that lexographically succeeds the specified one.
+ * The specified ObjectID doesn't need to exist in the database and
+ * can also be a partial ObjectID. The ObjectID found is written to
+ * next, which should have room for size sub-identifiers. The value
+ * returned in *value belongs to the module's cache and is only valid
+ * until the end of the request.
+ *
+ * Returns 0 if successful, 1 if no ObjectID succeeds the specified
+ * one, or -1 if the one that does couldn't be returned.
  */
-extern snmp_next_value_t *module_find_next (const uint32_t *oid,time_t timeout);
+extern int module_find_next (const uint32_t *oid,uint32_t *next,size_t size,time_t timeout,const snmp_value_t **value);
+
+/*
+ * Assign values to n ObjectID's. Either all of the values are
+ * assigned or none of them are. The caches of the modules which
+ * were changed are rebuilt right away. The caller has to be in an
+ * epoch critical section, which is left while the caches are
+ * rebuilt, so values found before this call can't be used after
+ * it. Returns noError if successful, otherwise the error status,
+ * in which case the position (starting from 1) of the variable
+ * which caused the error is stored in index.
+ */
+extern int module_set (uint32_t **oid,const snmp_value_t *value,uint32_t n,uint32_t *index);
 
 /*
  * Return the parse callback of a module or NULL if none is found.
@@ -115,6 +195,14 @@ extern snmp_next_value_t *module_find_next (const uint32_t *oid,time_t timeout);
  */
 extern module_parse_t module_parse (const char *name);
 
+/*
+ * Set the cache lifetime (in seconds) of all the modules in the
+ * subtree starting at oid. Returns 0 if successful, -1 if some
+ * error occurred. Call abz_get_error() to retrieve error messages
+ * if any.
+ */
+extern int module_subtree (const uint32_t *oid,time_t timeout);
+
 /*
  * Check that all modules with parse callbacks have been been parsed
  * successfully. Call abz_get_error() to retrieve error messages if
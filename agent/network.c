@@ -27,11 +27,16 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/* for recvmmsg() and sendmmsg() */
+#define _GNU_SOURCE
+
 #include <stddef.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <signal.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -40,7 +45,6 @@
 
 #include <debug/log.h>
 #include <debug/memory.h>
-#include <debug/hex.h>
 
 #include <abz/error.h>
 #include <tinysnmp/tinysnmp.h>
@@ -48,67 +52,199 @@
 
 #include "module.h"
 #include "agent.h"
+#include "access.h"
 #include "network.h"
 #include "snmp.h"
+#include "epoch.h"
+#include "arena.h"
+#include "replies.h"
+#include "ratelimit.h"
+#include "worker.h"
+#include "logger.h"
 
 /* maximum UDP datagram size */
 #define UDP_DATAGRAM_SIZE 65536
 
-static int network_transmit (struct agent *agent,struct sockaddr *addr)
-{
-   int result,flags = MSG_WAITALL;
-
-   abz_clear_error ();
+/*
+ * Size of the scratch arena of each listener. This is far more than
+ * any request that fits in a datagram needs, the ones which need more
+ * are rejected.
+ */
+#define SCRATCH_SIZE (16 * UDP_DATAGRAM_SIZE)
 
-#ifdef MSG_NOSIGNAL
-   flags |= MSG_NOSIGNAL;
-#endif	/* #ifdef MSG_NOSIGNAL */
+/*
+ * A received datagram and the reply to it.
+ */
+struct slot
+{
+   ber_t packet;
+   struct sockaddr_in addr;
+   int length;
+   uint32_t type;
+   int reply;
+};
 
-#if defined(MSG_CONFIRM) && !defined(COMPAT22)
-   /* this is good, but only Linux 2.3+ supports it (see sendto(2)) */
-   flags |= MSG_CONFIRM;
-#endif	/* #if defined(MSG_CONFIRM) && !defined(COMPAT22) */
+/*
+ * Every listener has its own socket and packet buffers (one for each
+ * datagram in a batch). The first listener is served by the event
+ * loop, the others each have their own thread.
+ *
+ * Answering a request doesn't allocate any memory or call libdebug,
+ * since that needs the worker lock (see worker.h), so the listeners
+ * only log through the queue in logger.h.
+ */
+struct listener
+{
+   struct agent *agent;
+   int fd;
+   struct slot *slot;
+   size_t batch;
+#ifdef MSG_WAITFORONE
+   struct mmsghdr *msg;
+   struct iovec *iov;
+   struct slot **reply;
+#endif	/* #ifdef MSG_WAITFORONE */
+   struct arena scratch;
+   struct replies replies;
+   struct ratelimit ratelimit;
+   pthread_t thread;
+   int running;
+};
+
+static struct listener *listener = NULL;
+static size_t nlisteners = 0;
+static struct event event;
+static volatile int finished = 0;
+
+static void network_log (const struct slot *slot,const char *error)
+{
+   logger_printf (LOG_WARNING,
+			   "reply to %s from %u.%u.%u.%u:%u failed: %s\n",
+			   slot->type == BER_GetRequest ? "get-request" :
+			   slot->type == BER_GetBulkRequest ? "get-bulk-request" :
+			   slot->type == BER_SetRequest ? "set-request" : "get-next-request",
+			   NIPQUAD (slot->addr.sin_addr.s_addr),
+			   ntohs (slot->addr.sin_port),
+			   error);
+}
 
-   result = sendto (agent->fd,
-					agent->packet.buf + agent->packet.size - agent->packet.offset,
-					agent->packet.offset,
-					flags,
-					addr,
-					sizeof (struct sockaddr));
+static int network_sent (struct slot *slot,int result)
+{
+   abz_clear_error ();
 
    if (result > 0)
 	 snmp_stats.snmpOutPkts++;
 
-   if (result != agent->packet.offset)
+   if (result != slot->packet.offset)
 	 {
 		if (result < 0)
 		  abz_set_error ("sendto failed: %m");
 		else
-		  abz_set_error ("short write count: %u/%u bytes sent",result,agent->packet.offset);
+		  abz_set_error ("short write count: %u/%u bytes sent",result,slot->packet.offset);
 
 		return (-1);
 	 }
 
 #ifdef DEBUG
-   log_printf (LOG_DEBUG,
-			   "sent %u bytes to %u.%u.%u.%u:%u\n",
-			   agent->packet.offset,
-			   NIPQUAD (((const struct sockaddr_in *) addr)->sin_addr.s_addr),
-			   ntohs (((const struct sockaddr_in *) addr)->sin_port));
-
-   hexdump (LOG_NOISY,
-			agent->packet.buf + agent->packet.size - agent->packet.offset,
-			agent->packet.offset);
+   logger_printf (LOG_DEBUG,
+				  "sent %u bytes to %u.%u.%u.%u:%u\n",
+				  slot->packet.offset,
+				  NIPQUAD (slot->addr.sin_addr.s_addr),
+				  ntohs (slot->addr.sin_port));
+
+   logger_hexdump (LOG_NOISY,
+				   slot->packet.buf + slot->packet.size - slot->packet.offset,
+				   slot->packet.offset);
 #endif	/* #ifdef DEBUG */
 
    return (0);
 }
 
-static int network_receive (struct agent *agent,struct sockaddr *addr)
+/*
+ * Send the replies in the first n slots.
+ */
+static void network_transmit (struct listener *listener,size_t n)
+{
+   int flags = MSG_WAITALL;
+   size_t i;
+
+#ifdef MSG_NOSIGNAL
+   flags |= MSG_NOSIGNAL;
+#endif	/* #ifdef MSG_NOSIGNAL */
+
+#if defined(MSG_CONFIRM) && !defined(COMPAT22)
+   /* this is good, but only Linux 2.3+ supports it (see sendto(2)) */
+   flags |= MSG_CONFIRM;
+#endif	/* #if defined(MSG_CONFIRM) && !defined(COMPAT22) */
+
+#ifdef MSG_WAITFORONE
+   if (listener->batch > 1)
+	 {
+		struct slot **slot = listener->reply;
+		size_t j,sent = 0;
+		int result;
+
+		for (i = j = 0; i < n; i++)
+		  if (listener->slot[i].reply)
+			{
+			   struct slot *tmp = slot[j] = listener->slot + i;
+
+			   listener->iov[j].iov_base = tmp->packet.buf + tmp->packet.size - tmp->packet.offset;
+			   listener->iov[j].iov_len = tmp->packet.offset;
+			   listener->msg[j].msg_hdr.msg_name = &tmp->addr;
+			   listener->msg[j].msg_hdr.msg_namelen = sizeof (struct sockaddr_in);
+			   j++;
+			}
+
+		while (sent < j)
+		  {
+			 if ((result = sendmmsg (listener->fd,listener->msg + sent,j - sent,flags)) <= 0)
+			   {
+				  /* skip the one that failed and carry on with the rest */
+				  if (network_sent (slot[sent],-1))
+					network_log (slot[sent],abz_get_error ());
+
+				  sent++;
+				  continue;
+			   }
+
+			 for (i = sent; i < sent + result; i++)
+			   if (network_sent (slot[i],listener->msg[i].msg_len))
+				 network_log (slot[i],abz_get_error ());
+
+			 sent += result;
+		  }
+
+		return;
+	 }
+#endif	/* #ifdef MSG_WAITFORONE */
+
+   for (i = 0; i < n; i++)
+	 if (listener->slot[i].reply)
+	   {
+		  struct slot *slot = listener->slot + i;
+		  int result;
+
+		  result = sendto (listener->fd,
+						   slot->packet.buf + slot->packet.size - slot->packet.offset,
+						   slot->packet.offset,
+						   flags,
+						   (struct sockaddr *) &slot->addr,
+						   sizeof (struct sockaddr));
+
+		  if (network_sent (slot,result))
+			network_log (slot,abz_get_error ());
+	   }
+}
+
+/*
+ * Receive up to one batch of datagrams. Returns the number of slots
+ * filled, or -1 if some error occurred.
+ */
+static int network_receive (struct listener *listener)
 {
    int result,flags = MSG_WAITALL;
    socklen_t length = sizeof (struct sockaddr);
-   struct allow *allow;
 
    abz_clear_error ();
 
@@ -116,18 +252,62 @@ static int network_receive (struct agent *agent,struct sockaddr *addr)
    flags |= MSG_NOSIGNAL;
 #endif	/* #ifdef MSG_NOSIGNAL */
 
-   result = recvfrom (agent->fd,agent->packet.buf,UDP_DATAGRAM_SIZE,flags,addr,&length);
+#ifdef MSG_WAITFORONE
+   if (listener->batch > 1)
+	 {
+		size_t i;
+
+		for (i = 0; i < listener->batch; i++)
+		  {
+			 listener->iov[i].iov_base = listener->slot[i].packet.buf;
+			 listener->iov[i].iov_len = UDP_DATAGRAM_SIZE;
+			 listener->msg[i].msg_hdr.msg_name = &listener->slot[i].addr;
+			 listener->msg[i].msg_hdr.msg_namelen = sizeof (struct sockaddr_in);
+		  }
+
+		/* block (if at all) only until the first datagram arrives */
+		if ((result = recvmmsg (listener->fd,listener->msg,listener->batch,flags | MSG_WAITFORONE,NULL)) < 0)
+		  {
+			 abz_set_error ("recvmmsg failed: %m");
+			 return (-1);
+		  }
+
+		for (i = 0; i < result; i++)
+		  listener->slot[i].length = listener->msg[i].msg_len;
+
+		return (result);
+	 }
+#endif	/* #ifdef MSG_WAITFORONE */
+
+   result = recvfrom (listener->fd,listener->slot->packet.buf,UDP_DATAGRAM_SIZE,flags,
+					  (struct sockaddr *) &listener->slot->addr,&length);
 
-   if (result > 0)
+   if (result < 0)
+	 {
+		abz_set_error ("recvfrom failed: %m");
+		return (-1);
+	 }
+
+   listener->slot->length = result;
+
+   return (1);
+}
+
+/*
+ * Returns 0 if the packet should be processed, -1 if it should be
+ * rejected, or 1 if it should be dropped without saying anything,
+ * i.e. if the client is sending requests faster than we allow.
+ */
+static int network_check (struct listener *listener,struct slot *slot)
+{
+   if (slot->length > 0)
 	 snmp_stats.snmpInPkts++;
 
-   if (result <= 0 || result > UDP_DATAGRAM_SIZE)
+   if (slot->length <= 0 || slot->length > UDP_DATAGRAM_SIZE)
 	 {
-		memset (addr,0L,sizeof (struct sockaddr));
+		memset (&slot->addr,0L,sizeof (struct sockaddr_in));
 
-		if (result < 0)
-		  abz_set_error ("recvfrom failed: %m");
-		else if (!result)
+		if (!slot->length)
 		  abz_set_error ("received empty packet");
 		else
 		  abz_set_error ("incoming packet too big");
@@ -135,119 +315,283 @@ static int network_receive (struct agent *agent,struct sockaddr *addr)
 		return (-1);
 	 }
 
-   agent->packet.offset = 0;
-   agent->packet.size = result;
+   slot->packet.offset = 0;
+   slot->packet.size = slot->length;
 
 #ifdef DEBUG
-   log_printf (LOG_DEBUG,
-			   "received %u bytes from %u.%u.%u.%u:%u\n",
-			   agent->packet.size,
-			   NIPQUAD (((const struct sockaddr_in *) addr)->sin_addr.s_addr),
-			   ntohs (((const struct sockaddr_in *) addr)->sin_port));
+   logger_printf (LOG_DEBUG,
+				  "received %u bytes from %u.%u.%u.%u:%u\n",
+				  slot->packet.size,
+				  NIPQUAD (slot->addr.sin_addr.s_addr),
+				  ntohs (slot->addr.sin_port));
 
-   hexdump (LOG_NOISY,agent->packet.buf,agent->packet.size);
+   logger_hexdump (LOG_NOISY,slot->packet.buf,slot->packet.size);
 #endif	/* #ifdef DEBUG */
 
-   for (allow = agent->allow; allow != NULL; allow = allow->next)
-	 if ((((struct sockaddr_in *) addr)->sin_addr.s_addr & allow->network.netmask) == allow->network.address)
-	   return (0);
+   if (access_allow (&listener->agent->access,slot->addr.sin_addr.s_addr) == NULL)
+	 {
+		abz_set_error ("not in list of allowed clients");
+		return (-1);
+	 }
 
-   abz_set_error ("not in list of allowed clients");
+   if (ratelimit_check (&listener->ratelimit,slot->addr.sin_addr.s_addr))
+	 {
+		snmp_stats.snmpSilentDrops++;
+		return (1);
+	 }
 
-   return (-1);
+   return (0);
 }
 
-static int network_process (struct agent *agent,uint32_t *type)
+/*
+ * Requests are decoded into the listener's scratch arena, which is
+ * allocated up front and reset once the reply has been encoded, so
+ * answering a request doesn't allocate any memory.
+ * The community is checked before the variable bindings are
+ * decoded, so packets with the wrong community are cheap to drop.
+ */
+static int network_process (struct listener *listener,struct slot *slot)
 {
+   const struct community *community = NULL;
    snmp_pdu_t pdu;
+   int result = -1;
 
-   if (snmp_decode (&pdu,&agent->packet))
-	 {
-		abz_set_error ("failed to decode packet");
-		return (-1);
-	 }
-
-   if (pdu.community.len != strlen (agent->community) ||
-	   memcmp (pdu.community.buf,agent->community,pdu.community.len))
+   if (snmp_decode_header (&pdu,&slot->packet,&listener->scratch))
+	 abz_set_error ("failed to decode packet");
+   else if ((community = access_community (&listener->agent->access,&pdu.community)) == NULL)
 	 {
 		snmp_stats.snmpInBadCommunityNames++;
-		snmp_free (&pdu);
 		abz_set_error ("invalid community string");
-		return (-1);
 	 }
+   else if (snmp_decode_pdu (&pdu,&slot->packet,&listener->scratch))
+	 abz_set_error ("failed to decode packet");
+   else if (pdu.type == BER_GetResponse)
+	 abz_set_error ("unexpected response pdu");
+   else if (pdu.type == BER_SetRequest && !community->writable)
+	 {
+		snmp_stats.snmpInBadCommunityUses++;
+		abz_set_error ("community string not allowed to set values");
+	 }
+   else
+	 {
+		slot->packet.offset = 0;
+		slot->packet.size = listener->agent->response;
+
+		if (snmp_encode (&slot->packet,&pdu,listener->agent->timeout,community->view,&listener->scratch,&listener->replies))
+		  abz_set_error ("failed to encode pdu");
+		else
+		  {
+			 slot->type = pdu.type;
+			 result = 0;
+		  }
+	 }
+
+   arena_reset (&listener->scratch);
 
-   agent->packet.offset = 0;
-   agent->packet.size = UDP_DATAGRAM_SIZE;
+   return (result);
+}
+
+static void network_serve (struct listener *listener)
+{
+   int i,n,result;
 
-   if (snmp_encode (&agent->packet,&pdu,agent->timeout))
+   if ((n = network_receive (listener)) < 0)
 	 {
-		snmp_free (&pdu);
-		abz_set_error ("failed to encode pdu");
-		return (-1);
+		if (!finished)
+		  logger_printf (LOG_WARNING,"%s\n",abz_get_error ());
+
+		return;
 	 }
 
-   *type = pdu.type;
+   /* module caches may be swapped by the worker threads */
+   epoch_enter ();
+
+   for (i = 0; i < n; i++)
+	 {
+		struct slot *slot = listener->slot + i;
+
+		abz_clear_error ();
+
+		if ((result = network_check (listener,slot)) > 0)
+		  {
+			 slot->reply = 0;
+			 continue;
+		  }
+
+		if (!(slot->reply = !result && !network_process (listener,slot)) && !finished)
+		  {
+			 if (slot->addr.sin_addr.s_addr || slot->addr.sin_port)
+			   logger_printf (LOG_WARNING,
+							  "rejected packet from %u.%u.%u.%u:%u: %s\n",
+							  NIPQUAD (slot->addr.sin_addr.s_addr),
+							  ntohs (slot->addr.sin_port),
+							  abz_get_error ());
+			 else
+			   logger_printf (LOG_WARNING,"%s\n",abz_get_error ());
+		  }
+	 }
 
-   snmp_free (&pdu);
+   epoch_leave ();
 
-   return (0);
+   if (!finished)
+	 network_transmit (listener,n);
 }
 
+/*
+ * Modules without a cache lifetime are updated by the thread which
+ * answers the request, which is always this one (there is only one
+ * listener then), so that has to happen with the worker lock held.
+ * The lock has to be taken before the epoch is entered, since the
+ * worker holding it may be waiting for the epoch to end.
+ */
 static void network_accept (int fd,short event,void *arg)
 {
-   struct agent *agent = arg;
-   struct sockaddr addr;
-   uint32_t type;
+   int scheduled = module_scheduled ();
 
-   abz_clear_error ();
+   if (!scheduled)
+	 worker_lock ();
+
+   network_serve (arg);
 
-   if (network_receive (agent,&addr) || network_process (agent,&type))
+   if (!scheduled)
+	 worker_unlock ();
+}
+
+/*
+ * Each thread has its own epoch slot and statistics shard, so
+ * these have to be registered from the thread itself.
+ */
+static int network_register (void)
+{
+   return (epoch_register () || snmp_stats_register () ? -1 : 0);
+}
+
+static void *network_main (void *arg)
+{
+   struct listener *listener = arg;
+
+   if (network_register ())
 	 {
-		struct sockaddr_in *client = (struct sockaddr_in *) &addr;
+		logger_printf (LOG_ERROR,"%s\n",abz_get_error ());
+		return (NULL);
+	 }
+
+   while (!finished)
+	 network_serve (listener);
+
+   snmp_stats_unregister ();
+
+   return (NULL);
+}
+
+static void listener_free (struct listener *listener)
+{
+   size_t i;
+
+   for (i = 0; i < listener->batch; i++)
+	 if (listener->slot[i].packet.buf != NULL)
+	   mem_free (listener->slot[i].packet.buf);
+
+   mem_free (listener->slot);
+   arena_destroy (&listener->scratch);
+   replies_destroy (&listener->replies);
+   ratelimit_destroy (&listener->ratelimit);
+
+#ifdef MSG_WAITFORONE
+   if (listener->msg != NULL)
+	 mem_free (listener->msg);
+
+   if (listener->iov != NULL)
+	 mem_free (listener->iov);
+
+   if (listener->reply != NULL)
+	 mem_free (listener->reply);
+#endif	/* #ifdef MSG_WAITFORONE */
+}
+
+static int listener_alloc (struct listener *listener,size_t batch)
+{
+   size_t i;
 
-		if (client->sin_addr.s_addr || client->sin_port)
-		  log_printf (LOG_WARNING,
-					  "rejected packet from %u.%u.%u.%u:%u: ",
-					  NIPQUAD (client->sin_addr.s_addr),
-					  ntohs (client->sin_port));
+#ifndef MSG_WAITFORONE
+   /* no recvmmsg(), so there is no point in having more than one slot */
+   batch = 1;
+#endif	/* #ifndef MSG_WAITFORONE */
 
-		log_printf (LOG_WARNING,"%s\n",abz_get_error ());
+   if ((listener->slot = mem_alloc (batch * sizeof (struct slot))) == NULL)
+	 return (-1);
+
+   memset (listener->slot,0L,batch * sizeof (struct slot));
+   listener->batch = batch;
+   arena_create (&listener->scratch);
+   memset (&listener->replies,0L,sizeof (struct replies));
+   memset (&listener->ratelimit,0L,sizeof (struct ratelimit));
+
+#ifdef MSG_WAITFORONE
+   listener->iov = NULL;
+   listener->reply = NULL;
+
+   if ((listener->msg = mem_alloc (batch * sizeof (struct mmsghdr))) == NULL ||
+	   (listener->iov = mem_alloc (batch * sizeof (struct iovec))) == NULL ||
+	   (listener->reply = mem_alloc (batch * sizeof (struct slot *))) == NULL)
+	 {
+		listener_free (listener);
+		return (-1);
+	 }
+
+   memset (listener->msg,0L,batch * sizeof (struct mmsghdr));
+
+   for (i = 0; i < batch; i++)
+	 {
+		listener->msg[i].msg_hdr.msg_iov = listener->iov + i;
+		listener->msg[i].msg_hdr.msg_iovlen = 1;
 	 }
-   else if (network_transmit (agent,&addr))
+#endif	/* #ifdef MSG_WAITFORONE */
+
+   for (i = 0; i < batch; i++)
+	 if ((listener->slot[i].packet.buf = mem_alloc (UDP_DATAGRAM_SIZE)) == NULL)
+	   {
+		  listener_free (listener);
+		  return (-1);
+	   }
+
+   /* the key of a cached response is usually smaller than the response */
+   if (arena_reserve (&listener->scratch,SCRATCH_SIZE) ||
+	   replies_create (&listener->replies,listener->agent->replies,2 * listener->agent->response) ||
+	   ratelimit_create (&listener->ratelimit,listener->agent->rate,listener->agent->burst))
 	 {
-		struct sockaddr_in *client = (struct sockaddr_in *) &addr;
-
-		log_printf (LOG_WARNING,
-					"reply to %s from %u.%u.%u.%u:%u failed: %s\n",
-					type == BER_GetRequest ? "get-request" : "get-next-request",
-					NIPQUAD (client->sin_addr.s_addr),
-					ntohs (client->sin_port),
-					abz_get_error ());
+		listener_free (listener);
+		return (-1);
 	 }
+
+   return (0);
 }
 
-int network_open (struct agent *agent)
+static int listener_open (struct agent *agent,struct listener *listener,int nonblock)
 {
    int flags;
 
-   if ((agent->packet.buf = mem_alloc (UDP_DATAGRAM_SIZE)) == NULL)
+   listener->agent = agent;
+   listener->running = 0;
+
+   if (listener_alloc (listener,agent->batch ? agent->batch : 1))
 	 {
 		log_printf (LOG_ERROR,"failed to allocate memory: %m\n");
 		return (-1);
 	 }
 
-   if ((agent->fd = socket (AF_INET,SOCK_DGRAM,IPPROTO_UDP)) < 0)
+   if ((listener->fd = socket (AF_INET,SOCK_DGRAM,IPPROTO_UDP)) < 0)
 	 {
 		log_printf (LOG_ERROR,"unable to create socket: %m\n");
-		mem_free (agent->packet.buf);
+		listener_free (listener);
 		return (-1);
 	 }
 
-   if ((flags = fcntl (agent->fd,F_GETFL)) < 0 || fcntl (agent->fd,F_SETFL,flags | O_NONBLOCK))
+   if (nonblock && ((flags = fcntl (listener->fd,F_GETFL)) < 0 || fcntl (listener->fd,F_SETFL,flags | O_NONBLOCK)))
 	 {
 		log_printf (LOG_ERROR,"failed to set non-blocking i/o: %m\n");
-		mem_free (agent->packet.buf);
-		close (agent->fd);
+		listener_free (listener);
+		close (listener->fd);
 		return (-1);
 	 }
 
@@ -256,27 +600,87 @@ int network_open (struct agent *agent)
 	 {
 		const int enable = 1;
 
-		if (setsockopt (agent->fd,SOL_SOCKET,SO_REUSEADDR,&enable,sizeof (enable)))
+		if (setsockopt (listener->fd,SOL_SOCKET,SO_REUSEADDR,&enable,sizeof (enable)))
 		  log_printf (LOG_WARNING,"failed to reuse local addresses: %m\n");
 	 }
    while (0);
 #endif	/* #ifdef DEBUG */
 
-   if (bind (agent->fd,(struct sockaddr *) &agent->listen,sizeof (struct sockaddr)))
+   if (agent->listeners > 1)
+	 {
+#ifdef SO_REUSEPORT
+		const int enable = 1;
+
+		if (setsockopt (listener->fd,SOL_SOCKET,SO_REUSEPORT,&enable,sizeof (enable)))
+		  {
+			 log_printf (LOG_ERROR,"failed to share port between sockets: %m\n");
+			 listener_free (listener);
+			 close (listener->fd);
+			 return (-1);
+		  }
+#else	/* #ifdef SO_REUSEPORT */
+		log_printf (LOG_ERROR,"multiple listeners are not supported on this platform\n");
+		listener_free (listener);
+		close (listener->fd);
+		return (-1);
+#endif	/* #ifdef SO_REUSEPORT */
+	 }
+
+   if (bind (listener->fd,(struct sockaddr *) &agent->listen,sizeof (struct sockaddr)))
 	 {
 		log_printf (LOG_ERROR,"failed to bind to socket: %m\n");
-		mem_free (agent->packet.buf);
-		close (agent->fd);
+		listener_free (listener);
+		close (listener->fd);
+		return (-1);
+	 }
+
+   return (0);
+}
+
+static void listener_close (struct listener *listener)
+{
+   listener_free (listener);
+   close (listener->fd);
+}
+
+int network_open (struct agent *agent)
+{
+   size_t n = agent->listeners ? agent->listeners : 1;
+
+   if (network_register ())
+	 {
+		log_printf (LOG_ERROR,"%s\n",abz_get_error ());
+		return (-1);
+	 }
+
+   if ((listener = mem_alloc (n * sizeof (struct listener))) == NULL)
+	 {
+		log_printf (LOG_ERROR,"failed to allocate memory: %m\n");
 		return (-1);
 	 }
 
-   event_set (&agent->event,agent->fd,EV_READ | EV_PERSIST,network_accept,agent);
+   for (nlisteners = 0; nlisteners < n; nlisteners++)
+	 if (listener_open (agent,listener + nlisteners,!nlisteners))
+	   {
+		  while (nlisteners)
+			listener_close (listener + --nlisteners);
 
-   if (event_add (&agent->event,NULL))
+		  mem_free (listener);
+		  listener = NULL;
+		  return (-1);
+	   }
+
+   event_set (&event,listener->fd,EV_READ | EV_PERSIST,network_accept,listener);
+
+   if (event_add (&event,NULL))
 	 {
 		log_printf (LOG_ERROR,"failed to add event handler: %m\n");
-		mem_free (agent->packet.buf);
-		close (agent->fd);
+
+		while (nlisteners)
+		  listener_close (listener + --nlisteners);
+
+		mem_free (listener);
+		listener = NULL;
 		return (-1);
 	 }
 
@@ -288,17 +692,87 @@ int network_open (struct agent *agent)
    return (0);
 }
 
+int network_start (struct agent *agent)
+{
+   sigset_t set,saved;
+   size_t i;
+
+   abz_clear_error ();
+
+   /* signals should only ever be delivered to the event loop */
+   sigfillset (&set);
+   pthread_sigmask (SIG_SETMASK,&set,&saved);
+
+   for (i = 1; i < nlisteners; i++)
+	 {
+		if (pthread_create (&listener[i].thread,NULL,network_main,listener + i))
+		  {
+			 pthread_sigmask (SIG_SETMASK,&saved,NULL);
+			 abz_set_error ("failed to create listener thread");
+			 return (-1);
+		  }
+
+		listener[i].running = 1;
+	 }
+
+   pthread_sigmask (SIG_SETMASK,&saved,NULL);
+
+   if (nlisteners > 1)
+	 log_printf (LOG_VERBOSE,"started %u listener threads\n",(unsigned) nlisteners - 1);
+
+   return (0);
+}
+
+void network_report (void)
+{
+   uint64_t hits = 0,misses = 0,dropped = 0;
+   size_t i;
+
+   for (i = 0; i < nlisteners; i++)
+	 {
+		hits += __atomic_load_n (&listener[i].replies.hits,__ATOMIC_RELAXED);
+		misses += __atomic_load_n (&listener[i].replies.misses,__ATOMIC_RELAXED);
+		dropped += __atomic_load_n (&listener[i].ratelimit.dropped,__ATOMIC_RELAXED);
+	 }
+
+   log_printf (LOG_NORMAL,"response cache: %llu hits, %llu misses\n",
+			   (unsigned long long) hits,(unsigned long long) misses);
+
+   if (nlisteners && listener->agent->rate)
+	 log_printf (LOG_NORMAL,"rate limit: %llu requests dropped\n",(unsigned long long) dropped);
+}
+
 void network_close (struct agent *agent)
 {
    static volatile int called = 0;
 
    if (!called)
 	 {
-		mem_free (agent->packet.buf);
-		event_del (&agent->event);
-		close (agent->fd);
+		size_t i;
+
+		finished = 1;
+
+		if (listener != NULL)
+		  {
+			 event_del (&event);
+
+			 /* this wakes up the threads blocked in recvfrom() */
+			 for (i = 1; i < nlisteners; i++)
+			   if (listener[i].running)
+				 shutdown (listener[i].fd,SHUT_RDWR);
+
+			 for (i = 1; i < nlisteners; i++)
+			   if (listener[i].running)
+				 pthread_join (listener[i].thread,NULL);
+
+			 for (i = 0; i < nlisteners; i++)
+			   listener_close (listener + i);
+
+			 mem_free (listener);
+			 listener = NULL;
+			 nlisteners = 0;
+		  }
 
 		called = 1;
 	 }
 }
-
@@ -31,6 +31,9 @@
 
 #include "agent.h"
 
+/* maximum number of datagrams received or sent at once */
+#define NETWORK_BATCH_MAX 64
+
 /*
  * Listen for connections. This adds event handlers which do
  * all the work. Returns -1 if some error occurred, 0 if
@@ -38,6 +41,19 @@
  */
 extern int network_open (struct agent *agent);
 
+/*
+ * Start the listener threads, if more than one listener was
+ * configured. This should be called after daemonizing. Returns
+ * 0 if successful, -1 if some error occurred. Call abz_get_error()
+ * to retrieve the error message.
+ */
+extern int network_start (struct agent *agent);
+
+/*
+ * Log the response cache counters of all the listeners.
+ */
+extern void network_report (void);
+
 /*
  * Close all connections, remove event handlers, and free
  * memory allocated by event handlers and network_open().
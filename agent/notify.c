@@ -0,0 +1,578 @@
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/sysinfo.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <event.h>
+
+#include <debug/log.h>
+#include <debug/memory.h>
+
+#include <abz/typedefs.h>
+#include <abz/error.h>
+
+#include <tinysnmp/tinysnmp.h>
+#include <ber/ber.h>
+
+#include "module.h"
+#include "agent.h"
+#include "notify.h"
+#include "snmp.h"
+#include "arena.h"
+#include "worker.h"
+
+/* maximum UDP datagram size */
+#define UDP_DATAGRAM_SIZE 65536
+
+/*
+ * A notification waiting to be sent. The variable bindings are the
+ * same for every sink, so they are encoded when the notification is
+ * queued. Informs which haven't been acknowledged yet keep a
+ * reference to the notification.
+ */
+struct notification
+{
+   struct notification *next;
+   uint32_t refs;
+   size_t length;
+   uint8_t varbinds[];
+};
+
+/*
+ * An inform waiting for a response. It is sent again with the same
+ * request ID each time the timer expires, doubling the timeout.
+ */
+struct inform
+{
+   struct event event;
+   const struct sink *sink;
+   struct notification *notification;
+   int32_t RequestID;
+   uint32_t retries;
+   time_t timeout;
+   struct inform *prev,*next;
+};
+
+/*
+ * Notifications can be queued by any thread. They are picked up by
+ * the event loop, which is woken up through a pipe whenever the
+ * queue stops being empty.
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct notification *head = NULL,*tail = NULL;
+static size_t queued = 0;
+static uint32_t dropped = 0;
+static int wakeup[2] = { -1, -1 };
+
+/* everything below is only used by the event loop */
+static const struct sink *sinks = NULL;
+static size_t limit = 0;
+static int fd = -1;
+static struct event event[2];
+static int watching = 0;
+static struct inform *pending = NULL;
+static size_t npending = 0;
+static int32_t RequestID = 0;
+static struct arena scratch;
+static uint8_t buf[UDP_DATAGRAM_SIZE];
+
+static void notify_log (const struct sink *sink,uint8_t type,const char *error)
+{
+   log_printf (LOG_WARNING,
+			   "%s to %u.%u.%u.%u:%u failed: %s\n",
+			   type == BER_InformRequest ? "inform" : "trap",
+			   NIPQUAD (sink->addr.sin_addr.s_addr),
+			   ntohs (sink->addr.sin_port),
+			   error);
+}
+
+static int notify_transmit (const struct sink *sink,uint8_t type,int32_t id,const struct notification *notification)
+{
+   snmp_pdu_t pdu;
+   ber_t ber;
+   ssize_t result;
+
+   memset (&pdu,0L,sizeof (snmp_pdu_t));
+   pdu.type = type;
+   pdu.version = SNMP_VERSION_2C;
+   pdu.community.buf = (uint8_t *) sink->community;
+   pdu.community.len = strlen (sink->community);
+   pdu.RequestID = id;
+
+   ber.buf = buf;
+   ber.offset = 0;
+   ber.size = limit;
+
+   if (snmp_encode_message (&ber,&pdu,notification->varbinds,notification->length))
+	 {
+		notify_log (sink,type,abz_get_error ());
+		return (-1);
+	 }
+
+   result = sendto (fd,ber.buf,ber.offset,0,(const struct sockaddr *) &sink->addr,sizeof (struct sockaddr_in));
+
+   if (result > 0)
+	 snmp_stats.snmpOutPkts++;
+
+   if (result != ber.offset)
+	 {
+		abz_set_error ("sendto failed: %m");
+		notify_log (sink,type,abz_get_error ());
+		return (-1);
+	 }
+
+   return (0);
+}
+
+static void notify_release (struct inform *inform)
+{
+   evtimer_del (&inform->event);
+
+   if (inform->prev != NULL)
+	 inform->prev->next = inform->next;
+   else
+	 pending = inform->next;
+
+   if (inform->next != NULL)
+	 inform->next->prev = inform->prev;
+
+   npending--;
+
+   if (!--inform->notification->refs)
+	 mem_free (inform->notification);
+
+   mem_free (inform);
+}
+
+static void notify_arm (struct inform *inform)
+{
+   struct timeval tv;
+
+   tv.tv_sec = inform->timeout;
+   tv.tv_usec = 0;
+
+   if (evtimer_add (&inform->event,&tv))
+	 {
+		notify_log (inform->sink,BER_InformRequest,"failed to add retransmission timer");
+		notify_release (inform);
+	 }
+}
+
+static void notify_timeout (int fd,short event,void *arg)
+{
+   struct inform *inform = arg;
+
+   worker_lock ();
+
+   if (inform->retries == NOTIFY_RETRIES)
+	 {
+		notify_log (inform->sink,BER_InformRequest,"no response");
+		notify_release (inform);
+	 }
+   else
+	 {
+		inform->retries++;
+		inform->timeout *= 2;
+
+		notify_transmit (inform->sink,BER_InformRequest,inform->RequestID,inform->notification);
+		notify_arm (inform);
+	 }
+
+   worker_unlock ();
+}
+
+static int32_t notify_request_id (void)
+{
+   if (++RequestID <= 0)
+	 RequestID = 1;
+
+   return (RequestID);
+}
+
+static void notify_deliver (struct notification *notification)
+{
+   const struct sink *sink;
+   struct inform *inform;
+
+   /* keep the notification around even if an inform is released early */
+   notification->refs++;
+
+   for (sink = sinks; sink != NULL; sink = sink->next)
+	 {
+		if (!sink->inform)
+		  {
+			 if (!notify_transmit (sink,BER_SNMPv2_Trap,notify_request_id (),notification))
+			   snmp_stats.snmpOutTraps++;
+
+			 continue;
+		  }
+
+		if (npending == NOTIFY_PENDING)
+		  {
+			 notify_log (sink,BER_InformRequest,"too many informs waiting for a response");
+			 continue;
+		  }
+
+		if ((inform = mem_alloc (sizeof (struct inform))) == NULL)
+		  {
+			 notify_log (sink,BER_InformRequest,"failed to allocate memory");
+			 continue;
+		  }
+
+		inform->sink = sink;
+		inform->notification = notification;
+		inform->RequestID = notify_request_id ();
+		inform->retries = 0;
+		inform->timeout = NOTIFY_TIMEOUT;
+		inform->prev = NULL;
+
+		if ((inform->next = pending) != NULL)
+		  pending->prev = inform;
+
+		pending = inform;
+		npending++;
+		notification->refs++;
+
+		evtimer_set (&inform->event,notify_timeout,inform);
+
+		/* if sending fails, the timer tries again */
+		notify_transmit (sink,BER_InformRequest,inform->RequestID,notification);
+		notify_arm (inform);
+	 }
+
+   if (!--notification->refs)
+	 mem_free (notification);
+}
+
+static void notify_wakeup (int fd,short event,void *arg)
+{
+   struct notification *list,*next;
+   uint8_t tmp[64];
+   uint32_t n;
+
+   while (read (fd,tmp,sizeof (tmp)) > 0)
+	 ;
+
+   pthread_mutex_lock (&lock);
+   list = head;
+   head = tail = NULL;
+   queued = 0;
+   n = dropped;
+   dropped = 0;
+   pthread_mutex_unlock (&lock);
+
+   worker_lock ();
+
+   if (n)
+	 log_printf (LOG_WARNING,"notification queue full, %u notifications dropped\n",n);
+
+   for ( ; list != NULL; list = next)
+	 {
+		next = list->next;
+		notify_deliver (list);
+	 }
+
+   worker_unlock ();
+}
+
+/*
+ * The only thing we expect on our socket are responses to informs.
+ */
+static void notify_receive (int fd,short event,void *arg)
+{
+   struct sockaddr_in addr;
+   socklen_t addrlen = sizeof (struct sockaddr_in);
+   struct inform *inform;
+   snmp_pdu_t pdu;
+   ber_t ber;
+   ssize_t result;
+
+   if ((result = recvfrom (fd,buf,sizeof (buf),0,(struct sockaddr *) &addr,&addrlen)) < 0)
+	 {
+		if (errno != EINTR && errno != EAGAIN)
+		  {
+			 worker_lock ();
+			 log_printf (LOG_WARNING,"recvfrom failed: %m\n");
+			 worker_unlock ();
+		  }
+
+		return;
+	 }
+
+   worker_lock ();
+
+   snmp_stats.snmpInPkts++;
+
+   ber.buf = buf;
+   ber.offset = 0;
+   ber.size = result;
+
+   /* any response acknowledges the inform, even one with an error status */
+   if (snmp_decode_response (&pdu,&ber,&scratch))
+	 log_printf (LOG_WARNING,
+				 "rejected packet from %u.%u.%u.%u:%u: not a response to an inform\n",
+				 NIPQUAD (addr.sin_addr.s_addr),
+				 ntohs (addr.sin_port));
+   else
+	 for (inform = pending; inform != NULL; inform = inform->next)
+	   if (inform->RequestID == pdu.RequestID &&
+		   inform->sink->addr.sin_addr.s_addr == addr.sin_addr.s_addr &&
+		   inform->sink->addr.sin_port == addr.sin_port)
+		 {
+			notify_release (inform);
+			break;
+		 }
+
+   arena_reset (&scratch);
+
+   worker_unlock ();
+}
+
+static int notify_nonblock (int fd)
+{
+   int flags;
+
+   if ((flags = fcntl (fd,F_GETFL)) < 0 || fcntl (fd,F_SETFL,flags | O_NONBLOCK))
+	 {
+		abz_set_error ("failed to set non-blocking i/o: %m");
+		return (-1);
+	 }
+
+   return (0);
+}
+
+int notify_open (const struct agent *agent)
+{
+   struct sockaddr_in addr;
+   const struct sink *sink;
+   size_t n = 0;
+
+   abz_clear_error ();
+
+   arena_create (&scratch);
+
+   if (agent->sink == NULL)
+	 return (0);
+
+   /* send from the address we listen on */
+   memcpy (&addr,&agent->listen,sizeof (struct sockaddr_in));
+   addr.sin_port = 0;
+
+   if ((fd = socket (AF_INET,SOCK_DGRAM,IPPROTO_UDP)) < 0)
+	 {
+		abz_set_error ("failed to create socket: %m");
+		return (-1);
+	 }
+
+   if (bind (fd,(struct sockaddr *) &addr,sizeof (struct sockaddr_in)))
+	 {
+		abz_set_error ("failed to bind to %u.%u.%u.%u: %m",NIPQUAD (addr.sin_addr.s_addr));
+		notify_close ();
+		return (-1);
+	 }
+
+   if (pipe (wakeup))
+	 {
+		abz_set_error ("failed to create pipe: %m");
+		notify_close ();
+		return (-1);
+	 }
+
+   if (notify_nonblock (fd) || notify_nonblock (wakeup[0]) || notify_nonblock (wakeup[1]))
+	 {
+		notify_close ();
+		return (-1);
+	 }
+
+   event_set (event,fd,EV_READ | EV_PERSIST,notify_receive,NULL);
+   event_set (event + 1,wakeup[0],EV_READ | EV_PERSIST,notify_wakeup,NULL);
+
+   if (event_add (event,NULL))
+	 {
+		abz_set_error ("failed to add event handler: %m");
+		notify_close ();
+		return (-1);
+	 }
+
+   if (event_add (event + 1,NULL))
+	 {
+		abz_set_error ("failed to add event handler: %m");
+		event_del (event);
+		notify_close ();
+		return (-1);
+	 }
+
+   watching = 1;
+   RequestID = (time (NULL) ^ getpid ()) & 0x7fffff;
+   limit = agent->response;
+
+   for (sink = agent->sink; sink != NULL; sink = sink->next)
+	 n++;
+
+   log_printf (LOG_VERBOSE,"sending notifications to %u sinks\n",(unsigned) n);
+
+   /* from here on, notify_send() queues notifications */
+   __atomic_store_n (&sinks,agent->sink,__ATOMIC_RELEASE);
+
+   return (0);
+}
+
+void notify_close (void)
+{
+   struct notification *notification;
+
+   __atomic_store_n (&sinks,NULL,__ATOMIC_RELEASE);
+
+   if (watching)
+	 {
+		event_del (event);
+		event_del (event + 1);
+		watching = 0;
+	 }
+
+   while (pending != NULL)
+	 notify_release (pending);
+
+   pthread_mutex_lock (&lock);
+
+   while (head != NULL)
+	 {
+		notification = head;
+		head = head->next;
+		mem_free (notification);
+	 }
+
+   tail = NULL;
+   queued = 0;
+   dropped = 0;
+
+   if (wakeup[0] >= 0)
+	 {
+		close (wakeup[0]);
+		close (wakeup[1]);
+		wakeup[0] = wakeup[1] = -1;
+	 }
+
+   pthread_mutex_unlock (&lock);
+
+   if (fd >= 0)
+	 {
+		close (fd);
+		fd = -1;
+	 }
+
+   arena_destroy (&scratch);
+}
+
+int notify_send (const uint32_t *trap,const snmp_next_value_t *varbind,size_t n)
+{
+   static const uint32_t sysUpTime[9] = { 8, 43, 6, 1, 2, 1, 1, 3, 0 };
+   static const uint32_t snmpTrapOID[11] = { 10, 43, 6, 1, 6, 3, 1, 1, 4, 1, 0 };
+   snmp_next_value_t first[2];
+   struct notification *notification;
+   struct sysinfo si;
+   size_t length,more = 0;
+   int empty;
+
+   abz_clear_error ();
+
+   if (__atomic_load_n (&sinks,__ATOMIC_ACQUIRE) == NULL)
+	 return (0);
+
+   if (sysinfo (&si))
+	 {
+		abz_set_error ("sysinfo: %m");
+		return (-1);
+	 }
+
+   /* every notification starts with sysUpTime.0 and snmpTrapOID.0 */
+   first[0].oid = (uint32_t *) sysUpTime;
+   first[0].value.type = BER_TimeTicks;
+   first[0].value.data.TimeTicks = si.uptime * 100;
+   first[1].oid = (uint32_t *) snmpTrapOID;
+   first[1].value.type = BER_OID;
+   first[1].value.data.OID = (uint32_t *) trap;
+
+   if ((notification = mem_alloc (sizeof (struct notification) + limit)) == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		return (-1);
+	 }
+
+   if (!(length = snmp_encode_varbinds (notification->varbinds,limit,first,ARRAYSIZE (first))) ||
+	   (n && !(more = snmp_encode_varbinds (notification->varbinds + length,limit - length,varbind,n))))
+	 {
+		mem_free (notification);
+		return (-1);
+	 }
+
+   notification->next = NULL;
+   notification->refs = 0;
+   notification->length = length + more;
+
+   pthread_mutex_lock (&lock);
+
+   if (wakeup[1] < 0 || queued == NOTIFY_QUEUE)
+	 {
+		dropped += wakeup[1] >= 0;
+		pthread_mutex_unlock (&lock);
+		mem_free (notification);
+		abz_set_error ("too many notifications queued");
+		return (-1);
+	 }
+
+   if (tail != NULL)
+	 tail->next = notification;
+   else
+	 head = notification;
+
+   tail = notification;
+   empty = !queued++;
+
+   /* a single byte is enough to wake up the event loop */
+   if (empty)
+	 while (write (wakeup[1],"",1) < 0 && errno == EINTR)
+	   ;
+
+   pthread_mutex_unlock (&lock);
+
+   return (0);
+}
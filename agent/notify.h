@@ -0,0 +1,63 @@
+#ifndef NOTIFY_H
+#define NOTIFY_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <tinysnmp/agent/notify.h>
+
+#include "agent.h"
+
+/* maximum number of notifications waiting to be sent */
+#define NOTIFY_QUEUE 64
+
+/* maximum number of informs waiting to be acknowledged */
+#define NOTIFY_PENDING 64
+
+/*
+ * Informs which aren't acknowledged are sent again after 1, 2, 4
+ * and 8 seconds, then we give up.
+ */
+#define NOTIFY_TIMEOUT 1
+#define NOTIFY_RETRIES 4
+
+/*
+ * Create the socket notifications are sent from and start sending
+ * queued notifications to the sinks of the agent. This should be
+ * called after event_init(). Returns 0 if successful, -1 if some
+ * error occurred. Call abz_get_error() to retrieve the error message.
+ */
+extern int notify_open (const struct agent *agent);
+
+/*
+ * Stop sending notifications. Notifications which are still queued
+ * and informs which weren't acknowledged yet are discarded.
+ */
+extern void notify_close (void);
+
+#endif	/* #ifndef NOTIFY_H */
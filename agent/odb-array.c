@@ -0,0 +1,466 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef ODB_ARRAY
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <abz/typedefs.h>
+#include <abz/error.h>
+#include <debug/memory.h>
+
+#include <tinysnmp/tinysnmp.h>
+#include <tinysnmp/agent/odb.h>
+
+#include "arena.h"
+#include "value.h"
+#include "oidcmp.h"
+
+/* number of leaves to allocate at a time */
+#define LEAF_CHUNK 64
+
+struct odb_leaf
+{
+   uint32_t *oid;
+   snmp_value_t value;
+};
+
+/*
+ * ObjectID's and values are allocated from the arena, so only the
+ * leaf array itself is allocated separately.
+ */
+struct odb
+{
+   struct odb_leaf *leaf;		/* leaves, lexographically ordered up to sorted	*/
+   uint32_t sorted;				/* number of leaves which are in order			*/
+   uint32_t n;					/* number of leaves in the database				*/
+   uint32_t size;				/* number of leaves allocated					*/
+   struct arena arena;
+};
+
+static void out_of_memory (void)
+{
+   abz_set_error ("failed to allocate memory: %m");
+}
+
+static void oid_exist (void)
+{
+   abz_set_error ("object identifier (or superset of) already exist");
+}
+
+static void oid_missing (void)
+{
+   abz_set_error ("object identifier not found");
+}
+
+void odb_create (struct odb **odb)
+{
+   *odb = NULL;
+}
+
+void odb_destroy (struct odb **odb)
+{
+   if (*odb != NULL)
+	 {
+		if ((*odb)->leaf != NULL)
+		  mem_free ((*odb)->leaf);
+
+		arena_destroy (&(*odb)->arena);
+		mem_free (*odb);
+		*odb = NULL;
+	 }
+}
+
+void odb_clear (struct odb **odb)
+{
+   if (*odb != NULL)
+	 {
+		(*odb)->sorted = (*odb)->n = 0;
+		arena_reset (&(*odb)->arena);
+	 }
+}
+
+size_t odb_size (const struct odb *odb)
+{
+   return (odb != NULL ?
+		   sizeof (struct odb) + odb->size * sizeof (struct odb_leaf) + odb->arena.used :
+		   0);
+}
+
+static int leafcmp (const void *a,const void *b)
+{
+   return (oidcmp (((const struct odb_leaf *) a)->oid,((const struct odb_leaf *) b)->oid));
+}
+
+/*
+ * Return the index of the first leaf in the sorted part of the
+ * database which doesn't precede oid (if upper is zero) or which
+ * succeeds oid (if upper is non-zero).
+ */
+static uint32_t leaf_search (const struct odb *odb,const uint32_t *oid,int upper)
+{
+   uint32_t lo = 0,hi = odb->sorted;
+
+   while (lo < hi)
+	 {
+		uint32_t mid = lo + (hi - lo) / 2;
+		int result = oidcmp (odb->leaf[mid].oid,oid);
+
+		if (result < 0 || (upper && !result))
+		  lo = mid + 1;
+		else
+		  hi = mid;
+	 }
+
+   return (lo);
+}
+
+/*
+ * Returns non-zero if oid is a prefix of, or is prefixed by, any of
+ * the leaves in the sorted part of the database.
+ */
+static int leaf_conflict (const struct odb *odb,const uint32_t *oid)
+{
+   uint32_t i = leaf_search (odb,oid,0);
+
+   return ((i < odb->sorted && oidsub (oid,odb->leaf[i].oid)) ||
+		   (i > 0 && oidsub (odb->leaf[i - 1].oid,oid)));
+}
+
+static int leaf_copy (struct odb *odb,struct odb_leaf *leaf,const uint32_t *oid,const snmp_value_t *value)
+{
+   size_t len = (oid[0] + 1) * sizeof (uint32_t);
+
+   if ((leaf->oid = arena_alloc (&odb->arena,len)) == NULL)
+	 return (-1);
+
+   memcpy (leaf->oid,oid,len);
+
+   return (value_dup (&odb->arena,&leaf->value,value));
+}
+
+int odb_add (struct odb **odb,const uint32_t *oid,const snmp_value_t *value)
+{
+   struct odb *db;
+   int append;
+
+   abz_clear_error ();
+
+   if (!oid[0])
+	 {
+		oid_exist ();
+		return (-1);
+	 }
+
+   if (*odb == NULL)
+	 {
+		if ((*odb = mem_alloc (sizeof (struct odb))) == NULL)
+		  {
+			 out_of_memory ();
+			 return (-1);
+		  }
+
+		memset (*odb,0L,sizeof (struct odb));
+		arena_create (&(*odb)->arena);
+	 }
+
+   db = *odb;
+
+   /*
+	* Modules mostly add their ObjectID's in order, so we simply append
+	* those. Everything else is checked against the sorted leaves and
+	* put at the end until odb_sort() is called.
+	*/
+
+   append = db->sorted == db->n &&
+	 (!db->n || oidcmp (db->leaf[db->n - 1].oid,oid) < 0);
+
+   if (append ?
+	   db->n && oidsub (db->leaf[db->n - 1].oid,oid) :
+	   leaf_conflict (db,oid))
+	 {
+		oid_exist ();
+		return (-1);
+	 }
+
+   if (db->n == db->size)
+	 {
+		struct odb_leaf *ptr;
+
+		if ((ptr = mem_realloc (db->leaf,(db->size + LEAF_CHUNK) * sizeof (struct odb_leaf))) == NULL)
+		  {
+			 out_of_memory ();
+			 return (-1);
+		  }
+
+		db->leaf = ptr;
+		db->size += LEAF_CHUNK;
+	 }
+
+   if (leaf_copy (db,db->leaf + db->n,oid,value))
+	 return (-1);
+
+   if (append)
+	 db->sorted++;
+
+   db->n++;
+
+   return (0);
+}
+
+int odb_sort (struct odb **odb)
+{
+   struct odb *db = *odb;
+   struct odb_leaf *tail;
+   uint32_t i,j,k,n;
+
+   abz_clear_error ();
+
+   if (db == NULL || db->sorted == db->n)
+	 return (0);
+
+   n = db->n - db->sorted;
+
+   qsort (db->leaf + db->sorted,n,sizeof (struct odb_leaf),leafcmp);
+
+   /*
+	* Leaves which were added out of order have only been checked
+	* against the sorted ones. Since a prefix always sorts directly
+	* before the ObjectID's it prefixes, comparing neighbours is
+	* enough to catch the rest.
+	*/
+
+   for (i = db->sorted + 1; i < db->n; i++)
+	 if (oidsub (db->leaf[i - 1].oid,db->leaf[i].oid))
+	   {
+		  oid_exist ();
+		  return (-1);
+	   }
+
+   if ((tail = mem_alloc (n * sizeof (struct odb_leaf))) == NULL)
+	 {
+		out_of_memory ();
+		return (-1);
+	 }
+
+   memcpy (tail,db->leaf + db->sorted,n * sizeof (struct odb_leaf));
+
+   /* merge from the back so that nothing gets overwritten */
+
+   for (i = db->sorted, j = n, k = db->n; j; )
+	 if (i && oidcmp (db->leaf[i - 1].oid,tail[j - 1].oid) > 0)
+	   db->leaf[--k] = db->leaf[--i];
+	 else
+	   db->leaf[--k] = tail[--j];
+
+   mem_free (tail);
+
+   db->sorted = db->n;
+
+   return (0);
+}
+
+void odb_remove (struct odb **odb,const uint32_t *oid)
+{
+   struct odb *db = *odb;
+   uint32_t i,j,removed = 0;
+
+   if (db == NULL || !oid[0])
+	 return;
+
+   if (db->sorted == db->n)
+	 {
+		/* all the leaves below oid are next to each other */
+
+		i = j = leaf_search (db,oid,0);
+
+		while (j < db->n && oidsub (oid,db->leaf[j].oid))
+		  j++;
+
+		memmove (db->leaf + i,db->leaf + j,(db->n - j) * sizeof (struct odb_leaf));
+
+		db->n -= j - i;
+		db->sorted = db->n;
+
+		return;
+	 }
+
+   for (i = j = 0; i < db->n; i++)
+	 {
+		if (oidsub (oid,db->leaf[i].oid))
+		  {
+			 if (i < db->sorted)
+			   removed++;
+
+			 continue;
+		  }
+
+		if (i != j)
+		  db->leaf[j] = db->leaf[i];
+
+		j++;
+	 }
+
+   db->sorted -= removed;
+   db->n = j;
+}
+
+const snmp_value_t *odb_find (const struct odb *odb,const uint32_t *oid)
+{
+   uint32_t i;
+
+   abz_clear_error ();
+
+   if (odb != NULL && oid[0])
+	 {
+		i = leaf_search (odb,oid,0);
+
+		if (i < odb->sorted && !oidcmp (odb->leaf[i].oid,oid))
+		  return (&odb->leaf[i].value);
+
+		for (i = odb->sorted; i < odb->n; i++)
+		  if (!oidcmp (odb->leaf[i].oid,oid))
+			return (&odb->leaf[i].value);
+	 }
+
+   oid_missing ();
+   return (NULL);
+}
+
+int odb_find_next_ref (const struct odb *odb,const uint32_t *oid,uint32_t *next,size_t size,const snmp_value_t **value)
+{
+   const struct odb_leaf *leaf = NULL;
+   uint32_t i;
+
+   abz_clear_error ();
+
+   if (odb != NULL && oid[0])
+	 {
+		if ((i = leaf_search (odb,oid,1)) < odb->sorted)
+		  leaf = odb->leaf + i;
+
+		for (i = odb->sorted; i < odb->n; i++)
+		  if (oidcmp (odb->leaf[i].oid,oid) > 0 &&
+			  (leaf == NULL || oidcmp (odb->leaf[i].oid,leaf->oid) < 0))
+			leaf = odb->leaf + i;
+	 }
+
+   if (leaf == NULL)
+	 {
+		oid_missing ();
+		return (1);
+	 }
+
+   if (leaf->oid[0] >= size)
+	 {
+		abz_set_error ("object identifier too long");
+		return (-1);
+	 }
+
+   memcpy (next,leaf->oid,(leaf->oid[0] + 1) * sizeof (uint32_t));
+   *value = &leaf->value;
+
+   return (0);
+}
+
+snmp_next_value_t *odb_find_next (const struct odb *odb,const uint32_t *oid)
+{
+   uint32_t tmp[ODB_OID_MAX + 1];
+   const snmp_value_t *value;
+   snmp_next_value_t *next;
+   size_t len;
+
+   if (odb_find_next_ref (odb,oid,tmp,ARRAYSIZE (tmp),&value))
+	 return (NULL);
+
+   if ((next = mem_alloc (sizeof (snmp_next_value_t))) == NULL)
+	 {
+		out_of_memory ();
+		return (NULL);
+	 }
+
+   len = (tmp[0] + 1) * sizeof (uint32_t);
+
+   if ((next->oid = mem_alloc (len)) == NULL)
+	 {
+		out_of_memory ();
+		mem_free (next);
+		return (NULL);
+	 }
+
+   memcpy (next->oid,tmp,len);
+
+   if (value_copy (&next->value,value))
+	 {
+		mem_free (next->oid);
+		mem_free (next);
+		return (NULL);
+	 }
+
+   return (next);
+}
+
+#ifdef DEBUG
+
+#include <debug/log.h>
+
+int odb_show_stub (const char *filename,int line,const char *function,
+				   int level,const struct odb *odb)
+{
+   uint32_t i,j;
+
+   abz_clear_error ();
+
+   if (odb != NULL)
+	 for (i = 0; i < odb->n; i++)
+	   {
+		  const uint32_t *oid = odb->leaf[i].oid;
+
+		  log_printf_stub (filename,line,function,level,
+						   "%c %" PRIu32 ".%" PRIu32,
+						   i < odb->sorted ? ' ' : '*',
+						   oid[1] / 40,oid[1] % 40);
+
+		  for (j = 2; j <= oid[0]; j++)
+			log_printf_stub (filename,line,function,level,".%" PRIu32,oid[j]);
+
+		  log_puts_stub (filename,line,function,level," :: ");
+		  value_show_stub (filename,line,function,level,&odb->leaf[i].value);
+		  log_putc_stub (filename,line,function,level,'\n');
+	   }
+
+   return (0);
+}
+
+#endif	/* #ifdef DEBUG */
+
+#endif	/* #ifdef ODB_ARRAY */
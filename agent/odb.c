@@ -27,10 +27,13 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#ifndef ODB_ARRAY
+
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
+#include <abz/typedefs.h>
 #include <abz/error.h>
 #include <debug/memory.h>
 
@@ -38,17 +41,43 @@
 #include <tinysnmp/unaligned.h>
 #include <tinysnmp/agent/odb.h>
 
+#include "arena.h"
+#include "value.h"
+
+typedef enum { NODE, VALUE } node_t;
+
+struct tree
+{
+   node_t type;
+   union
+	 {
+		uint32_t node;
+		snmp_value_t value;
+	 } data;
+   struct tree *parent;
+   struct tree *sibling;
+   struct tree *child;
+};
+
+struct odb
+{
+   struct tree *root;
+   struct arena arena;
+};
+
 struct node
 {
    uint32_t n;
    const uint32_t *oid;
    snmp_value_t value;
+   struct arena *arena;
 };
 
 struct branch
 {
    uint32_t *oid;
-   const snmp_value_t *value;
+   size_t size;
+   int error;		/* set if the ObjectID found didn't fit	*/
 };
 
 static void out_of_memory (void)
@@ -71,76 +100,42 @@ void odb_create (struct odb **odb)
    *odb = NULL;
 }
 
-static void snmp_free_value (snmp_value_t *value)
-{
-   if (value->type == BER_OID)
-	 mem_free (value->data.OID);
-   else if (value->type == BER_OCTET_STRING && value->data.OCTET_STRING.len)
-	 mem_free (value->data.OCTET_STRING.buf);
-}
-
-static int snmp_copy_value (snmp_value_t *dest,const snmp_value_t *src)
+void odb_destroy (struct odb **odb)
 {
-   copy_unaligned (dest,src);
-
-   if (src->type == BER_OCTET_STRING)
-	 {
-		uint32_t len = src->data.OCTET_STRING.len;
-
-		if (len)
-		  {
-			 if ((dest->data.OCTET_STRING.buf = mem_alloc (len)) == NULL)
-			   {
-				  out_of_memory ();
-				  return (-1);
-			   }
-
-			 memcpy (dest->data.OCTET_STRING.buf,src->data.OCTET_STRING.buf,len);
-		  }
-	 }
-   else if (src->type == BER_OID)
+   if (*odb != NULL)
 	 {
-		uint32_t len = (src->data.OID[0] + 1) * sizeof (uint32_t);
-
-		if ((dest->data.OID = mem_alloc (len)) == NULL)
-		  {
-			 out_of_memory ();
-			 return (-1);
-		  }
-
-		memcpy (dest->data.OID,src->data.OID,len);
+		arena_destroy (&(*odb)->arena);
+		mem_free (*odb);
+		*odb = NULL;
 	 }
-
-   return (0);
 }
 
-void odb_destroy (struct odb **odb)
+void odb_clear (struct odb **odb)
 {
    if (*odb != NULL)
 	 {
-		if ((*odb)->sibling != NULL)
-		  odb_destroy (&(*odb)->sibling);
-
-		if ((*odb)->child != NULL)
-		  odb_destroy (&(*odb)->child);
-
-		if ((*odb)->type == VALUE)
-		  snmp_free_value (&(*odb)->data.value);
-
-		mem_free (*odb);
-		*odb = NULL;
+		(*odb)->root = NULL;
+		arena_reset (&(*odb)->arena);
 	 }
 }
 
-static struct odb *tree_create (node_t type,const struct node *node)
+size_t odb_size (const struct odb *odb)
 {
-   struct odb *odb;
+   return (odb != NULL ? sizeof (struct odb) + odb->arena.used : 0);
+}
 
-   if ((odb = mem_alloc (sizeof (struct odb))) == NULL)
-	 {
-		out_of_memory ();
-		return (NULL);
-	 }
+/*
+ * Nodes and values are allocated from the arena of the database and
+ * are only released by odb_clear() or odb_destroy(), so nodes which
+ * are unlinked from the tree are simply dropped.
+ */
+
+static struct tree *tree_create (node_t type,const struct node *node)
+{
+   struct tree *odb;
+
+   if ((odb = arena_alloc (node->arena,sizeof (struct tree))) == NULL)
+	 return (NULL);
 
    odb->type = type;
    odb->parent = odb->sibling = odb->child = NULL;
@@ -154,17 +149,15 @@ static struct odb *tree_create (node_t type,const struct node *node)
 }
 
 /* declaration needed by tree_add_sibling() and tree_add_child() */
-static int tree_add (struct odb **,const struct node *);
+static int tree_add (struct tree **,const struct node *);
 
-static int tree_add_sibling (struct odb **odb,const struct node *node)
+static int tree_add_sibling (struct tree **odb,const struct node *node)
 {
    if (tree_add (&(*odb)->sibling,node))
 	 {
 		if ((*odb)->sibling != NULL && (*odb)->sibling->child == NULL)
 		  {
-			 struct odb *sibling = (*odb)->sibling;
 			 (*odb)->sibling = (*odb)->sibling->sibling;
-			 mem_free (sibling);
 		  }
 
 		return (-1);
@@ -176,12 +169,13 @@ static int tree_add_sibling (struct odb **odb,const struct node *node)
    return (0);
 }
 
-static int tree_add_child (struct odb **odb,const struct node *node)
+static int tree_add_child (struct tree **odb,const struct node *node)
 {
    struct node next =
 	 {
 		.n		= node->n - 1,
-		.oid	= node->oid + 1
+		.oid	= node->oid + 1,
+		.arena	= node->arena
 	 };
 
    memcpy (&next.value,&node->value,sizeof (snmp_value_t));
@@ -189,10 +183,7 @@ static int tree_add_child (struct odb **odb,const struct node *node)
    if (tree_add (&(*odb)->child,&next))
 	 {
 		if ((*odb)->child == NULL && (*odb)->sibling == NULL)
-		  {
-			 mem_free (*odb);
-			 *odb = NULL;
-		  }
+		  *odb = NULL;
 
 		return (-1);
 	 }
@@ -203,7 +194,7 @@ static int tree_add_child (struct odb **odb,const struct node *node)
    return (0);
 }
 
-static int tree_add (struct odb **odb,const struct node *node)
+static int tree_add (struct tree **odb,const struct node *node)
 {
    if (!node->n)
 	 {
@@ -228,7 +219,7 @@ static int tree_add (struct odb **odb,const struct node *node)
 	 {
 		if ((*odb)->data.node > node->oid[0])
 		  {
-			 struct odb *tmp;
+			 struct tree *tmp;
 
 			 if ((tmp = tree_create (NODE,node)) == NULL)
 			   return (-1);
@@ -261,19 +252,34 @@ int odb_add (struct odb **odb,const uint32_t *oid,const snmp_value_t *value)
 
    abz_clear_error ();
 
-   if (snmp_copy_value (&node.value,value))
-	 return (-1);
-
-   if (tree_add (odb,&node))
+   if (*odb == NULL)
 	 {
-		snmp_free_value (&node.value);
-		return (-1);
+		if ((*odb = mem_alloc (sizeof (struct odb))) == NULL)
+		  {
+			 out_of_memory ();
+			 return (-1);
+		  }
+
+		(*odb)->root = NULL;
+		arena_create (&(*odb)->arena);
 	 }
 
+   node.arena = &(*odb)->arena;
+
+   if (value_dup (node.arena,&node.value,value))
+	 return (-1);
+
+   return (tree_add (&(*odb)->root,&node));
+}
+
+int odb_sort (struct odb **odb)
+{
+   /* the tree is kept in order while adding ObjectID's */
+   abz_clear_error ();
    return (0);
 }
 
-static int tree_remove (struct odb **odb,struct node *node)
+static int tree_remove (struct tree **odb,struct node *node)
 {
    if (*odb == NULL ||
 	   (*odb)->child == NULL ||
@@ -286,7 +292,7 @@ static int tree_remove (struct odb **odb,struct node *node)
 	 {
 		if ((*odb)->sibling != NULL)
 		  {
-			 struct odb *sibling = (*odb)->sibling->sibling;
+			 struct tree *sibling = (*odb)->sibling->sibling;
 
 			 if (tree_remove (&(*odb)->sibling,node))
 			   return (-1);
@@ -302,10 +308,8 @@ static int tree_remove (struct odb **odb,struct node *node)
 
    if (node->n == 1)
 	 {
-		struct odb *sibling = (*odb)->sibling;
+		struct tree *sibling = (*odb)->sibling;
 
-		(*odb)->sibling = NULL;
-		odb_destroy (odb);
 		*odb = sibling;
 
 		return (0);
@@ -318,7 +322,7 @@ static int tree_remove (struct odb **odb,struct node *node)
 			 .n		= node->n - 1,
 			 .oid	= node->oid + 1
 		  };
-		struct odb *child = (*odb)->child->sibling;
+		struct tree *child = (*odb)->child->sibling;
 
 		if (tree_remove (&(*odb)->child,&next))
 		  return (-1);
@@ -327,12 +331,7 @@ static int tree_remove (struct odb **odb,struct node *node)
 		  (*odb)->child = child;
 
 		if ((*odb)->child == NULL)
-		  {
-			 struct odb *sibling = (*odb)->sibling;
-
-			 mem_free (*odb);
-			 *odb = sibling;
-		  }
+		  *odb = (*odb)->sibling;
 
 		return (0);
 	 }
@@ -348,10 +347,11 @@ void odb_remove (struct odb **odb,const uint32_t *oid)
 		.oid	= oid + 1
 	 };
 
-   tree_remove (odb,&node);
+   if (*odb != NULL)
+	 tree_remove (&(*odb)->root,&node);
 }
 
-static const snmp_value_t *tree_find (const struct odb *odb,struct node *node)
+static const snmp_value_t *tree_find (const struct tree *odb,struct node *node)
 {
    struct node next;
 
@@ -383,31 +383,24 @@ const snmp_value_t *odb_find (const struct odb *odb,const uint32_t *oid)
 
    abz_clear_error ();
 
-   return (tree_find (odb,&node));
+   return (tree_find (odb != NULL ? odb->root : NULL,&node));
 }
 
-static struct branch *tree_find_first (const struct odb *odb)
+static const snmp_value_t *tree_find_first (const struct tree *odb,struct branch *branch)
 {
-   struct branch *branch;
-   const struct odb *tmp;
+   const struct tree *tmp;
    uint32_t i,n = 1;
 
-   if ((branch = mem_alloc (sizeof (struct branch))) == NULL)
-	 {
-		out_of_memory ();
-		return (NULL);
-	 }
-
    while (odb->child->type != VALUE)
 	 odb = odb->child;
 
    for (tmp = odb->parent; tmp != NULL; tmp = tmp->parent)
 	 n++;
 
-   if ((branch->oid = mem_alloc ((n + 1) * sizeof (uint32_t))) == NULL)
+   if (n >= branch->size)
 	 {
-		out_of_memory ();
-		mem_free (branch);
+		abz_set_error ("object identifier too long");
+		branch->error = 1;
 		return (NULL);
 	 }
 
@@ -416,12 +409,10 @@ static struct branch *tree_find_first (const struct odb *odb)
    for (tmp = odb, i = n; tmp != NULL; tmp = tmp->parent)
 	 branch->oid[i--] = tmp->data.node;
 
-   branch->value = &odb->child->data.value;
-
-   return (branch);
+   return (&odb->child->data.value);
 }
 
-static struct branch *tree_find_next (const struct odb *odb,const struct node *node)
+static const snmp_value_t *tree_find_next (const struct tree *odb,const struct node *node,struct branch *branch)
 {
    if (odb == NULL ||
 	   odb->child == NULL ||
@@ -433,33 +424,38 @@ static struct branch *tree_find_next (const struct odb *odb,const struct node *n
 	 }
 
    if (odb->data.node > node->oid[0])
-	 return (tree_find_first (odb));
+	 return (tree_find_first (odb,branch));
 
    if (odb->data.node == node->oid[0])
 	 {
 		if (node->n != 1)
 		  {
-			 struct branch *branch;
+			 const snmp_value_t *value;
 			 struct node next =
 			   {
 				  .n	= node->n - 1,
 				  .oid	= node->oid + 1
 			   };
 
-			 if ((branch = tree_find_next (odb->child,&next)) != NULL)
-			   return (branch);
+			 /* don't skip the instance that didn't fit */
+			 if ((value = tree_find_next (odb->child,&next,branch)) != NULL || branch->error)
+			   return (value);
 		  }
 		else if (odb->child->child != NULL)
-		  return (tree_find_first (odb));
+		  return (tree_find_first (odb,branch));
 	 }
 
-   return (tree_find_next (odb->sibling,node));
+   return (tree_find_next (odb->sibling,node,branch));
 }
 
-snmp_next_value_t *odb_find_next (const struct odb *odb,const uint32_t *oid)
+int odb_find_next_ref (const struct odb *odb,const uint32_t *oid,uint32_t *next,size_t size,const snmp_value_t **value)
 {
-   struct branch *branch;
-   snmp_next_value_t *next;
+   struct branch branch =
+	 {
+		.oid	= next,
+		.size	= size,
+		.error	= 0
+	 };
    struct node node =
 	 {
 		.n		= oid[0],
@@ -468,27 +464,45 @@ snmp_next_value_t *odb_find_next (const struct odb *odb,const uint32_t *oid)
 
    abz_clear_error ();
 
-   if ((branch = tree_find_next (odb,&node)) == NULL)
+   if ((*value = tree_find_next (odb != NULL ? odb->root : NULL,&node,&branch)) == NULL)
+	 return (branch.error ? -1 : 1);
+
+   return (0);
+}
+
+snmp_next_value_t *odb_find_next (const struct odb *odb,const uint32_t *oid)
+{
+   uint32_t tmp[ODB_OID_MAX + 1];
+   const snmp_value_t *value;
+   snmp_next_value_t *next;
+   size_t len;
+
+   if (odb_find_next_ref (odb,oid,tmp,ARRAYSIZE (tmp),&value))
 	 return (NULL);
 
    if ((next = mem_alloc (sizeof (snmp_next_value_t))) == NULL)
 	 {
 		out_of_memory ();
-		mem_free (branch->oid);
-		mem_free (branch);
 		return (NULL);
 	 }
 
-   next->oid = branch->oid;
+   len = (tmp[0] + 1) * sizeof (uint32_t);
 
-   if (snmp_copy_value (&next->value,branch->value))
+   if ((next->oid = mem_alloc (len)) == NULL)
 	 {
-		mem_free (branch->oid);
-		mem_free (branch);
+		out_of_memory ();
+		mem_free (next);
 		return (NULL);
 	 }
 
-   mem_free (branch);
+   memcpy (next->oid,tmp,len);
+
+   if (value_copy (&next->value,value))
+	 {
+		mem_free (next->oid);
+		mem_free (next);
+		return (NULL);
+	 }
 
    return (next);
 }
@@ -497,7 +511,7 @@ snmp_next_value_t *odb_find_next (const struct odb *odb,const uint32_t *oid)
 
 #include <debug/log.h>
 
-static uint32_t tree_get_depth (const struct odb *odb,uint32_t depth)
+static uint32_t tree_get_depth (const struct tree *odb,uint32_t depth)
 {
    if (odb != NULL && odb->child != NULL)
 	 {
@@ -519,160 +533,8 @@ static uint32_t tree_get_depth (const struct odb *odb,uint32_t depth)
    return (depth);
 }
 
-static void tree_show_integer (const char *filename,int line,const char *function,
-							   int level,const snmp_value_t *value)
-{
-   log_printf_stub (filename,line,function,level,
-					"INTEGER %" PRId32,
-					value->data.INTEGER);
-}
-
-static void tree_show_counter32 (const char *filename,int line,const char *function,
-								 int level,const snmp_value_t *value)
-{
-   log_printf_stub (filename,line,function,level,
-					"Counter32 %" PRIu32,
-					value->data.Counter32);
-}
-
-static void tree_show_gauge32 (const char *filename,int line,const char *function,
-							   int level,const snmp_value_t *value)
-{
-   log_printf_stub (filename,line,function,level,
-					"Gauge32 %" PRIu32,
-					value->data.Gauge32);
-}
-
-static void tree_show_timeticks (const char *filename,int line,const char *function,
-								 int level,const snmp_value_t *value)
-{
-   uint32_t day,ms,sec,min,hour;
-
-   log_printf_stub (filename,line,function,level,
-					"TimeTicks (%" PRIu32 ") ",
-					value->data.TimeTicks);
-
-   ms = value->data.TimeTicks % 100, day = (value->data.TimeTicks - ms) / 100;
-   sec = day % 60, day = (day - sec) / 60;
-   min = day % 60, day = (day - min) / 60;
-   hour = day % 24, day = (day - hour) / 24;
-
-   if (day)
-	 log_printf_stub (filename,line,function,level,
-					  "%" PRIu32 " day%s, ",
-					  day,day > 1 ? "s" : "");
-
-   log_printf_stub (filename,line,function,level,
-					"%02" PRIu32 ":%02" PRIu32 ":%02" PRIu32 ".%02" PRIu32,
-					hour,min,sec,ms);
-}
-
-static void tree_show_counter64 (const char *filename,int line,const char *function,
-								 int level,const snmp_value_t *value)
-{
-   log_printf_stub (filename,line,function,level,
-					"Counter64 %" PRIu64,
-					value->data.Counter64);
-}
-
-static void tree_show_oid (const char *filename,int line,const char *function,
-						   int level,const snmp_value_t *value)
-{
-   uint32_t i;
-
-   log_printf_stub (filename,line,function,level,
-					"OBJECT IDENTIFIER %" PRIu32 ".%" PRIu32,
-					value->data.OID[1] / 40,value->data.OID[1] % 40);
-
-   for (i = 2; i <= value->data.OID[0]; i++)
-	 log_printf_stub (filename,line,function,level,
-					  ".%" PRIu32,
-					  value->data.OID[i]);
-}
-
-static __inline__ int printable (int c)
-{
-   return ((c >= 32 && c <= 126) ||
-		   (c >= 174 && c <= 223) ||
-		   (c >= 242 && c <= 243) ||
-		   (c >= 252 && c <= 253));
-}
-
-static void tree_show_octet_string (const char *filename,int line,const char *function,
-									int level,const snmp_value_t *value)
-{
-   uint32_t i;
-   int raw = 0;
-
-   log_puts_stub (filename,line,function,level,"OCTET STRING");
-
-   for (i = 0; i < value->data.OCTET_STRING.len && !raw; i++)
-	 if (!printable (value->data.OCTET_STRING.buf[i]))
-	   raw = 1;
-
-   if (!raw)
-	 {
-		log_putc_stub (filename,line,function,level,' ');
-
-		for (i = 0; i < value->data.OCTET_STRING.len; i++)
-		  log_putc_stub (filename,line,function,level,value->data.OCTET_STRING.buf[i]);
-	 }
-   else
-	 {
-		for (i = 0; i < value->data.OCTET_STRING.len; i++)
-		  log_printf_stub (filename,line,function,level,
-						   " %02x",
-						   value->data.OCTET_STRING.buf[i]);
-	 }
-}
-
-static void tree_show_ipaddress (const char *filename,int line,const char *function,
-								 int level,const snmp_value_t *value)
-{
-   log_printf_stub (filename,line,function,level,
-					"IpAddress %u.%u.%u.%u",
-					NIPQUAD (value->data.IpAddress));
-}
-
-static void tree_show_null (const char *filename,int line,const char *function,
-							int level,const snmp_value_t *value)
-{
-   log_puts_stub (filename,line,function,level,"No Such Name");
-}
-
-static void tree_show_value (const char *filename,int line,const char *function,
-							 int level,const snmp_value_t *value)
-{
-   static const struct
-	 {
-		uint8_t type;
-		void (*show) (const char *,int,const char *,int,const snmp_value_t *);
-	 } list[] =
-	 {
-		{ BER_INTEGER, tree_show_integer },
-		{ BER_Counter32, tree_show_counter32 },
-		{ BER_Gauge32, tree_show_gauge32 },
-		{ BER_TimeTicks, tree_show_timeticks },
-		{ BER_Counter64, tree_show_counter64 },
-		{ BER_OID, tree_show_oid },
-		{ BER_OCTET_STRING, tree_show_octet_string },
-		{ BER_IpAddress, tree_show_ipaddress },
-		{ BER_NULL, tree_show_null }
-	 };
-   size_t i;
-
-   for (i = 0; i < ARRAYSIZE (list); i++)
-	 if (value->type == list[i].type)
-	   {
-		  list[i].show (filename,line,function,level,value);
-		  return;
-	   }
-
-   log_puts_stub (filename,line,function,level,"(unknown)");
-}
-
 static void tree_show (const char *filename,int line,const char *function,
-					   int level,const struct odb *odb,char *prev,uint32_t depth)
+					   int level,const struct tree *odb,char *prev,uint32_t depth)
 {
    if (odb != NULL && odb->child != NULL)
 	 {
@@ -689,7 +551,7 @@ static void tree_show (const char *filename,int line,const char *function,
 		if (odb->child->child == NULL)
 		  {
 			 log_puts_stub (filename,line,function,level," :: ");
-			 tree_show_value (filename,line,function,level,&odb->child->data.value);
+			 value_show_stub (filename,line,function,level,&odb->child->data.value);
 		  }
 
 		log_putc_stub (filename,line,function,level,'\n');
@@ -709,17 +571,17 @@ int odb_show_stub (const char *filename,int line,const char *function,
 {
    abz_clear_error ();
 
-   if (odb != NULL)
+   if (odb != NULL && odb->root != NULL)
 	 {
 		char *prev;
 
-		if ((prev = mem_alloc (tree_get_depth (odb,1))) == NULL)
+		if ((prev = mem_alloc (tree_get_depth (odb->root,1))) == NULL)
 		  {
 			 out_of_memory ();
 			 return (-1);
 		  }
 
-		tree_show (filename,line,function,level,odb,prev,0);
+		tree_show (filename,line,function,level,odb->root,prev,0);
 
 		mem_free (prev);
 	 }
@@ -729,3 +591,4 @@ int odb_show_stub (const char *filename,int line,const char *function,
 
 #endif	/* #ifdef DEBUG */
 
+#endif	/* #ifndef ODB_ARRAY */
@@ -0,0 +1,151 @@
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <abz/error.h>
+#include <debug/memory.h>
+
+#include "ratelimit.h"
+
+/* tokens are kept in millionths, so that they can be added every microsecond */
+#define TOKEN 1000000ULL
+
+struct ratelimit_bucket
+{
+   uint32_t address;
+   int used;
+   uint64_t tokens;
+   uint64_t stamp;					/* when we last heard from the client (in microseconds)	*/
+};
+
+static uint32_t ratelimit_hash (uint32_t address)
+{
+   return ((address * 0x9e3779b1U) >> 7);
+}
+
+static uint64_t ratelimit_now (void)
+{
+   struct timespec ts;
+
+   clock_gettime (CLOCK_MONOTONIC,&ts);
+
+   return ((uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+int ratelimit_create (struct ratelimit *ratelimit,uint32_t rate,uint32_t burst)
+{
+   size_t n = RATELIMIT_CLIENTS / RATELIMIT_WAYS;
+
+   abz_clear_error ();
+
+   memset (ratelimit,0L,sizeof (struct ratelimit));
+
+   if (!rate)
+	 return (0);
+
+   if ((ratelimit->bucket = mem_alloc (n * RATELIMIT_WAYS * sizeof (struct ratelimit_bucket))) == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		return (-1);
+	 }
+
+   memset (ratelimit->bucket,0L,n * RATELIMIT_WAYS * sizeof (struct ratelimit_bucket));
+
+   ratelimit->mask = n - 1;
+   ratelimit->rate = rate;
+   ratelimit->burst = (burst ? burst : rate) * TOKEN;
+
+   return (0);
+}
+
+void ratelimit_destroy (struct ratelimit *ratelimit)
+{
+   if (ratelimit->bucket != NULL)
+	 mem_free (ratelimit->bucket);
+
+   ratelimit->bucket = NULL;
+}
+
+int ratelimit_check (struct ratelimit *ratelimit,uint32_t address)
+{
+   struct ratelimit_bucket *set,*bucket = NULL;
+   uint64_t now,elapsed;
+   uint32_t i;
+
+   if (ratelimit->bucket == NULL)
+	 return (0);
+
+   now = ratelimit_now ();
+   set = ratelimit->bucket + (ratelimit_hash (address) & ratelimit->mask) * RATELIMIT_WAYS;
+
+   for (i = 0; i < RATELIMIT_WAYS; i++)
+	 if (set[i].used && set[i].address == address)
+	   {
+		  bucket = set + i;
+		  break;
+	   }
+
+   if (bucket != NULL)
+	 {
+		elapsed = now - bucket->stamp;
+
+		/* don't let the multiplication overflow */
+		if (elapsed >= (ratelimit->burst - bucket->tokens) / ratelimit->rate)
+		  bucket->tokens = ratelimit->burst;
+		else
+		  bucket->tokens += elapsed * ratelimit->rate;
+	 }
+   else
+	 {
+		for (bucket = set, i = 1; i < RATELIMIT_WAYS && bucket->used; i++)
+		  if (!set[i].used || set[i].stamp < bucket->stamp)
+			bucket = set + i;
+
+		bucket->address = address;
+		bucket->used = 1;
+		bucket->tokens = ratelimit->burst;
+	 }
+
+   bucket->stamp = now;
+
+   if (bucket->tokens < TOKEN)
+	 {
+		__atomic_store_n (&ratelimit->dropped,ratelimit->dropped + 1,__ATOMIC_RELAXED);
+		return (-1);
+	 }
+
+   bucket->tokens -= TOKEN;
+
+   return (0);
+}
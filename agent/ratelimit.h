@@ -0,0 +1,79 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* number of clients each listener keeps track of */
+#define RATELIMIT_CLIENTS 1024
+
+/* clients hash to a set of this many buckets */
+#define RATELIMIT_WAYS 4
+
+struct ratelimit_bucket;
+
+/*
+ * Token buckets of the clients which sent requests recently. Each
+ * client may send burst requests in a row and rate requests per
+ * second after that. When there is no room for a new client, it
+ * takes the bucket of the client in the same set which we heard from
+ * least recently. Every listener has its own buckets, so no locking
+ * is needed.
+ */
+struct ratelimit
+{
+   struct ratelimit_bucket *bucket;
+   uint32_t mask;				/* number of sets - 1	*/
+   uint64_t rate;
+   uint64_t burst;
+   uint64_t dropped;
+};
+
+/*
+ * Initialize the token buckets. If rate is zero, all requests are
+ * allowed. Returns 0 if successful, -1 if some error occurred. Call
+ * abz_get_error() to retrieve the error message.
+ */
+extern int ratelimit_create (struct ratelimit *ratelimit,uint32_t rate,uint32_t burst);
+
+/*
+ * Free all memory allocated for the token buckets.
+ */
+extern void ratelimit_destroy (struct ratelimit *ratelimit);
+
+/*
+ * Take a token from the bucket of the client with the specified
+ * address (in network byte order). Returns 0 if the request is
+ * allowed, -1 if it should be dropped.
+ */
+extern int ratelimit_check (struct ratelimit *ratelimit,uint32_t address);
+
+#endif	/* #ifndef RATELIMIT_H */
@@ -0,0 +1,205 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <abz/error.h>
+#include <debug/memory.h>
+
+#include "replies.h"
+#include "fnv.h"
+
+struct replies_entry
+{
+   struct reply reply;
+   uint32_t hash;
+   uint64_t generation;
+   uint8_t *buf;						/* key followed by the variable bindings	*/
+   size_t keylen;
+   int used;
+   struct replies_entry *chain;		/* next entry in the same bucket			*/
+   struct replies_entry *prev;
+   struct replies_entry *next;
+};
+
+static void replies_unlink (struct replies *replies,struct replies_entry *entry)
+{
+   if (entry->prev != NULL)
+	 entry->prev->next = entry->next;
+   else
+	 replies->head = entry->next;
+
+   if (entry->next != NULL)
+	 entry->next->prev = entry->prev;
+   else
+	 replies->tail = entry->prev;
+}
+
+static void replies_touch (struct replies *replies,struct replies_entry *entry)
+{
+   if (replies->head != entry)
+	 {
+		replies_unlink (replies,entry);
+
+		entry->prev = NULL;
+		entry->next = replies->head;
+		replies->head->prev = entry;
+		replies->head = entry;
+	 }
+}
+
+int replies_create (struct replies *replies,size_t n,size_t size)
+{
+   size_t i;
+
+   abz_clear_error ();
+
+   memset (replies,0L,sizeof (struct replies));
+
+   if (!n)
+	 return (0);
+
+   for (replies->mask = 1; replies->mask < n; replies->mask <<= 1) ;
+
+   if ((replies->entry = mem_alloc (n * sizeof (struct replies_entry))) == NULL ||
+	   (replies->bucket = mem_alloc (replies->mask * sizeof (struct replies_entry *))) == NULL ||
+	   (replies->buf = mem_alloc (n * size)) == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		replies_destroy (replies);
+		return (-1);
+	 }
+
+   memset (replies->entry,0L,n * sizeof (struct replies_entry));
+   memset (replies->bucket,0L,replies->mask * sizeof (struct replies_entry *));
+
+   for (i = 0; i < n; i++)
+	 {
+		replies->entry[i].buf = replies->buf + i * size;
+		replies->entry[i].prev = i ? replies->entry + i - 1 : NULL;
+		replies->entry[i].next = i < n - 1 ? replies->entry + i + 1 : NULL;
+	 }
+
+   replies->n = n;
+   replies->size = size;
+   replies->mask--;
+   replies->head = replies->entry;
+   replies->tail = replies->entry + n - 1;
+
+   return (0);
+}
+
+void replies_destroy (struct replies *replies)
+{
+   if (replies->entry != NULL)
+	 mem_free (replies->entry);
+
+   if (replies->bucket != NULL)
+	 mem_free (replies->bucket);
+
+   if (replies->buf != NULL)
+	 mem_free (replies->buf);
+
+   memset (replies,0L,sizeof (struct replies));
+}
+
+static struct replies_entry *replies_lookup (struct replies *replies,const void *key,size_t keylen,uint32_t hash)
+{
+   struct replies_entry *entry;
+
+   for (entry = replies->bucket[hash & replies->mask]; entry != NULL; entry = entry->chain)
+	 if (entry->hash == hash && entry->keylen == keylen && !memcmp (entry->buf,key,keylen))
+	   break;
+
+   return (entry);
+}
+
+const struct reply *replies_find (struct replies *replies,const void *key,size_t keylen,uint64_t generation)
+{
+   struct replies_entry *entry;
+
+   if (!replies->n)
+	 return (NULL);
+
+   /* the counters are read by the main thread */
+   if ((entry = replies_lookup (replies,key,keylen,fnv_hash (key,keylen))) == NULL ||
+	   entry->generation != generation)
+	 {
+		__atomic_store_n (&replies->misses,replies->misses + 1,__ATOMIC_RELAXED);
+		return (NULL);
+	 }
+
+   __atomic_store_n (&replies->hits,replies->hits + 1,__ATOMIC_RELAXED);
+   replies_touch (replies,entry);
+
+   return (&entry->reply);
+}
+
+void replies_store (struct replies *replies,const void *key,size_t keylen,uint64_t generation,
+				   const struct reply *reply)
+{
+   uint32_t hash = fnv_hash (key,keylen);
+   struct replies_entry *entry,**tmp;
+
+   if (!replies->n || keylen + reply->length > replies->size)
+	 return;
+
+   /* replace an outdated response to the same request, or the least recently used one */
+   if ((entry = replies_lookup (replies,key,keylen,hash)) == NULL)
+	 {
+		entry = replies->tail;
+
+		if (entry->used)
+		  {
+			 for (tmp = replies->bucket + (entry->hash & replies->mask); *tmp != entry; tmp = &(*tmp)->chain) ;
+			 *tmp = entry->chain;
+			 entry->used = 0;
+		  }
+	 }
+
+   memcpy (entry->buf,key,keylen);
+   memcpy (entry->buf + keylen,reply->data,reply->length);
+
+   entry->reply = *reply;
+   entry->reply.data = entry->buf + keylen;
+   entry->hash = hash;
+   entry->generation = generation;
+   entry->keylen = keylen;
+
+   if (!entry->used)
+	 {
+		entry->chain = replies->bucket[hash & replies->mask];
+		replies->bucket[hash & replies->mask] = entry;
+		entry->used = 1;
+	 }
+
+   replies_touch (replies,entry);
+}
@@ -0,0 +1,101 @@
+#ifndef REPLIES_H
+#define REPLIES_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A cached response. Only the parts that don't depend on the request
+ * ID are kept, i.e. the error fields and the encoded variable binding
+ * list, as well as the counters that answering the request bumped.
+ */
+struct reply
+{
+   uint8_t status;
+   uint32_t index;
+   const uint8_t *data;
+   size_t length;
+   uint32_t reqvars;				/* snmpInTotalReqVars	*/
+   uint32_t nosuchnames;			/* snmpOutNoSuchNames	*/
+};
+
+struct replies_entry;
+
+/*
+ * A small least recently used cache of responses. Every listener has
+ * its own, so no locking is needed.
+ */
+struct replies
+{
+   struct replies_entry *entry;
+   struct replies_entry **bucket;
+   uint8_t *buf;					/* n entries of size bytes each	*/
+   size_t n;
+   size_t size;
+   uint32_t mask;					/* number of buckets - 1	*/
+   struct replies_entry *head;		/* most recently used	*/
+   struct replies_entry *tail;		/* least recently used	*/
+   uint64_t hits;
+   uint64_t misses;
+};
+
+/*
+ * Initialize a cache for n responses. The memory for the responses
+ * is allocated up front, size bytes for each (the key included), so
+ * that storing a response never allocates any memory. If n is zero,
+ * nothing is ever cached. Returns 0 if successful, -1 if some error
+ * occurred. Call abz_get_error() to retrieve the error message.
+ */
+extern int replies_create (struct replies *replies,size_t n,size_t size);
+
+/*
+ * Free all memory allocated by the cache.
+ */
+extern void replies_destroy (struct replies *replies);
+
+/*
+ * Find the response to a request. The key should identify everything
+ * in the request except the request ID, and generation should change
+ * whenever the data the response is made of might have changed.
+ * Returns the response or NULL if it isn't cached. The response is
+ * valid until the next call to replies_store().
+ */
+extern const struct reply *replies_find (struct replies *replies,const void *key,size_t keylen,uint64_t generation);
+
+/*
+ * Add a response to the cache, replacing the least recently used one.
+ * The data the response points to is copied. Responses which don't
+ * fit in an entry (together with the key) are not cached.
+ */
+extern void replies_store (struct replies *replies,const void *key,size_t keylen,uint64_t generation,
+						  const struct reply *reply);
+
+#endif	/* #ifndef REPLIES_H */
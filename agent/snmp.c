@@ -31,8 +31,8 @@
 #include <stdint.h>
 #include <string.h>
 
-#include <debug/memory.h>
 #include <tinysnmp/tinysnmp.h>
+#include <tinysnmp/agent/odb.h>
 #include <ber/ber.h>
 
 #include <abz/typedefs.h>
@@ -40,23 +40,44 @@
 
 #include "snmp.h"
 #include "module.h"
+#include "arena.h"
+#include "replies.h"
+#include "decode.h"
+#include "oidcmp.h"
 
-enum
+/*
+ * A variable binding in a response. The value is borrowed from a
+ * module cache. If it is NULL, the type is either BER_NULL (SNMPv1
+ * errors) or one of the SNMPv2 exceptions.
+ */
+struct varbind
 {
-   noError		= 0,
-   tooBig		= 1,
-   noSuchName	= 2,
-   badValue		= 3,
-   readOnly		= 4,
-   genErr		= 5
+   const uint32_t *oid;
+   const snmp_value_t *value;
+   uint8_t type;
+   uint32_t oidlen;		/* encoded size of the ObjectID	*/
+   uint32_t length;		/* encoded size of the value	*/
 };
 
+/*
+ * Variable bindings are looked up first, so that all the lengths
+ * are known before we start encoding the response.
+ */
 struct encode
 {
-   ber_t *ber;
+   const snmp_pdu_t *pdu;
+   int32_t version;
    uint8_t status;
    uint32_t index;
    time_t timeout;
+   const uint32_t *view;	/* NULL if the community may see everything	*/
+   struct arena *scratch;
+   struct varbind *varbind;
+   uint32_t n;
+   uint32_t size;
+   size_t length;		/* encoded size of the variable bindings	*/
+   size_t limit;		/* maximum size of the response				*/
+   size_t room;			/* maximum size of the variable bindings	*/
 };
 
 static const char *pdu_type_str (uint8_t type)
@@ -89,53 +110,169 @@ static const char *pdu_type_str (uint8_t type)
    return (buf);
 }
 
-void snmp_free (snmp_pdu_t *pdu)
+/*
+ * libber allocates memory for every ObjectID and octet string it
+ * decodes, so we decode requests ourselves. Everything that has to
+ * stay around until the response is encoded goes into the scratch
+ * arena.
+ */
+
+static int decode_sequence (ber_t *ber)
 {
-   if (pdu->community.len)
-	 mem_free (pdu->community.buf);
+   uint32_t len;
 
-   if (pdu->oid != NULL)
+   return (snmp_ber_decode_header (ber,BER_SEQUENCE,&len));
+}
+
+static int decode_null (ber_t *ber)
+{
+   uint32_t len;
+
+   if (snmp_ber_decode_header (ber,BER_NULL,&len))
+	 return (-1);
+
+   if (len)
 	 {
-		uint32_t i;
+		abz_set_error ("invalid NULL length (%u)",len);
+		return (-1);
+	 }
+
+   return (0);
+}
 
-		for (i = 0; i < pdu->n; i++)
-		  mem_free (pdu->oid[i]);
+static int decode_integer (int32_t *value,ber_t *ber)
+{
+   uint32_t len,tmp;
+
+   if (snmp_ber_decode_header (ber,BER_INTEGER,&len))
+	 return (-1);
 
-		mem_free (pdu->oid);
+   if (!len || len > sizeof (int32_t))
+	 {
+		abz_set_error ("invalid INTEGER length (%u)",len);
+		return (-1);
 	 }
+
+   /* sign extend the first byte */
+   for (tmp = (int8_t) ber->buf[ber->offset++]; --len; )
+	 tmp = (tmp << 8) | ber->buf[ber->offset++];
+
+   *value = tmp;
+
+   return (0);
 }
 
-static int decode_varbind_list (snmp_pdu_t *pdu,ber_t *ber)
+static int decode_unsigned (uint64_t *value,ber_t *ber,uint8_t type,uint32_t size)
 {
-   uint32_t i;
+   uint32_t len;
+
+   if (snmp_ber_decode_header (ber,type,&len))
+	 return (-1);
 
-   if (ber_decode_sequence (ber))
+   /* there may be a leading zero byte to keep the value positive */
+   if (!len || len > size + 1 || (len == size + 1 && ber->buf[ber->offset]))
 	 {
-		snmp_stats.snmpInASNParseErrs++;
+		abz_set_error ("invalid length (%u) of type 0x%02x",len,type);
 		return (-1);
 	 }
 
-   for (i = 0; ber->offset < ber->size; i++)
+   for (*value = 0; len; len--)
+	 *value = (*value << 8) | ber->buf[ber->offset++];
+
+   return (0);
+}
+
+static void *decode_alloc (void *scratch,size_t size)
+{
+   return (arena_alloc (scratch,size));
+}
+
+static int decode_value (snmp_value_t *value,ber_t *ber,struct arena *scratch)
+{
+   uint64_t tmp;
+   uint32_t len;
+
+   if (ber->offset < ber->size)
+	 switch (value->type = ber->buf[ber->offset])
+	   {
+		case BER_NULL:
+		  return (decode_null (ber));
+		case BER_INTEGER:
+		  return (decode_integer (&value->data.INTEGER,ber));
+		case BER_OCTET_STRING:
+		  return (snmp_ber_decode_octet_string (&value->data.OCTET_STRING,ber,decode_alloc,scratch));
+		case BER_OID:
+		  return (snmp_ber_decode_oid (&value->data.OID,ber,decode_alloc,scratch));
+		case BER_IpAddress:
+		  if (snmp_ber_decode_header (ber,BER_IpAddress,&len))
+			return (-1);
+
+		  if (len != sizeof (uint32_t))
+			{
+			   abz_set_error ("invalid IpAddress length (%u)",len);
+			   return (-1);
+			}
+
+		  memcpy (&value->data.IpAddress,ber->buf + ber->offset,len);
+		  ber->offset += len;
+
+		  return (0);
+		case BER_Counter32:
+		case BER_Gauge32:
+		case BER_TimeTicks:
+		  if (decode_unsigned (&tmp,ber,value->type,sizeof (uint32_t)))
+			return (-1);
+
+		  /* these all share the same representation */
+		  value->data.Counter32 = tmp;
+
+		  return (0);
+		case BER_Counter64:
+		  return (decode_unsigned (&value->data.Counter64,ber,BER_Counter64,sizeof (uint64_t)));
+	   }
+
+   abz_set_error ("unsupported value type at offset %u",ber->offset);
+   return (-1);
+}
+
+static int decode_varbind_list (snmp_pdu_t *pdu,ber_t *ber,struct arena *scratch)
+{
+   uint32_t size;
+   int result;
+
+   if (decode_sequence (ber))
 	 {
-		uint32_t *oid;
-		void *ptr;
+		snmp_stats.snmpInASNParseErrs++;
+		return (-1);
+	 }
+
+   /* a variable binding takes up at least 6 bytes */
+   if ((size = (ber->size - ber->offset) / 6) &&
+	   (pdu->oid = arena_alloc (scratch,size * sizeof (uint32_t *))) == NULL)
+	 return (-1);
+
+   if (size && (pdu->type == BER_SetRequest || pdu->type == BER_GetResponse) &&
+	   (pdu->value = arena_alloc (scratch,size * sizeof (snmp_value_t))) == NULL)
+	 return (-1);
 
-		if (ber_decode_sequence (ber) || ber_decode_oid (&oid,ber) || ber_decode_null (ber))
+   while (ber->offset < ber->size)
+	 {
+		if (decode_sequence (ber) || snmp_ber_decode_oid (pdu->oid + pdu->n,ber,decode_alloc,scratch))
 		  {
 			 snmp_stats.snmpInASNParseErrs++;
-			 if (oid != NULL) mem_free (oid);
 			 return (-1);
 		  }
 
-		if ((ptr = mem_realloc (pdu->oid,(pdu->n + 1) * sizeof (uint32_t *))) == NULL)
+		result = pdu->type == BER_SetRequest || pdu->type == BER_GetResponse ?
+		  decode_value (pdu->value + pdu->n,ber,scratch) :
+		  decode_null (ber);
+
+		if (result)
 		  {
-			 abz_set_error ("failed to allocate memory: %m");
-			 if (oid != NULL) mem_free (oid);
+			 snmp_stats.snmpInASNParseErrs++;
 			 return (-1);
 		  }
 
-		pdu->oid = ptr;
-		pdu->oid[i] = oid;
 		pdu->n++;
 	 }
 
@@ -144,90 +281,133 @@ static int decode_varbind_list (snmp_pdu_t *pdu,ber_t *ber)
 
 static int decode_pdu_type (snmp_pdu_t *pdu,ber_t *ber)
 {
-   uint32_t offset = ber->offset;
-
-   if (!ber_decode_get_request (ber))
-	 {
-		snmp_stats.snmpInGetRequests++;
-		pdu->type = BER_GetRequest;
-		return (0);
-	 }
+   uint32_t len;
+
+   if (ber->offset < ber->size)
+	 switch (ber->buf[ber->offset])
+	   {
+		case BER_GetRequest:
+		case BER_GetNextRequest:
+		case BER_GetBulkRequest:
+		case BER_SetRequest:
+		case BER_GetResponse:
+		  pdu->type = ber->buf[ber->offset];
+
+		  if (snmp_ber_decode_header (ber,pdu->type,&len))
+			return (-1);
 
-   abz_clear_error ();
-   ber->offset = offset;
+		  if (pdu->type == BER_GetRequest)
+			snmp_stats.snmpInGetRequests++;
+		  else if (pdu->type == BER_GetNextRequest)
+			snmp_stats.snmpInGetNexts++;
+		  else if (pdu->type == BER_SetRequest)
+			snmp_stats.snmpInSetRequests++;
+		  else if (pdu->type == BER_GetResponse)
+			snmp_stats.snmpInGetResponses++;
 
-   if (!ber_decode_get_next_request (ber))
-	 {
-		snmp_stats.snmpInGetNexts++;
-		pdu->type = BER_GetNextRequest;
-		return (0);
-	 }
+		  return (0);
+	   }
 
    /* ...more types to follow */
 
-   abz_clear_error ();
    abz_set_error ("failed to decode pdu type");
    return (-1);
 }
 
-static int decode_message (snmp_pdu_t *pdu,ber_t *ber)
+/*
+ * Count a non-zero ErrorStatus in a received pdu.
+ */
+static void decode_count_error (int32_t status)
+{
+   switch (status)
+	 {
+	  case tooBig:
+		snmp_stats.snmpInTooBigs++;
+		break;
+	  case noSuchName:
+		snmp_stats.snmpInNoSuchNames++;
+		break;
+	  case badValue:
+		snmp_stats.snmpInBadValues++;
+		break;
+	  case readOnly:
+		snmp_stats.snmpInReadOnlys++;
+		break;
+	  case genErr:
+		snmp_stats.snmpInGenErrs++;
+	 }
+}
+
+int snmp_decode_header (snmp_pdu_t *pdu,ber_t *ber,struct arena *scratch)
 {
-   int32_t status,index;
+   abz_clear_error ();
 
-   if (ber_decode_sequence (ber) || ber_decode_integer (&pdu->version,ber))
+   memset (pdu,0L,sizeof (snmp_pdu_t));
+
+   if (decode_sequence (ber) || decode_integer (&pdu->version,ber))
 	 {
 		snmp_stats.snmpInASNParseErrs++;
 		return (-1);
 	 }
 
-   if (pdu->version != SNMP_VERSION_1)
+   if (pdu->version != SNMP_VERSION_1 && pdu->version != SNMP_VERSION_2C)
 	 {
 		snmp_stats.snmpInBadVersions++;
-		abz_set_error ("unsupported snmp version (%u) in %s pdu",
-					   pdu->version,pdu_type_str (pdu->type));
+		abz_set_error ("unsupported snmp version (%u)",pdu->version);
+		return (-1);
+	 }
+
+   if (snmp_ber_decode_octet_string (&pdu->community,ber,decode_alloc,scratch))
+	 {
+		snmp_stats.snmpInASNParseErrs++;
 		return (-1);
 	 }
 
-   if (ber_decode_octet_string (&pdu->community,ber) ||
-	   decode_pdu_type (pdu,ber) ||
-	   ber_decode_integer (&pdu->RequestID,ber) ||
-	   ber_decode_integer (&status,ber) ||
-	   ber_decode_integer (&index,ber))
+   return (0);
+}
+
+int snmp_decode_pdu (snmp_pdu_t *pdu,ber_t *ber,struct arena *scratch)
+{
+   int32_t status,index;
+
+   abz_clear_error ();
+
+   if (decode_pdu_type (pdu,ber) ||
+	   decode_integer (&pdu->RequestID,ber) ||
+	   decode_integer (&status,ber) ||
+	   decode_integer (&index,ber))
 	 {
 		snmp_stats.snmpInASNParseErrs++;
 		return (-1);
 	 }
 
-   if (status || index)
+   if (pdu->type == BER_GetBulkRequest)
 	 {
-		switch (status)
+		if (pdu->version == SNMP_VERSION_1)
 		  {
-		   case tooBig:
-			 snmp_stats.snmpInTooBigs++;
-			 break;
-		   case noSuchName:
-			 snmp_stats.snmpInNoSuchNames++;
-			 break;
-		   case badValue:
-			 snmp_stats.snmpInBadValues++;
-			 break;
-		   case readOnly:
-			 snmp_stats.snmpInReadOnlys++;
-			 break;
-		   case genErr:
-			 snmp_stats.snmpInGenErrs++;
+			 snmp_stats.snmpInBadVersions++;
+			 abz_set_error ("%s pdu in snmp version 1 message",pdu_type_str (pdu->type));
+			 return (-1);
 		  }
 
+		/* negative values are treated as zero (RFC 3416) */
+		pdu->NonRepeaters = status > 0 ? status : 0;
+		pdu->MaxRepetitions = index > 0 ? index : 0;
+	 }
+   else if (status || index)
+	 {
+		decode_count_error (status);
+
 		abz_set_error ("non-zero %s field in %s pdu",
 					   status ? "ErrorStatus" : "ErrorIndex",
 					   pdu_type_str (pdu->type));
 		return (-1);
 	 }
 
-   if (decode_varbind_list (pdu,ber))
+   if (decode_varbind_list (pdu,ber,scratch))
 	 return (-1);
 
-   if (pdu->type == BER_GetRequest && !pdu->n)
+   if ((pdu->type == BER_GetRequest || pdu->type == BER_SetRequest) && !pdu->n)
 	 {
 		abz_set_error ("empty %s pdu",pdu_type_str (pdu->type));
 		return (-1);
@@ -242,169 +422,1032 @@ static int decode_message (snmp_pdu_t *pdu,ber_t *ber)
    return (0);
 }
 
-int snmp_decode (snmp_pdu_t *pdu,ber_t *ber)
+int snmp_decode (snmp_pdu_t *pdu,ber_t *ber,struct arena *scratch)
 {
-   abz_clear_error ();
+   return (snmp_decode_header (pdu,ber,scratch) || snmp_decode_pdu (pdu,ber,scratch) ? -1 : 0);
+}
 
-   memset (pdu,0L,sizeof (snmp_pdu_t));
+int snmp_decode_response (snmp_pdu_t *pdu,ber_t *ber,struct arena *scratch)
+{
+   int32_t status,index;
+
+   if (snmp_decode_header (pdu,ber,scratch))
+	 return (-1);
 
-   if (decode_message (pdu,ber))
+   if (decode_pdu_type (pdu,ber) ||
+	   decode_integer (&pdu->RequestID,ber) ||
+	   decode_integer (&status,ber) ||
+	   decode_integer (&index,ber))
 	 {
-		snmp_free (pdu);
+		snmp_stats.snmpInASNParseErrs++;
 		return (-1);
 	 }
 
+   if (pdu->type != BER_GetResponse)
+	 {
+		abz_set_error ("unexpected %s pdu",pdu_type_str (pdu->type));
+		return (-1);
+	 }
+
+   decode_count_error (status);
+
    return (0);
 }
 
-static int encode_type (ber_t *ber,const snmp_value_t *value,uint32_t n)
+/*
+ * Responses are encoded front to back, so we have to know how much
+ * room everything takes up before we start writing. The functions
+ * below calculate the size of the BER encoding of the contents of
+ * the different types.
+ */
+
+static size_t length_size (size_t len)
+{
+   size_t n = 1;
+
+   if (len & ~0x7f)
+	 for ( ; len; len >>= 8)
+	   n++;
+
+   return (n);
+}
+
+static __inline__ size_t tlv_size (size_t len)
+{
+   return (1 + length_size (len) + len);
+}
+
+static __inline__ size_t unsigned_size (uint64_t value)
+{
+   size_t n = 1;
+
+   for ( ; value > 0x7f; value >>= 8)
+	 n++;
+
+   return (n);
+}
+
+static __inline__ size_t integer_size (int32_t value)
 {
+   return (unsigned_size (value < 0 ? ~value : value));
+}
+
+static __inline__ size_t arc_size (uint32_t arc)
+{
+   size_t n = 1;
+
+   for ( ; arc > 0x7f; arc >>= 7)
+	 n++;
+
+   return (n);
+}
+
+static size_t oid_size (const uint32_t *oid)
+{
+   size_t i,n = 0;
+
+   for (i = 1; i <= oid[0]; i++)
+	 n += arc_size (oid[i]);
+
+   return (n);
+}
+
+static size_t value_size (const snmp_value_t *value)
+{
+   if (value == NULL)
+	 return (0);
+
    switch (value->type)
 	 {
 	  case BER_INTEGER:
-		return (ber_encode_integer (ber,value->data.INTEGER));
+		return (integer_size (value->data.INTEGER));
 	  case BER_Counter32:
-		return (ber_encode_counter32 (ber,value->data.Counter32));
+		return (unsigned_size (value->data.Counter32));
 	  case BER_Gauge32:
-		return (ber_encode_gauge32 (ber,value->data.Gauge32));
+		return (unsigned_size (value->data.Gauge32));
 	  case BER_TimeTicks:
-		return (ber_encode_timeticks (ber,value->data.TimeTicks));
+		return (unsigned_size (value->data.TimeTicks));
 	  case BER_Counter64:
-		return (ber_encode_counter64 (ber,value->data.Counter64));
+		return (unsigned_size (value->data.Counter64));
 	  case BER_OID:
-		return (ber_encode_oid (ber,value->data.OID));
+		return (oid_size (value->data.OID));
 	  case BER_OCTET_STRING:
-		return (ber_encode_octet_string (ber,&value->data.OCTET_STRING));
+		return (value->data.OCTET_STRING.len);
 	  case BER_IpAddress:
-		return (ber_encode_ipaddress (ber,value->data.IpAddress));
+		return (4);
 	 }
 
-   return (-1);
+   return (0);
 }
 
-static int encode_value (struct encode *encode,const uint32_t *oid,uint32_t n)
+/*
+ * Size of the response if the variable bindings take up length
+ * bytes. The error fields may still change while we're looking up
+ * variables, so we assume the worst.
+ */
+static size_t response_size (const struct encode *encode,size_t length)
 {
-   const snmp_value_t *value;
-   uint32_t offset = encode->ber->offset;
+   size_t pdu = tlv_size (integer_size (encode->pdu->RequestID)) +
+	 tlv_size (integer_size (genErr)) +
+	 tlv_size (integer_size (encode->pdu->n)) +
+	 tlv_size (length);
+
+   return (tlv_size (tlv_size (integer_size (encode->version)) +
+					 tlv_size (encode->pdu->community.len) +
+					 tlv_size (pdu)));
+}
+
+/*
+ * Make room for at least n variable bindings. Returns 0 if
+ * successful, -1 if some error occurred.
+ */
+static int encode_reserve (struct encode *encode,uint32_t n)
+{
+   struct varbind *varbind;
+
+   if (n <= encode->size)
+	 return (0);
+
+   if ((varbind = arena_alloc (encode->scratch,n * sizeof (struct varbind))) == NULL)
+	 return (-1);
+
+   if (encode->n)
+	 memcpy (varbind,encode->varbind,encode->n * sizeof (struct varbind));
+
+   encode->varbind = varbind;
+   encode->size = n;
+
+   return (0);
+}
+
+/*
+ * Add a variable binding to the response. If copy is non-zero, the
+ * ObjectID is copied to the scratch arena, otherwise it should stay
+ * around until the response is encoded. Values are never copied.
+ * Returns 0 if successful, 1 if the variable binding doesn't fit in
+ * the response, or -1 if some error occurred.
+ */
+static int encode_add (struct encode *encode,const uint32_t *oid,int copy,const snmp_value_t *value,uint8_t type)
+{
+   struct varbind *varbind;
+   uint32_t oidlen = oid_size (oid),length = value_size (value);
+   size_t size = tlv_size (tlv_size (oidlen) + tlv_size (length));
 
-   if ((value = module_find (oid,encode->timeout)) == NULL)
+   if (encode->length + size > encode->room)
+	 return (1);
+
+   if (encode->n == encode->size && encode_reserve (encode,encode->size ? encode->size * 2 : 64))
+	 return (-1);
+
+   varbind = encode->varbind + encode->n;
+
+   if (copy)
 	 {
-		snmp_stats.snmpOutNoSuchNames++;
-		encode->status = noSuchName;
-		encode->index = n;
-		if (ber_encode_null (encode->ber))
+		uint32_t *tmp;
+
+		if ((tmp = arena_alloc (encode->scratch,(oid[0] + 1) * sizeof (uint32_t))) == NULL)
 		  return (-1);
+
+		memcpy (tmp,oid,(oid[0] + 1) * sizeof (uint32_t));
+		oid = tmp;
 	 }
-   else
+
+   varbind->oid = oid;
+   varbind->value = value;
+   varbind->type = value != NULL ? value->type : type;
+   varbind->oidlen = oidlen;
+   varbind->length = length;
+
+   encode->n++;
+   encode->length += size;
+
+   return (0);
+}
+
+/*
+ * Returns 1 if the ObjectID is in the view of the community, 0
+ * otherwise.
+ */
+static int lookup_visible (const struct encode *encode,const uint32_t *oid)
+{
+   const uint32_t *view = encode->view;
+   uint32_t i;
+
+   if (view == NULL)
+	 return (1);
+
+   if (view[0] > oid[0])
+	 return (0);
+
+   for (i = 1; i <= view[0]; i++)
+	 if (view[i] != oid[i])
+	   return (0);
+
+   return (1);
+}
+
+/*
+ * Fail the request with a genErr at variable binding n (RFC 3416,
+ * 4.2.1). The variable bindings are replaced with those of the
+ * request once all of them have been looked up.
+ */
+static void lookup_error (struct encode *encode,uint32_t n)
+{
+   if (encode->status != genErr)
+	 {
+		encode->status = genErr;
+		encode->index = n;
+	 }
+}
+
+/*
+ * Find the first ObjectID after oid (or the first ObjectID if oid is
+ * NULL) in the view of the community. ObjectID's before the view
+ * skip ahead to the start of the view. If the ObjectID can't be
+ * returned, variable binding n fails with a genErr.
+ */
+static const snmp_value_t *lookup_next (struct encode *encode,const uint32_t *oid,uint32_t *next,size_t size,uint32_t n)
+{
+   const snmp_value_t *value;
+   int result;
+
+   if (encode->view != NULL && (oid == NULL || oidcmp (oid,encode->view) < 0))
+	 oid = encode->view;
+
+   if ((result = module_find_next (oid,next,size,encode->timeout,&value)) < 0)
+	 lookup_error (encode,n);
+
+   if (result || !lookup_visible (encode,next))
+	 return (NULL);
+
+   return (value);
+}
+
+/*
+ * Decide which exception to return for an ObjectID which doesn't
+ * exist. Modules don't tell us which object types they implement,
+ * so if there are any instances below the ObjectID without its last
+ * sub-identifier, we assume that the object type exists and only
+ * the instance is missing.
+ */
+static uint8_t lookup_missing (struct encode *encode,const uint32_t *oid,uint32_t n)
+{
+   uint32_t parent[ODB_OID_MAX + 1],next[ODB_OID_MAX + 1];
+   const snmp_value_t *value;
+   int result;
+
+   if (oid[0] < 2 || oid[0] > ARRAYSIZE (parent) || !lookup_visible (encode,oid))
+	 return (noSuchObject);
+
+   memcpy (parent,oid,oid[0] * sizeof (uint32_t));
+   parent[0] = oid[0] - 1;
+
+   if ((result = module_find_next (parent,next,ARRAYSIZE (next),encode->timeout,&value)) < 0)
+	 lookup_error (encode,n);
+
+   if (!result && lookup_visible (encode,next) && next[0] > parent[0] && !memcmp (next + 1,parent + 1,parent[0] * sizeof (uint32_t)))
+	 return (noSuchInstance);
+
+   return (noSuchObject);
+}
+
+static int lookup_value (struct encode *encode,const uint32_t *oid,uint32_t n)
+{
+   const snmp_value_t *value;
+
+   if (lookup_visible (encode,oid) && (value = module_find (oid,encode->timeout)) != NULL)
 	 {
 		snmp_stats.snmpInTotalReqVars++;
+		return (encode_add (encode,oid,0,value,0));
+	 }
 
-		if (encode_type (encode->ber,value,n))
-		  return (-1);
+   /* SNMPv2 reports missing variables individually */
+   if (encode->version == SNMP_VERSION_2C)
+	 return (encode_add (encode,oid,0,NULL,lookup_missing (encode,oid,n)));
+
+   snmp_stats.snmpOutNoSuchNames++;
+
+   if (encode->status == noError)
+	 {
+		encode->status = noSuchName;
+		encode->index = n;
 	 }
 
-   return (ber_encode_oid (encode->ber,oid) ||
-		   ber_encode_sequence (encode->ber,encode->ber->offset - offset) ?
-		   -1 : 0);
+   return (encode_add (encode,oid,0,NULL,BER_NULL));
 }
 
-static int encode_next_value (struct encode *encode,const uint32_t *oid,uint32_t n)
+static int lookup_next_value (struct encode *encode,const uint32_t *oid,uint32_t n)
 {
-   snmp_next_value_t *next;
-   uint32_t offset = encode->ber->offset;
+   uint32_t next[ODB_OID_MAX + 1];
+   const snmp_value_t *value;
+
+   if ((value = lookup_next (encode,oid,next,ARRAYSIZE (next),n)) != NULL)
+	 return (encode_add (encode,next,1,value,0));
+
+   if (encode->status == genErr)
+	 return (0);
+
+   /*
+	* What am I supposed to do when there are no ObjectID's in the MIB?
+	* At the moment, the query will fail if that is the case.
+	*/
 
-   if ((next = module_find_next (oid,encode->timeout)) == NULL)
+   if (oid == NULL)
 	 {
-		/*
-		 * What am I supposed to do when there are no ObjectID's in the MIB?
-		 * At the moment, the query will fail if that is the case.
-		 */
+		abz_set_error ("no ObjectID's in the mib");
+		return (-1);
+	 }
 
-		if (oid == NULL)
-		  return (-1);
+   if (encode->version == SNMP_VERSION_2C)
+	 return (encode_add (encode,oid,0,NULL,endOfMibView));
 
-		snmp_stats.snmpOutNoSuchNames++;
+   snmp_stats.snmpOutNoSuchNames++;
+
+   if (encode->status == noError)
+	 {
 		encode->status = noSuchName;
 		encode->index = n;
+	 }
 
-		if (ber_encode_null (encode->ber) ||
-			ber_encode_oid (encode->ber,oid) ||
-			ber_encode_sequence (encode->ber,encode->ber->offset - offset))
-		  return (-1);
+   return (encode_add (encode,oid,0,NULL,BER_NULL));
+}
+
+/*
+ * Look up the variable bindings of a GetBulkRequest (RFC 3416, 4.2.3).
+ * Non-repeaters are looked up once, the remaining variables up to
+ * max-repetitions times, each time starting where the previous
+ * repetition left off. Returns 0 if successful, 1 if the response is
+ * full, or -1 if some error occurred.
+ */
+static int lookup_bulk (struct encode *encode)
+{
+   const snmp_pdu_t *pdu = encode->pdu;
+   uint32_t next[ODB_OID_MAX + 1];
+   const snmp_value_t *value;
+   uint32_t i,j,N,R;
+   int result;
+
+   N = pdu->NonRepeaters < pdu->n ? pdu->NonRepeaters : pdu->n;
+   R = pdu->n - N;
+
+   for (i = 0; i < N; i++)
+	 {
+		if ((value = lookup_next (encode,pdu->oid[i],next,ARRAYSIZE (next),i + 1)) == NULL && encode->status == genErr)
+		  return (0);
+
+		if ((result = value != NULL ?
+			 encode_add (encode,next,1,value,0) :
+			 encode_add (encode,pdu->oid[i],0,NULL,endOfMibView)))
+		  return (result);
 	 }
-   else
+
+   for (j = 0; j < pdu->MaxRepetitions && R; j++)
 	 {
-		int result = encode_type (encode->ber,&next->value,n);
+		int done = 1;
 
-		if (next->value.type == BER_OID)
-		  mem_free (next->value.data.OID);
-		else if (next->value.type == BER_OCTET_STRING && next->value.data.OCTET_STRING.len)
-		  mem_free (next->value.data.OCTET_STRING.buf);
+		for (i = 0; i < R; i++)
+		  {
+			 const uint32_t *oid = pdu->oid[N + i];
 
-		if (!result)
-		  result = ber_encode_oid (encode->ber,next->oid);
+			 /* the previous repetition of this variable */
+			 if (j)
+			   {
+				  const struct varbind *prev = encode->varbind + encode->n - R;
 
-		mem_free (next->oid);
-		mem_free (next);
+				  oid = prev->oid;
 
-		if (result)
-		  return (-1);
+				  if (prev->value == NULL)
+					{
+					   if ((result = encode_add (encode,oid,0,NULL,endOfMibView)))
+						 return (result);
+
+					   continue;
+					}
+			   }
 
-		return (ber_encode_sequence (encode->ber,encode->ber->offset - offset));
+			 if ((value = lookup_next (encode,oid,next,ARRAYSIZE (next),N + i + 1)) != NULL)
+			   done = 0;
+			 else if (encode->status == genErr)
+			   return (0);
+
+			 if ((result = value != NULL ?
+				  encode_add (encode,next,1,value,0) :
+				  encode_add (encode,oid,0,NULL,endOfMibView)))
+			   return (result);
+		  }
+
+		/* no point in going on if all the variables are past the end of the mib */
+		if (done)
+		  break;
 	 }
 
    return (0);
 }
 
-static int encode_varbind_list (struct encode *encode,const snmp_pdu_t *pdu)
+/*
+ * Map the error status of a set request to the nearest SNMPv1 error
+ * status (RFC 3584, 4.4) and count it.
+ */
+static uint8_t lookup_status (const struct encode *encode,int status)
+{
+   if (encode->version == SNMP_VERSION_1)
+	 switch (status)
+	   {
+		case noAccess:
+		case notWritable:
+		case noCreation:
+		case inconsistentName:
+		case authorizationError:
+		  status = noSuchName;
+		  break;
+		case wrongType:
+		case wrongLength:
+		case wrongEncoding:
+		case wrongValue:
+		case inconsistentValue:
+		  status = badValue;
+		  break;
+		case resourceUnavailable:
+		case commitFailed:
+		case undoFailed:
+		  status = genErr;
+	   }
+
+   switch (status)
+	 {
+	  case noSuchName:
+		snmp_stats.snmpOutNoSuchNames++;
+		break;
+	  case badValue:
+		snmp_stats.snmpOutBadValues++;
+		break;
+	  case genErr:
+		snmp_stats.snmpOutGenErrs++;
+	 }
+
+   return (status);
+}
+
+/*
+ * The response to a SetRequest is a copy of the request, so we make
+ * sure that it fits before anything is assigned (RFC 3416, 4.2.5).
+ * Returns 0 if successful, 1 if the response is too big, or -1 if
+ * some error occurred.
+ */
+static int lookup_set (struct encode *encode)
 {
-   if (pdu->type == BER_GetRequest)
+   const snmp_pdu_t *pdu = encode->pdu;
+   uint32_t i,index;
+   int result,status;
+
+   for (i = 0; i < pdu->n; i++)
+	 if ((result = encode_add (encode,pdu->oid[i],0,pdu->value + i,0)))
+	   return (result);
+
+   for (i = 0; i < pdu->n; i++)
+	 if (!lookup_visible (encode,pdu->oid[i]))
+	   {
+		  encode->status = lookup_status (encode,noAccess);
+		  encode->index = i + 1;
+		  return (0);
+	   }
+
+   if ((status = module_set (pdu->oid,pdu->value,pdu->n,&index)) != noError)
 	 {
-		uint32_t i;
+		encode->status = lookup_status (encode,status);
+		encode->index = index;
+	 }
+   else snmp_stats.snmpInTotalSetVars += pdu->n;
 
-		for (i = pdu->n; i > 0; i--)
-		  if (encode_value (encode,pdu->oid[i - 1],i))
-			return (-1);
+   return (0);
+}
+
+/*
+ * A request that failed with a genErr is answered with the variable
+ * bindings of the request (RFC 3416, 4.2.1). Returns 0 if successful,
+ * 1 if the response is too big, or -1 if some error occurred.
+ */
+static int lookup_failed (struct encode *encode)
+{
+   const snmp_pdu_t *pdu = encode->pdu;
+   uint32_t i;
+   int result;
+
+   snmp_stats.snmpOutGenErrs++;
+
+   encode->n = 0;
+   encode->length = 0;
+
+   for (i = 0; i < pdu->n; i++)
+	 if ((result = encode_add (encode,pdu->oid[i],0,NULL,BER_NULL)))
+	   return (result);
+
+   return (0);
+}
+
+static int lookup_varbind_list (struct encode *encode)
+{
+   const snmp_pdu_t *pdu = encode->pdu;
+   uint32_t i,N = pdu->NonRepeaters < pdu->n ? pdu->NonRepeaters : pdu->n;
+   uint64_t n = pdu->n ? pdu->n : 1;
+   int result = 0;
+
+   /* a variable binding takes up at least 7 bytes */
+   if (pdu->type == BER_GetBulkRequest)
+	 n = N + (uint64_t) (pdu->n - N) * pdu->MaxRepetitions;
+
+   if (encode_reserve (encode,n < encode->room / 7 ? n : encode->room / 7))
+	 return (-1);
+
+   switch (pdu->type)
+	 {
+	  case BER_GetBulkRequest:
+		/*
+		 * A GetBulk response is never answered with a tooBig
+		 * error. It is simply truncated after the last variable
+		 * binding that fits, even if that leaves out some of the
+		 * non-repeaters (RFC 3416, 4.2.3).
+		 */
+		if ((result = lookup_bulk (encode)) >= 0 && encode->status == genErr)
+		  {
+			 result = lookup_failed (encode);
+			 break;
+		  }
+
+		return (result < 0 ? -1 : 0);
+
+	  case BER_GetRequest:
+		for (i = 0; i < pdu->n && !result && encode->status != genErr; i++)
+		  result = lookup_value (encode,pdu->oid[i],i + 1);
+
+		if (!result && encode->status == genErr)
+		  result = lookup_failed (encode);
+		break;
+
+	  case BER_SetRequest:
+		result = lookup_set (encode);
+		break;
+
+	  default:
+		if (!pdu->n)
+		  result = lookup_next_value (encode,NULL,0);
+
+		for (i = 0; i < pdu->n && !result && encode->status != genErr; i++)
+		  result = lookup_next_value (encode,pdu->oid[i],i + 1);
+
+		if (!result && encode->status == genErr)
+		  result = lookup_failed (encode);
+	 }
+
+   /*
+	* If the response is too big, we return a tooBig error with an
+	* empty variable binding list. That always fits in the smallest
+	* response size allowed.
+	*/
+
+   if (result > 0)
+	 {
+		snmp_stats.snmpOutTooBigs++;
+		encode->status = tooBig;
+		encode->index = 0;
+		encode->n = 0;
+		encode->length = 0;
+		result = 0;
+	 }
+
+   return (result);
+}
+
+/*
+ * The functions below write the BER encoding of the various types
+ * to p and return a pointer to the first byte after it. The caller
+ * has already made sure that there is enough room.
+ */
+
+static __inline__ uint8_t *write_header (uint8_t *p,uint8_t type,size_t len)
+{
+   *p++ = type;
+
+   if (len & ~0x7f)
+	 {
+		size_t n = length_size (len) - 1;
+
+		for (*p++ = 0x80 | n; n; n--)
+		  *p++ = len >> ((n - 1) * 8);
+	 }
+   else *p++ = len;
+
+   return (p);
+}
+
+/*
+ * INTEGER, Counter32, Gauge32 and TimeTicks are by far the most
+ * common values, so they get a fast path of their own.
+ */
+static __inline__ uint8_t *write_uint32 (uint8_t *p,uint8_t type,uint32_t value,size_t n)
+{
+   p[0] = type;
+   p[1] = n;
+   p += 2 + n;
+
+   switch (n)
+	 {
+	  case 5:
+		p[-5] = 0;
+		/* fall through */
+	  case 4:
+		p[-4] = value >> 24;
+		/* fall through */
+	  case 3:
+		p[-3] = value >> 16;
+		/* fall through */
+	  case 2:
+		p[-2] = value >> 8;
+		/* fall through */
+	  case 1:
+		p[-1] = value;
 	 }
-   else
+
+   return (p);
+}
+
+static uint8_t *write_uint64 (uint8_t *p,uint8_t type,uint64_t value,size_t n)
+{
+   p = write_header (p,type,n);
+
+   /* values with the top bit set need a leading zero to stay positive */
+   if (n > sizeof (uint64_t))
+	 {
+		*p++ = 0;
+		n--;
+	 }
+
+   for ( ; n; n--)
+	 *p++ = value >> ((n - 1) * 8);
+
+   return (p);
+}
+
+static uint8_t *write_oid (uint8_t *p,const uint32_t *oid,size_t n)
+{
+   uint32_t i;
+
+   for (p = write_header (p,BER_OID,n), i = 1; i <= oid[0]; i++)
 	 {
-		if (pdu->n)
+		if (oid[i] & ~0x7f)
 		  {
-			 uint32_t i;
+			 for (n = arc_size (oid[i]) - 1; n; n--)
+			   *p++ = 0x80 | ((oid[i] >> (n * 7)) & 0x7f);
 
-			 for (i = pdu->n; i > 0; i--)
-			   if (encode_next_value (encode,pdu->oid[i - 1],i))
-				 return (-1);
+			 *p++ = oid[i] & 0x7f;
 		  }
-		else if (encode_next_value (encode,NULL,0))
-		  return (-1);
+		else *p++ = oid[i];
 	 }
 
-   return (ber_encode_sequence (encode->ber,encode->ber->offset));
+   return (p);
 }
 
-int snmp_encode (ber_t *ber,const snmp_pdu_t *pdu,time_t timeout)
+static __inline__ uint8_t *write_bytes (uint8_t *p,uint8_t type,const void *buf,size_t n)
+{
+   p = write_header (p,type,n);
+   memcpy (p,buf,n);
+
+   return (p + n);
+}
+
+static uint8_t *write_value (uint8_t *p,const struct varbind *varbind)
+{
+   const snmp_value_t *value = varbind->value;
+
+   if (value == NULL)
+	 return (write_header (p,varbind->type,0));
+
+   switch (value->type)
+	 {
+	  case BER_INTEGER:
+		return (write_uint32 (p,BER_INTEGER,value->data.INTEGER,varbind->length));
+	  case BER_Counter32:
+		return (write_uint32 (p,BER_Counter32,value->data.Counter32,varbind->length));
+	  case BER_Gauge32:
+		return (write_uint32 (p,BER_Gauge32,value->data.Gauge32,varbind->length));
+	  case BER_TimeTicks:
+		return (write_uint32 (p,BER_TimeTicks,value->data.TimeTicks,varbind->length));
+	  case BER_Counter64:
+		return (write_uint64 (p,BER_Counter64,value->data.Counter64,varbind->length));
+	  case BER_OID:
+		return (write_oid (p,value->data.OID,varbind->length));
+	  case BER_OCTET_STRING:
+		return (write_bytes (p,BER_OCTET_STRING,value->data.OCTET_STRING.buf,varbind->length));
+	  case BER_IpAddress:
+		return (write_bytes (p,BER_IpAddress,&value->data.IpAddress,varbind->length));
+	 }
+
+   return (write_header (p,BER_NULL,0));
+}
+
+static uint8_t *write_varbind (uint8_t *p,const struct varbind *varbind)
+{
+   /*
+	* VarBind ::= SEQUENCE
+	* name OBJECT IDENTIFIER
+	* value ObjectSyntax
+	*/
+   p = write_header (p,BER_SEQUENCE,tlv_size (varbind->oidlen) + tlv_size (varbind->length));
+   p = write_oid (p,varbind->oid,varbind->oidlen);
+
+   return (write_value (p,varbind));
+}
+
+/*
+ * The header of a message, i.e. everything up to the contents of
+ * the variable binding list.
+ */
+struct message
+{
+   int32_t version;
+   const octet_string_t *community;
+   uint8_t type;
+   int32_t RequestID;
+   uint32_t status;
+   uint32_t index;
+   size_t length;		/* encoded size of the variable bindings	*/
+};
+
+static size_t message_size (const struct message *msg,size_t *pdulen)
+{
+   *pdulen = tlv_size (integer_size (msg->RequestID)) +
+	 tlv_size (integer_size (msg->status)) +
+	 tlv_size (integer_size (msg->index)) +
+	 tlv_size (msg->length);
+
+   return (tlv_size (integer_size (msg->version)) +
+		   tlv_size (msg->community->len) +
+		   tlv_size (*pdulen));
+}
+
+/*
+ * Every length is known at this point, so each byte is written
+ * exactly once.
+ */
+static uint8_t *write_message (uint8_t *p,const struct message *msg)
+{
+   size_t pdulen,msglen = message_size (msg,&pdulen);
+
+   /*
+	* Message ::= SEQUENCE
+	* version INTEGER
+	* community OCTET STRING
+	* PDU { GetResponse-PDU, SNMPv2-Trap-PDU, InformRequest-PDU }
+	* Request-ID INTEGER
+	* ErrorStatus INTEGER
+	* ErrorIndex INTEGER
+	* VarBindList ::= SEQUENCE OF
+	*/
+
+   p = write_header (p,BER_SEQUENCE,msglen);
+   p = write_uint32 (p,BER_INTEGER,msg->version,integer_size (msg->version));
+   p = write_bytes (p,BER_OCTET_STRING,msg->community->buf,msg->community->len);
+   p = write_header (p,msg->type,pdulen);
+   p = write_uint32 (p,BER_INTEGER,msg->RequestID,integer_size (msg->RequestID));
+   p = write_uint32 (p,BER_INTEGER,msg->status,integer_size (msg->status));
+   p = write_uint32 (p,BER_INTEGER,msg->index,integer_size (msg->index));
+
+   return (write_header (p,BER_SEQUENCE,msg->length));
+}
+
+/*
+ * Write everything up to the contents of the variable binding list
+ * to the start of the packet buffer.
+ */
+static uint8_t *encode_header (struct encode *encode,ber_t *ber)
+{
+   const struct message msg =
+	 {
+		.version	= encode->version,
+		.community	= &encode->pdu->community,
+		.type		= BER_GetResponse,
+		.RequestID	= encode->pdu->RequestID,
+		.status		= encode->status,
+		.index		= encode->index,
+		.length		= encode->length
+	 };
+
+   return (write_message (ber->buf,&msg));
+}
+
+static uint8_t *encode_varbind_list (struct encode *encode,uint8_t *p)
+{
+   uint32_t i;
+
+   for (i = 0; i < encode->n; i++)
+	 p = write_varbind (p,encode->varbind + i);
+
+   return (p);
+}
+
+/*
+ * The key of a request in the response cache is everything in the
+ * request except the request ID, as well as the size limit. Returns
+ * the key or NULL if some error occurred.
+ */
+static uint8_t *encode_key (const struct encode *encode,size_t *keylen)
+{
+   const snmp_pdu_t *pdu = encode->pdu;
+   const uint32_t head[] =
+	 {
+		encode->limit,
+		pdu->version,
+		pdu->type,
+		pdu->NonRepeaters,
+		pdu->MaxRepetitions,
+		pdu->community.len
+	 };
+   size_t len = sizeof (head) + pdu->community.len;
+   uint8_t *key,*p;
+   uint32_t i;
+
+   for (i = 0; i < pdu->n; i++)
+	 len += (pdu->oid[i][0] + 1) * sizeof (uint32_t);
+
+   if ((key = p = arena_alloc (encode->scratch,len)) == NULL)
+	 return (NULL);
+
+   memcpy (p,head,sizeof (head));
+   p += sizeof (head);
+
+   memcpy (p,pdu->community.buf,pdu->community.len);
+   p += pdu->community.len;
+
+   for (i = 0; i < pdu->n; i++)
+	 {
+		memcpy (p,pdu->oid[i],(pdu->oid[i][0] + 1) * sizeof (uint32_t));
+		p += (pdu->oid[i][0] + 1) * sizeof (uint32_t);
+	 }
+
+   *keylen = len;
+
+   return (key);
+}
+
+int snmp_encode (ber_t *ber,const snmp_pdu_t *pdu,time_t timeout,const uint32_t *view,struct arena *scratch,struct replies *replies)
 {
    struct encode encode =
 	 {
-		.ber		= ber,
+		.pdu		= pdu,
+		.version	= pdu->version,
 		.status		= noError,
 		.index		= 0,
-		.timeout	= timeout
+		.timeout	= timeout,
+		.view		= view,
+		.scratch	= scratch,
+		.varbind	= NULL,
+		.n			= 0,
+		.size		= 0,
+		.length		= 0,
+		.limit		= SNMP_RESPONSE_MAX
 	 };
+   struct reply reply;
+   uint32_t reqvars,nosuchnames;
+   uint64_t generation = 0;
+   uint8_t *key = NULL,*p;
+   size_t keylen,overhead;
+   const struct reply *cached;
 
    abz_clear_error ();
 
+   module_request ();
+
+   if (encode.limit > ber->size)
+	 encode.limit = ber->size;
+
+   /*
+	* Responses can only be reused if the module caches don't change
+	* behind our back, i.e. if all of them are refreshed by timers.
+	* Set requests have side effects, so those are never cached.
+	*/
+
+   if (replies != NULL && replies->n && pdu->type != BER_SetRequest && module_scheduled ())
+	 {
+		generation = module_generation ();
+
+		if ((key = encode_key (&encode,&keylen)) == NULL)
+		  return (-1);
+
+		if ((cached = replies_find (replies,key,keylen,generation)) != NULL)
+		  {
+			 encode.status = cached->status;
+			 encode.index = cached->index;
+			 encode.length = cached->length;
+
+			 snmp_stats.snmpInTotalReqVars += cached->reqvars;
+			 snmp_stats.snmpOutNoSuchNames += cached->nosuchnames;
+
+			 if (cached->status == tooBig)
+			   snmp_stats.snmpOutTooBigs++;
+
+			 snmp_stats.snmpOutGetResponses++;
+
+			 p = encode_header (&encode,ber);
+			 memcpy (p,cached->data,cached->length);
+
+			 ber->offset = ber->size = p + cached->length - ber->buf;
+
+			 return (0);
+		  }
+	 }
+
+   /* assume the worst about the size of the length fields */
+   overhead = response_size (&encode,encode.limit) - encode.limit;
+   encode.room = encode.limit > overhead ? encode.limit - overhead : 0;
+
+   reqvars = snmp_stats.snmpInTotalReqVars;
+   nosuchnames = snmp_stats.snmpOutNoSuchNames;
+
+   if (lookup_varbind_list (&encode))
+	 return (-1);
+
    snmp_stats.snmpOutGetResponses++;
 
-   return (encode_varbind_list (&encode,pdu) ||
-		   ber_encode_integer (ber,encode.index) ||
-		   ber_encode_integer (ber,encode.status) ||
-		   ber_encode_integer (ber,pdu->RequestID) ||
-		   ber_encode_get_response (ber) ||
-		   ber_encode_octet_string (ber,&pdu->community) ||
-		   ber_encode_integer (ber,pdu->version) ||
-		   ber_encode_sequence (ber,ber->offset) ?
-		   -1 : 0);
+   p = encode_header (&encode,ber);
+   reply.data = p;
+   p = encode_varbind_list (&encode,p);
+
+   /* the packet is at buf + size - offset, just like libber does it */
+   ber->offset = ber->size = p - ber->buf;
+
+   /* if we can't cache the response, the next request simply misses */
+   if (key != NULL)
+	 {
+		reply.status = encode.status;
+		reply.index = encode.index;
+		reply.length = encode.length;
+		reply.reqvars = snmp_stats.snmpInTotalReqVars - reqvars;
+		reply.nosuchnames = snmp_stats.snmpOutNoSuchNames - nosuchnames;
+
+		replies_store (replies,key,keylen,generation,&reply);
+	 }
+
+   return (0);
 }
 
+size_t snmp_encode_varbinds (uint8_t *buf,size_t size,const snmp_next_value_t *next,size_t n)
+{
+   struct varbind varbind;
+   size_t i,length = 0;
+   uint8_t *p = buf;
+
+   abz_clear_error ();
+
+   for (i = 0; i < n; i++)
+	 length += tlv_size (tlv_size (oid_size (next[i].oid)) + tlv_size (value_size (&next[i].value)));
+
+   if (length > size)
+	 {
+		abz_set_error ("variable bindings too big (%u bytes)",(unsigned) length);
+		return (0);
+	 }
+
+   for (i = 0; i < n; i++)
+	 {
+		varbind.oid = next[i].oid;
+		varbind.value = &next[i].value;
+		varbind.type = next[i].value.type;
+		varbind.oidlen = oid_size (next[i].oid);
+		varbind.length = value_size (&next[i].value);
+
+		p = write_varbind (p,&varbind);
+	 }
+
+   return (length);
+}
+
+int snmp_encode_message (ber_t *ber,const snmp_pdu_t *pdu,const uint8_t *varbinds,size_t length)
+{
+   const struct message msg =
+	 {
+		.version	= pdu->version,
+		.community	= &pdu->community,
+		.type		= pdu->type,
+		.RequestID	= pdu->RequestID,
+		.status		= 0,
+		.index		= 0,
+		.length		= length
+	 };
+   size_t pdulen;
+   uint8_t *p;
+
+   abz_clear_error ();
+
+   if (tlv_size (message_size (&msg,&pdulen)) > ber->size)
+	 {
+		abz_set_error ("%s pdu too big",pdu_type_str (pdu->type));
+		return (-1);
+	 }
+
+   p = write_message (ber->buf,&msg);
+   memcpy (p,varbinds,length);
+
+   ber->offset = ber->size = p + length - ber->buf;
+
+   return (0);
+}
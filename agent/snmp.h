@@ -36,23 +36,76 @@
 #include <ber/ber.h>
 #include <tinysnmp/tinysnmp.h>
 
+/* smallest and largest response size that may be configured */
+#define SNMP_RESPONSE_MIN 484
+#define SNMP_RESPONSE_MAX 65507
+
+/* largest UDP datagram that fits in an unfragmented ethernet frame */
+#define SNMP_RESPONSE_DEFAULT 1472
+
+struct arena;
+struct replies;
+
 /*
- * Encode a GetResponse-PDU packet. Returns 0 if successful, -1 if
- * some error occurred. Call abz_get_error() to retrieve the error
- * message.
+ * Encode a GetResponse-PDU packet of at most ber->size bytes. If the
+ * variable bindings don't fit, a tooBig error is returned instead.
+ * GetBulkRequest responses are truncated instead. The values of a
+ * SetRequest are assigned before the response is encoded. If view is
+ * not NULL, only the ObjectID's below it can be retrieved or assigned.
+ * The packet is written to the start of the buffer and both the offset and size
+ * of ber are set to its length. Scratch memory needed while answering
+ * the request is allocated from the specified arena. If replies is
+ * not NULL, responses are looked up in and added to that cache.
+ * Returns 0 if successful, -1 if some error occurred. Call
+ * abz_get_error() to retrieve the error message.
  */
-extern int snmp_encode (ber_t *ber,const snmp_pdu_t *pdu,time_t timeout);
+extern int snmp_encode (ber_t *ber,const snmp_pdu_t *pdu,time_t timeout,const uint32_t *view,struct arena *scratch,struct replies *replies);
 
 /*
- * Decode a GetRequest-PDU or GetNextRequest-PDU. Returns 0 if
- * successful, -1 if some error occurred. Call abz_get_error() to
+ * Encode a list of n variable bindings into buf, which has room for
+ * size bytes. Returns the number of bytes written if successful, or
+ * 0 if the variable bindings don't fit. Call abz_get_error() to
  * retrieve the error message.
  */
-extern int snmp_decode (snmp_pdu_t *pdu,ber_t *ber);
+extern size_t snmp_encode_varbinds (uint8_t *buf,size_t size,const snmp_next_value_t *varbind,size_t n);
+
+/*
+ * Encode a message of at most ber->size bytes with the version,
+ * community, type and request ID of the pdu. The error fields are
+ * zero and the variable bindings are those encoded previously with
+ * snmp_encode_varbinds(). The packet is written to the start of the
+ * buffer and both the offset and size of ber are set to its length.
+ * Returns 0 if successful, -1 if some error occurred. Call
+ * abz_get_error() to retrieve the error message.
+ */
+extern int snmp_encode_message (ber_t *ber,const snmp_pdu_t *pdu,const uint8_t *varbinds,size_t length);
+
+/*
+ * Decode a GetRequest-PDU, GetNextRequest-PDU, SetRequest-PDU,
+ * GetResponse-PDU or GetBulkRequest-PDU (SNMPv2c only). The community,
+ * ObjectID's and values are allocated from the specified arena, so the
+ * pdu is valid until the arena is reset.
+ * Returns 0 if successful, -1 if some error occurred. Call
+ * abz_get_error() to retrieve the error message.
+ */
+extern int snmp_decode (snmp_pdu_t *pdu,ber_t *ber,struct arena *scratch);
+
+/*
+ * The two halves of snmp_decode(). The first decodes the version and
+ * community, so that requests with the wrong community can be
+ * rejected before the rest of the packet is decoded. The second
+ * continues where the first left off.
+ */
+extern int snmp_decode_header (snmp_pdu_t *pdu,ber_t *ber,struct arena *scratch);
+extern int snmp_decode_pdu (snmp_pdu_t *pdu,ber_t *ber,struct arena *scratch);
 
 /*
- * Free memory allocated by pdu_encode() or pdu_decode().
+ * Decode just enough of a GetResponse-PDU to match it with the request
+ * it answers, i.e. the header and the request ID. The error fields are
+ * counted but otherwise ignored, and the variable bindings are skipped.
+ * Returns 0 if successful, -1 if some error occurred. Call
+ * abz_get_error() to retrieve the error message.
  */
-extern void snmp_free (snmp_pdu_t *pdu);
+extern int snmp_decode_response (snmp_pdu_t *pdu,ber_t *ber,struct arena *scratch);
 
 #endif	/* #ifndef SNMP_H */
@@ -0,0 +1,259 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <abz/error.h>
+#include <debug/memory.h>
+
+#include <tinysnmp/tinysnmp.h>
+#include <tinysnmp/unaligned.h>
+
+#include "arena.h"
+#include "value.h"
+
+void value_free (snmp_value_t *value)
+{
+   if (value->type == BER_OID)
+	 mem_free (value->data.OID);
+   else if (value->type == BER_OCTET_STRING && value->data.OCTET_STRING.len)
+	 mem_free (value->data.OCTET_STRING.buf);
+}
+
+static void *value_alloc (struct arena *arena,size_t size)
+{
+   void *ptr;
+
+   if (arena != NULL)
+	 return (arena_alloc (arena,size));
+
+   if ((ptr = mem_alloc (size)) == NULL)
+	 abz_set_error ("failed to allocate memory: %m");
+
+   return (ptr);
+}
+
+static int value_clone (struct arena *arena,snmp_value_t *dest,const snmp_value_t *src)
+{
+   copy_unaligned (dest,src);
+
+   if (src->type == BER_OCTET_STRING)
+	 {
+		uint32_t len = src->data.OCTET_STRING.len;
+
+		if (len)
+		  {
+			 if ((dest->data.OCTET_STRING.buf = value_alloc (arena,len)) == NULL)
+			   return (-1);
+
+			 memcpy (dest->data.OCTET_STRING.buf,src->data.OCTET_STRING.buf,len);
+		  }
+	 }
+   else if (src->type == BER_OID)
+	 {
+		uint32_t len = (src->data.OID[0] + 1) * sizeof (uint32_t);
+
+		if ((dest->data.OID = value_alloc (arena,len)) == NULL)
+		  return (-1);
+
+		memcpy (dest->data.OID,src->data.OID,len);
+	 }
+
+   return (0);
+}
+
+int value_copy (snmp_value_t *dest,const snmp_value_t *src)
+{
+   return (value_clone (NULL,dest,src));
+}
+
+int value_dup (struct arena *arena,snmp_value_t *dest,const snmp_value_t *src)
+{
+   return (value_clone (arena,dest,src));
+}
+
+#ifdef DEBUG
+
+#include <debug/log.h>
+
+static void show_integer (const char *filename,int line,const char *function,
+						  int level,const snmp_value_t *value)
+{
+   log_printf_stub (filename,line,function,level,
+					"INTEGER %" PRId32,
+					value->data.INTEGER);
+}
+
+static void show_counter32 (const char *filename,int line,const char *function,
+							int level,const snmp_value_t *value)
+{
+   log_printf_stub (filename,line,function,level,
+					"Counter32 %" PRIu32,
+					value->data.Counter32);
+}
+
+static void show_gauge32 (const char *filename,int line,const char *function,
+						  int level,const snmp_value_t *value)
+{
+   log_printf_stub (filename,line,function,level,
+					"Gauge32 %" PRIu32,
+					value->data.Gauge32);
+}
+
+static void show_timeticks (const char *filename,int line,const char *function,
+							int level,const snmp_value_t *value)
+{
+   uint32_t day,ms,sec,min,hour;
+
+   log_printf_stub (filename,line,function,level,
+					"TimeTicks (%" PRIu32 ") ",
+					value->data.TimeTicks);
+
+   ms = value->data.TimeTicks % 100, day = (value->data.TimeTicks - ms) / 100;
+   sec = day % 60, day = (day - sec) / 60;
+   min = day % 60, day = (day - min) / 60;
+   hour = day % 24, day = (day - hour) / 24;
+
+   if (day)
+	 log_printf_stub (filename,line,function,level,
+					  "%" PRIu32 " day%s, ",
+					  day,day > 1 ? "s" : "");
+
+   log_printf_stub (filename,line,function,level,
+					"%02" PRIu32 ":%02" PRIu32 ":%02" PRIu32 ".%02" PRIu32,
+					hour,min,sec,ms);
+}
+
+static void show_counter64 (const char *filename,int line,const char *function,
+							int level,const snmp_value_t *value)
+{
+   log_printf_stub (filename,line,function,level,
+					"Counter64 %" PRIu64,
+					value->data.Counter64);
+}
+
+static void show_oid (const char *filename,int line,const char *function,
+					  int level,const snmp_value_t *value)
+{
+   uint32_t i;
+
+   log_printf_stub (filename,line,function,level,
+					"OBJECT IDENTIFIER %" PRIu32 ".%" PRIu32,
+					value->data.OID[1] / 40,value->data.OID[1] % 40);
+
+   for (i = 2; i <= value->data.OID[0]; i++)
+	 log_printf_stub (filename,line,function,level,
+					  ".%" PRIu32,
+					  value->data.OID[i]);
+}
+
+static __inline__ int printable (int c)
+{
+   return ((c >= 32 && c <= 126) ||
+		   (c >= 174 && c <= 223) ||
+		   (c >= 242 && c <= 243) ||
+		   (c >= 252 && c <= 253));
+}
+
+static void show_octet_string (const char *filename,int line,const char *function,
+							   int level,const snmp_value_t *value)
+{
+   uint32_t i;
+   int raw = 0;
+
+   log_puts_stub (filename,line,function,level,"OCTET STRING");
+
+   for (i = 0; i < value->data.OCTET_STRING.len && !raw; i++)
+	 if (!printable (value->data.OCTET_STRING.buf[i]))
+	   raw = 1;
+
+   if (!raw)
+	 {
+		log_putc_stub (filename,line,function,level,' ');
+
+		for (i = 0; i < value->data.OCTET_STRING.len; i++)
+		  log_putc_stub (filename,line,function,level,value->data.OCTET_STRING.buf[i]);
+	 }
+   else
+	 {
+		for (i = 0; i < value->data.OCTET_STRING.len; i++)
+		  log_printf_stub (filename,line,function,level,
+						   " %02x",
+						   value->data.OCTET_STRING.buf[i]);
+	 }
+}
+
+static void show_ipaddress (const char *filename,int line,const char *function,
+							int level,const snmp_value_t *value)
+{
+   log_printf_stub (filename,line,function,level,
+					"IpAddress %u.%u.%u.%u",
+					NIPQUAD (value->data.IpAddress));
+}
+
+static void show_null (const char *filename,int line,const char *function,
+					   int level,const snmp_value_t *value)
+{
+   log_puts_stub (filename,line,function,level,"No Such Name");
+}
+
+void value_show_stub (const char *filename,int line,const char *function,
+					  int level,const snmp_value_t *value)
+{
+   static const struct
+	 {
+		uint8_t type;
+		void (*show) (const char *,int,const char *,int,const snmp_value_t *);
+	 } list[] =
+	 {
+		{ BER_INTEGER, show_integer },
+		{ BER_Counter32, show_counter32 },
+		{ BER_Gauge32, show_gauge32 },
+		{ BER_TimeTicks, show_timeticks },
+		{ BER_Counter64, show_counter64 },
+		{ BER_OID, show_oid },
+		{ BER_OCTET_STRING, show_octet_string },
+		{ BER_IpAddress, show_ipaddress },
+		{ BER_NULL, show_null }
+	 };
+   size_t i;
+
+   for (i = 0; i < ARRAYSIZE (list); i++)
+	 if (value->type == list[i].type)
+	   {
+		  list[i].show (filename,line,function,level,value);
+		  return;
+	   }
+
+   log_puts_stub (filename,line,function,level,"(unknown)");
+}
+
+#endif	/* #ifdef DEBUG */
@@ -0,0 +1,63 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <tinysnmp/tinysnmp.h>
+
+#include "arena.h"
+
+/*
+ * Copy an snmp value. OCTET STRING and OBJECT IDENTIFIER values
+ * are duplicated. Returns 0 if successful, -1 if some error occurred.
+ * Call abz_get_error() to retrieve the error message.
+ */
+extern int value_copy (snmp_value_t *dest,const snmp_value_t *src);
+
+/*
+ * Same as value_copy(), but OCTET STRING and OBJECT IDENTIFIER
+ * values are duplicated in the specified arena.
+ */
+extern int value_dup (struct arena *arena,snmp_value_t *dest,const snmp_value_t *src);
+
+/*
+ * Free memory allocated by value_copy().
+ */
+extern void value_free (snmp_value_t *value);
+
+/*
+ * Display an snmp value (without a trailing newline).
+ */
+#ifdef DEBUG
+extern void value_show_stub (const char *filename,int line,const char *function,
+							 int level,const snmp_value_t *value);
+#endif	/* #ifdef DEBUG */
+
+#endif	/* #ifndef VALUE_H */
@@ -0,0 +1,265 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <event.h>
+
+#include <debug/log.h>
+#include <debug/memory.h>
+
+#include <abz/error.h>
+
+#include "worker.h"
+
+/*
+ * Jobs are handed to the workers through a queue protected by a
+ * mutex. Finished jobs are written to a pipe, which is watched by
+ * the event loop, so that their done() callbacks (and everything
+ * else which deals with libevent) run in the event loop's thread.
+ *
+ * Neither libabz nor libdebug is thread-safe, so only one job runs
+ * at a time, and never while some other thread holds the lock (see
+ * worker_lock() below). A worker takes the job and the lock in one
+ * go, so it never sits on a job while waiting for the lock.
+ */
+static pthread_t *thread = NULL;
+static size_t nthreads = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static struct job *head = NULL,*tail = NULL;
+static int finished = 0;
+static int busy = 0;
+static size_t waiting = 0;
+static __thread size_t depth = 0;
+static int fd[2] = { -1, -1 };
+static struct event event;
+static int watching = 0;
+
+static void *worker_main (void *arg)
+{
+   struct job *job;
+
+   for (;;)
+	 {
+		pthread_mutex_lock (&lock);
+
+		/* threads waiting for the lock go first */
+		while ((head == NULL || busy || waiting) && !finished)
+		  pthread_cond_wait (&cond,&lock);
+
+		if (finished)
+		  {
+			 pthread_mutex_unlock (&lock);
+			 break;
+		  }
+
+		job = head;
+
+		if ((head = head->next) == NULL)
+		  tail = NULL;
+
+		busy = 1;
+		depth = 1;
+		pthread_mutex_unlock (&lock);
+
+		job->run (job);
+
+		worker_unlock ();
+
+		/* a pointer is less than PIPE_BUF, so this is atomic */
+		while (write (fd[1],&job,sizeof (job)) < 0 && errno == EINTR)
+		  ;
+	 }
+
+   return (NULL);
+}
+
+static void worker_event (int fd,short event,void *arg)
+{
+   struct job *job[64];
+   ssize_t result;
+   size_t i;
+
+   worker_lock ();
+
+   while ((result = read (fd,job,sizeof (job))) > 0)
+	 for (i = 0; i < result / sizeof (struct job *); i++)
+	   job[i]->done (job[i]);
+
+   worker_unlock ();
+}
+
+int worker_open (size_t n)
+{
+   sigset_t set,saved;
+   int flags;
+
+   abz_clear_error ();
+
+   if (!n)
+	 return (0);
+
+   if (pipe (fd))
+	 {
+		abz_set_error ("failed to create pipe: %m");
+		return (-1);
+	 }
+
+   if ((flags = fcntl (fd[0],F_GETFL)) < 0 || fcntl (fd[0],F_SETFL,flags | O_NONBLOCK))
+	 {
+		abz_set_error ("failed to set non-blocking i/o: %m");
+		worker_close ();
+		return (-1);
+	 }
+
+   event_set (&event,fd[0],EV_READ | EV_PERSIST,worker_event,NULL);
+
+   if (event_add (&event,NULL))
+	 {
+		abz_set_error ("failed to add event handler: %m");
+		worker_close ();
+		return (-1);
+	 }
+
+   watching = 1;
+
+   if ((thread = mem_alloc (n * sizeof (pthread_t))) == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		worker_close ();
+		return (-1);
+	 }
+
+   /* signals should only ever be delivered to the event loop */
+   sigfillset (&set);
+   pthread_sigmask (SIG_SETMASK,&set,&saved);
+
+   for (nthreads = 0; nthreads < n; nthreads++)
+	 if (pthread_create (thread + nthreads,NULL,worker_main,NULL))
+	   {
+		  pthread_sigmask (SIG_SETMASK,&saved,NULL);
+		  abz_set_error ("failed to create worker thread");
+		  worker_close ();
+		  return (-1);
+	   }
+
+   pthread_sigmask (SIG_SETMASK,&saved,NULL);
+
+   log_printf (LOG_VERBOSE,"started %u worker threads\n",(unsigned) n);
+
+   return (0);
+}
+
+void worker_close (void)
+{
+   size_t i;
+
+   pthread_mutex_lock (&lock);
+   finished = 1;
+   head = tail = NULL;
+   pthread_cond_broadcast (&cond);
+   pthread_mutex_unlock (&lock);
+
+   for (i = 0; i < nthreads; i++)
+	 pthread_join (thread[i],NULL);
+
+   if (thread != NULL)
+	 {
+		mem_free (thread);
+		thread = NULL;
+	 }
+
+   nthreads = 0;
+
+   if (fd[0] >= 0)
+	 {
+		if (watching)
+		  event_del (&event);
+
+		watching = 0;
+
+		close (fd[0]);
+		close (fd[1]);
+		fd[0] = fd[1] = -1;
+	 }
+}
+
+int worker_present (void)
+{
+   return (nthreads > 0);
+}
+
+void worker_queue (struct job *job)
+{
+   job->next = NULL;
+
+   pthread_mutex_lock (&lock);
+
+   if (tail != NULL)
+	 tail->next = job;
+   else
+	 head = job;
+
+   tail = job;
+
+   pthread_cond_broadcast (&cond);
+   pthread_mutex_unlock (&lock);
+}
+
+void worker_lock (void)
+{
+   if (depth++)
+	 return;
+
+   pthread_mutex_lock (&lock);
+   waiting++;
+
+   while (busy)
+	 pthread_cond_wait (&cond,&lock);
+
+   waiting--;
+   busy = 1;
+   pthread_mutex_unlock (&lock);
+}
+
+void worker_unlock (void)
+{
+   if (--depth)
+	 return;
+
+   pthread_mutex_lock (&lock);
+   busy = 0;
+   pthread_cond_broadcast (&cond);
+   pthread_mutex_unlock (&lock);
+}
@@ -0,0 +1,81 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+
+/*
+ * A job which is run by one of the worker threads. Once it has
+ * finished, done() is called from the event loop.
+ */
+struct job
+{
+   void (*run) (struct job *job);
+   void (*done) (struct job *job);
+   struct job *next;
+};
+
+/*
+ * Start n worker threads. This should be called after event_init().
+ * Returns 0 if successful, -1 if some error occurred. Call
+ * abz_get_error() to retrieve the error message.
+ */
+extern int worker_open (size_t n);
+
+/*
+ * Stop all worker threads. Jobs which are still queued are discarded,
+ * but jobs which are already running are allowed to finish.
+ */
+extern void worker_close (void);
+
+/*
+ * Returns a non-zero integer if worker threads were started, or zero
+ * if not.
+ */
+extern int worker_present (void);
+
+/*
+ * Queue a job. A job should not be queued again before its done()
+ * callback was called.
+ */
+extern void worker_queue (struct job *job);
+
+/*
+ * Neither libabz nor libdebug is thread-safe. Jobs are run with this
+ * lock held, so any other thread has to hold it while it calls into
+ * either library (or into a module). A thread may take the lock more
+ * than once, as long as it releases it as often. The lock must not
+ * be taken inside an epoch (see epoch.h), since the job holding it
+ * may be waiting for the epoch to end.
+ */
+extern void worker_lock (void);
+extern void worker_unlock (void);
+
+#endif	/* #ifndef WORKER_H */
@@ -40,3 +40,6 @@ COMPAT22 = "yes"
 # Enable support for resolving hostnames and services
 RESOLVE = "yes"
 
+# ObjectID database used by the agent (either "tree" or "array")
+ODB = "tree"
+
@@ -31,11 +31,33 @@
 
 #include <stdint.h>
 #include <time.h>
+#include <pthread.h>
 
 #include <abz/typedefs.h>
 #include <abz/tokens.h>
 #include <tinysnmp/agent/odb.h>
 
+/*
+ * Version of struct module and of the other data structures shared
+ * with the agent. Every module has to export the version of the
+ * headers it was built against as
+ *
+ *     const uint32_t module_abi = MODULE_ABI;
+ *
+ * and the agent refuses to load modules built for another version.
+ */
+#define MODULE_ABI 1
+
+extern const uint32_t module_abi;
+
+/* phases of a set request */
+enum
+{
+   MODULE_SET_TEST,		/* check whether the value can be assigned		*/
+   MODULE_SET_COMMIT,	/* assign the value								*/
+   MODULE_SET_UNDO		/* restore the value from before the request	*/
+};
+
 struct module
 {
    /* declared by module */
@@ -46,11 +68,19 @@ struct module
    int (*parse) (struct tokens *tokens);
    int (*open) (void);
    int (*update) (struct odb **odb);
+   void (*published) (void);
+   int (*set) (int phase,const uint32_t *oid,const snmp_value_t *value);
    void (*close) (void);
 
    /* used by agent */
    struct odb *cache;
+   struct odb *shadow;
    time_t timestamp;
+   time_t timeout;
+   uint32_t request;
+   pthread_mutex_t lock;
+   int dirty;
+   int stale;
    int parsing;
    struct module *next;
 };
@@ -29,24 +29,16 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <tinysnmp/tinysnmp.h>
 
-typedef enum { NODE, VALUE } node_t;
-
-struct odb
-{
-   node_t type;
-   union
-	 {
-		uint32_t node;
-		snmp_value_t value;
-	 } data;
-   struct odb *parent;
-   struct odb *sibling;
-   struct odb *child;
-};
+/*
+ * The layout of the database depends on the backend the agent was
+ * built with, so modules should only ever use the functions below.
+ */
+struct odb;
 
 /*
  * Create an ObjectID database.
@@ -59,6 +51,18 @@ extern void odb_create (struct odb **odb);
  */
 extern void odb_destroy (struct odb **odb);
 
+/*
+ * Remove all the ObjectID's from an ObjectID database. Memory used
+ * by the database is released in one go, but kept for reuse by
+ * subsequent calls to odb_add().
+ */
+extern void odb_clear (struct odb **odb);
+
+/*
+ * Return the number of bytes used by an ObjectID database.
+ */
+extern size_t odb_size (const struct odb *odb);
+
 /*
  * Add a new ObjectID to the ObjectID database. Returns 0 if
  * successful, -1 otherwise. Call abz_get_error() to retrieve
@@ -66,6 +70,15 @@ extern void odb_destroy (struct odb **odb);
  */
 extern int odb_add (struct odb **odb,const uint32_t *oid,const snmp_value_t *value);
 
+/*
+ * Put ObjectID's which were added out of order in their proper place.
+ * This should be called once all the ObjectID's have been added to
+ * the database; lookups are fastest afterwards. Returns 0 if
+ * successful, -1 otherwise. Call abz_get_error() to retrieve the
+ * error message.
+ */
+extern int odb_sort (struct odb **odb);
+
 /*
  * Remove an ObjectID (or collection of ObjectID's) from the ObjectID
  * database.
@@ -89,6 +102,24 @@ extern const snmp_value_t *odb_find (const struct odb *odb,const uint32_t *oid);
  */
 extern snmp_next_value_t *odb_find_next (const struct odb *odb,const uint32_t *oid);
 
+/*
+ * Maximum number of sub-identifiers in an ObjectID (RFC 2578, 3.5).
+ * Buffers that hold an ObjectID need one more word for the length.
+ */
+#define ODB_OID_MAX 128
+
+/*
+ * Same as odb_find_next(), but nothing is allocated. The ObjectID
+ * is written to next, which should have room for size sub-identifiers
+ * (including the length), and *value points into the database. It
+ * remains valid until the database is modified.
+ *
+ * Returns 0 if successful, 1 if no ObjectID succeeds the specified
+ * one, or -1 if the ObjectID that does is too long for next. Call
+ * abz_get_error() to retrieve the error message.
+ */
+extern int odb_find_next_ref (const struct odb *odb,const uint32_t *oid,uint32_t *next,size_t size,const snmp_value_t **value);
+
 /*
  * Display an ObjectID database. Returns 0 if successful, or -1 if some
  * error occurred. Call abz_get_error() to retrieve the error message.
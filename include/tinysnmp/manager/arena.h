@@ -0,0 +1,88 @@
+#ifndef _MANAGER_ARENA_H
+#define _MANAGER_ARENA_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+
+/*
+ * An arena hands out memory for decoded responses. Nothing is freed
+ * individually; snmp_arena_reset() releases everything at once but
+ * keeps the memory around, so a collector that resets the arena after
+ * every response stops allocating memory once the arena has grown
+ * large enough.
+ */
+
+struct snmp_arena_block;
+
+typedef struct
+{
+   struct snmp_arena_block *block;		/* blocks, in the order they were allocated	*/
+   struct snmp_arena_block *current;	/* block we are currently allocating from	*/
+   size_t used;							/* number of bytes handed out				*/
+   size_t size;							/* number of bytes allocated for blocks		*/
+} snmp_arena_t;
+
+/*
+ * Initialize arena structure. No memory is allocated until
+ * something is decoded into the arena.
+ *
+ *     arena        memory arena
+ */
+extern void snmp_arena_init (snmp_arena_t *arena);
+
+/*
+ * Allocate memory from the arena. The memory is suitably aligned
+ * for any of the snmp types.
+ *
+ *     arena        memory arena
+ *     size         number of bytes to allocate
+ *
+ * Returns a pointer to the memory, or NULL if some error occurred.
+ * The caller may retrieve the error message with abz_get_error().
+ */
+extern void *snmp_arena_alloc (snmp_arena_t *arena,size_t size);
+
+/*
+ * Release everything allocated from the arena. All values decoded
+ * into the arena become invalid.
+ *
+ *     arena        memory arena
+ */
+extern void snmp_arena_reset (snmp_arena_t *arena);
+
+/*
+ * Free all memory allocated by the arena. The arena may be used
+ * again afterwards.
+ *
+ *     arena        memory arena
+ */
+extern void snmp_arena_destroy (snmp_arena_t *arena);
+
+#endif	/* #ifndef _MANAGER_ARENA_H */
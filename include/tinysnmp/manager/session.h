@@ -0,0 +1,269 @@
+#ifndef _MANAGER_SESSION_H
+#define _MANAGER_SESSION_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+#include <tinysnmp/tinysnmp.h>
+#include <tinysnmp/manager/snmp.h>
+#include <tinysnmp/manager/arena.h>
+#include <ber/ber.h>
+
+/*
+ * A session sends requests to any number of agents over a single
+ * unconnected UDP socket. Responses are matched to the requests in
+ * flight by their request id and handed to a callback, so thousands
+ * of agents can be polled concurrently from one event loop.
+ */
+
+/*
+ * Round-trip time estimate and counters of an agent. The estimate
+ * is maintained as in TCP (RFC 6298): only responses to requests
+ * that were never retransmitted are sampled, and the retransmission
+ * timeout backs off whenever a request times out.
+ */
+typedef struct
+{
+   uint32_t srtt;					/* smoothed round-trip time (microseconds)							*/
+   uint32_t rttvar;					/* round-trip time variation (microseconds)							*/
+   uint32_t rto;					/* retransmission timeout (milliseconds), 0 until first measured	*/
+   uint32_t requests;				/* requests sent, not counting retransmissions						*/
+   uint32_t retransmits;			/* requests that were retransmitted									*/
+   uint32_t responses;				/* responses received												*/
+   uint32_t timeouts;				/* requests that were never answered								*/
+} snmp_rtt_t;
+
+typedef struct
+{
+   struct sockaddr_in addr;
+   octet_string_t community;
+   int32_t version;
+   snmp_rtt_t rtt;					/* may be read at any time, but should not be modified				*/
+} snmp_peer_t;
+
+typedef struct
+{
+   snmp_peer_t *peer;				/* the agent that was queried										*/
+   int status;						/* SNMP_SUCCESS, or SNMP_ERROR (see abz_get_error())				*/
+   int32_t ErrorStatus;				/* error status returned by the agent (e.g. noSuchName)				*/
+   int32_t ErrorIndex;				/* index of the variable binding that caused the error				*/
+   snmp_next_value_t *next;			/* the variable bindings in the response							*/
+   size_t n;						/* the number of variable bindings									*/
+} snmp_response_t;
+
+typedef struct snmp_session snmp_session_t;
+
+/*
+ * Called once for every request, either when the response arrives
+ * or when the request failed (e.g. after the last retransmission
+ * timed out). The variable bindings are decoded into an arena that
+ * is reset when the callback returns, so the callback should copy
+ * whatever it wants to keep.
+ * New requests may be sent from within the callback.
+ */
+typedef void (*snmp_callback_t) (snmp_session_t *session,const snmp_response_t *response,void *arg);
+
+struct snmp_request;
+
+struct snmp_session
+{
+   int fd;
+   int flags;
+   uint32_t timeout;				/* initial retransmission timeout (milliseconds)					*/
+   uint32_t timeout_min;			/* lower bound of the retransmission timeout (milliseconds)			*/
+   uint32_t timeout_max;			/* upper bound of the retransmission timeout (milliseconds)			*/
+   uint32_t retries;				/* number of retransmissions before giving up						*/
+   uint32_t seed;					/* retransmission jitter											*/
+   int32_t RequestID;				/* request id of the last request sent								*/
+   struct snmp_request **bucket;	/* requests in flight, hashed by request id							*/
+   uint32_t mask;
+   struct snmp_request **wheel;		/* retransmission timers											*/
+   uint64_t tick;					/* last timer wheel tick that was processed							*/
+   size_t pending;					/* number of requests in flight										*/
+   snmp_arena_t arena;				/* variable bindings of the response being dispatched				*/
+   uint8_t data[UDP_DATAGRAM_SIZE];
+};
+
+/*
+ * Initialize peer structure. The version defaults to SNMPv1.
+ *
+ *     peer         agent address and credentials
+ */
+extern void snmp_peer_init (snmp_peer_t *peer);
+
+/*
+ * Set address/port of peer.
+ *
+ *     peer         agent address and credentials
+ *     host         string in the form <hostname>[:<service>]
+ *
+ * Returns 0 if successful, -1 if some error occurred. The
+ * caller may retrieve the error message with abz_get_error().
+ */
+extern int snmp_peer_addr (snmp_peer_t *peer,char *host);
+
+/*
+ * Initialize community of peer.
+ *
+ *     peer         agent address and credentials
+ *     string       community string used for authentication
+ *
+ * The string parameter must remain valid for as long as the
+ * peer is in use as it contains a pointer to string.
+ */
+extern void snmp_peer_community (snmp_peer_t *peer,char *string);
+
+/*
+ * Create a session and its socket.
+ *
+ *     session      manager session
+ *     n            number of requests expected to be in flight
+ *
+ * Returns 0 if successful, -1 if some error occurred. The caller
+ * may retrieve the error message with abz_get_error().
+ *
+ * The timeout and retries fields may be changed after the
+ * session was opened. They apply to requests sent afterwards.
+ *
+ * Agents that have not responded yet are given timeout
+ * milliseconds (1 second by default) to respond. After that the
+ * timeout of each agent is derived from its round-trip time,
+ * bounded by timeout_min and timeout_max. Every retransmission
+ * doubles the timeout of the request, plus a random jitter of up
+ * to a quarter so that requests which timed out together don't
+ * stay synchronized.
+ */
+extern int snmp_session_open (snmp_session_t *session,size_t n);
+
+/*
+ * Close the socket and free all resources allocated by the session.
+ * Requests still in flight are discarded without calling their
+ * callbacks. This function may not be called from a callback.
+ *
+ *     session      manager session
+ */
+extern void snmp_session_close (snmp_session_t *session);
+
+/*
+ * Send a GetRequest to an agent.
+ *
+ *     session      manager session
+ *     peer         agent address and credentials
+ *     oid          array of ObjectID's to retrieve
+ *     n            number of ObjectID's in list
+ *     callback     function called with the result
+ *     arg          passed to the callback
+ *
+ * Returns 0 if successful, -1 if some error occurred. The caller
+ * may retrieve the error message with abz_get_error(). The callback
+ * is only ever called if this function succeeded.
+ *
+ * The ObjectID's are encoded before this function returns, but
+ * the peer must remain valid until the callback is called.
+ */
+extern int snmp_session_get (snmp_session_t *session,snmp_peer_t *peer,uint32_t **oid,size_t n,snmp_callback_t callback,void *arg);
+
+/*
+ * Send a GetNextRequest to an agent. Parameters and return value
+ * are the same as for snmp_session_get().
+ */
+extern int snmp_session_get_next (snmp_session_t *session,snmp_peer_t *peer,uint32_t **oid,size_t n,snmp_callback_t callback,void *arg);
+
+/*
+ * Send a GetBulkRequest to an SNMPv2c agent.
+ *
+ *     session          manager session
+ *     peer             agent address and credentials
+ *     oid              array of ObjectID's to send to agent
+ *     n                number of ObjectID's in list
+ *     NonRepeaters     number of ObjectID's (at the start of the list)
+ *                      for which only the successor is retrieved
+ *     MaxRepetitions   number of successors to retrieve for the others
+ *     callback         function called with the result
+ *     arg              passed to the callback
+ *
+ * Returns 0 if successful, -1 if some error occurred. The caller
+ * may retrieve the error message with abz_get_error().
+ *
+ * The variable bindings in the response are ordered as described
+ * in RFC 3416: first the successors of the non-repeaters, then the
+ * successors of the other ObjectID's, interleaved one repetition
+ * at a time. The agent may return fewer repetitions than asked for.
+ */
+extern int snmp_session_get_bulk (snmp_session_t *session,snmp_peer_t *peer,uint32_t **oid,size_t n,
+								  uint32_t NonRepeaters,uint32_t MaxRepetitions,snmp_callback_t callback,void *arg);
+
+/*
+ * Get the file descriptor of the session socket. The caller should
+ * call snmp_session_process() when it becomes readable.
+ *
+ *     session      manager session
+ */
+extern int snmp_session_fd (const snmp_session_t *session);
+
+/*
+ * Calculate how long the caller may wait for the socket to become
+ * readable before it should call snmp_session_process() anyway.
+ *
+ *     session      manager session
+ *     tv           the time to wait
+ *
+ * Returns the number of requests in flight. If there are none, tv
+ * is left untouched.
+ */
+extern size_t snmp_session_timeout (snmp_session_t *session,struct timeval *tv);
+
+/*
+ * Read all responses waiting on the socket, retransmit requests
+ * that timed out, and call the callbacks of requests that completed.
+ *
+ *     session      manager session
+ *
+ * Returns 0 if successful, -1 if some error occurred. The caller
+ * may retrieve the error message with abz_get_error().
+ */
+extern int snmp_session_process (snmp_session_t *session);
+
+/*
+ * Wait for all requests in flight (including those sent from
+ * callbacks) to complete.
+ *
+ *     session      manager session
+ *
+ * Returns 0 if successful, -1 if some error occurred. The caller
+ * may retrieve the error message with abz_get_error().
+ */
+extern int snmp_session_run (snmp_session_t *session);
+
+#endif	/* #ifndef _MANAGER_SESSION_H */
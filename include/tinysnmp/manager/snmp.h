@@ -34,6 +34,7 @@
 #include <netinet/in.h>
 
 #include <tinysnmp/tinysnmp.h>
+#include <tinysnmp/manager/arena.h>
 #include <ber/ber.h>
 
 /* maximum UDP datagram size */
@@ -48,6 +49,7 @@ typedef struct
    int state;
    int fd;
    int flags;
+   snmp_arena_t *arena;
    uint8_t data[UDP_DATAGRAM_SIZE];
 } snmp_agent_t;
 
@@ -95,6 +97,24 @@ extern int snmp_init_addr (snmp_agent_t *agent,char *host);
  */
 extern void snmp_init_community (snmp_agent_t *agent,char *string);
 
+/*
+ * Decode responses into an arena instead of allocating memory for
+ * every string and object identifier.
+ *
+ *     agent        snmp agent info
+ *     arena        memory arena, or NULL to allocate memory as usual
+ *
+ * While an arena is set, the values returned by snmp_get() and
+ * snmp_get_next() remain valid until the arena is reset or destroyed,
+ * and must not be freed with snmp_free() or snmp_free_next(). Resetting
+ * the arena after every request means no memory is allocated once the
+ * arena has grown large enough to hold the largest response.
+ *
+ * The agent structure must be initialized with snmp_init()
+ * before calling this function.
+ */
+extern void snmp_init_arena (snmp_agent_t *agent,snmp_arena_t *arena);
+
 /*
  * Free resources allocated by snmp_open() function.
  *
@@ -132,7 +152,8 @@ extern int snmp_open (snmp_agent_t *agent);
 extern int snmp_open_s (snmp_agent_t *agent,time_t timeout);
 
 /*
- * Free memory allocated by snmp_get() function.
+ * Free memory allocated by snmp_get() function. Values decoded into
+ * an arena (see snmp_init_arena()) must not be freed.
  *
  *     value        array of snmp values
  *     n            number of values in array
@@ -222,7 +243,8 @@ extern int snmp_get_next (snmp_agent_t *agent,uint32_t **oid,snmp_next_value_t *
 extern int snmp_get_next_s (snmp_agent_t *agent,uint32_t **oid,snmp_next_value_t *next,size_t n,time_t timeout);
 
 /*
- * Free memory allocated by snmp_get_next() function.
+ * Free memory allocated by snmp_get_next() function. Values decoded
+ * into an arena (see snmp_init_arena()) must not be freed.
  *
  *     value        array of snmp next value/oid pairs
  *     n            number of next value/oid pairs in array
@@ -0,0 +1,123 @@
+#ifndef _MANAGER_TABLE_H
+#define _MANAGER_TABLE_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <tinysnmp/tinysnmp.h>
+#include <tinysnmp/manager/session.h>
+
+/*
+ * Retrieve several columns of a conceptual table (e.g. ifXTable) at
+ * once. Every request carries one variable binding per column that
+ * hasn't been exhausted yet, so the columns are walked in lockstep
+ * (with GetBulkRequests for SNMPv2c agents). The instances are then
+ * assembled into rows by their index.
+ *
+ * The result is stored column by column: value[c][r] is the value of
+ * column c in row r, and index[r] is the index of row r (the object
+ * identifier arcs following the column). Rows are sorted by index. If
+ * a column has no instance for the index of a row, the value type is
+ * SNMP_HOLE.
+ */
+
+/* value type of missing table cells */
+#define SNMP_HOLE	0
+
+typedef struct snmp_rows snmp_rows_t;
+
+struct snmp_column;
+
+struct snmp_rows
+{
+   /* parameters */
+   uint32_t repetitions;			/* max-repetitions of GetBulkRequests (0 to always use GetNext)		*/
+   void (*done) (snmp_rows_t *rows,int status);
+   void *arg;						/* for use by the caller											*/
+
+   /* results */
+   size_t ncolumns;					/* number of columns												*/
+   size_t nrows;					/* number of rows													*/
+   uint32_t **index;				/* index of each row												*/
+   snmp_value_t **value;			/* value of each cell, by column									*/
+   size_t holes;					/* number of missing cells											*/
+
+   /* private */
+   snmp_session_t *session;
+   snmp_peer_t *peer;
+   struct snmp_column *column;
+   size_t *active;
+   uint32_t **oid;
+   size_t nactive;
+   int status;
+   char error[256];
+};
+
+/*
+ * Initialize rows structure.
+ *
+ *     rows         table parameters and results
+ *
+ * The caller should set the done callback before calling
+ * snmp_session_table(). done() is called exactly once when all the
+ * columns were retrieved or some error occurred. status is 0 if the
+ * table was retrieved, -1 if some error occurred, in which case
+ * the error message may be retrieved with abz_get_error() and no
+ * results are available.
+ */
+extern void snmp_rows_init (snmp_rows_t *rows);
+
+/*
+ * Start retrieving columns of a table.
+ *
+ *     session      manager session
+ *     rows         table parameters and results
+ *     peer         agent address and credentials
+ *     column       array of column ObjectID's (e.g. ifDescr, ifType)
+ *     n            number of columns in list
+ *
+ * Returns 0 if successful, -1 if some error occurred. The caller
+ * may retrieve the error message with abz_get_error(). done() is
+ * only ever called if this function succeeded.
+ *
+ * The rows and the peer must remain valid until done() is called.
+ * The column ObjectID's are copied.
+ */
+extern int snmp_session_table (snmp_session_t *session,snmp_rows_t *rows,snmp_peer_t *peer,uint32_t **column,size_t n);
+
+/*
+ * Free the results of a table.
+ *
+ *     rows         table parameters and results
+ */
+extern void snmp_rows_free (snmp_rows_t *rows);
+
+#endif	/* #ifndef _MANAGER_TABLE_H */
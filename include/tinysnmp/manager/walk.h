@@ -0,0 +1,115 @@
+#ifndef _MANAGER_WALK_H
+#define _MANAGER_WALK_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <tinysnmp/tinysnmp.h>
+#include <tinysnmp/manager/session.h>
+
+/*
+ * A walk retrieves all the objects in a subtree of an agent. The
+ * subtree is divided into segments which are walked concurrently,
+ * each with at most one request in flight. Without split points,
+ * a segment is split at the second level below the root whenever
+ * there is room in the window, so that walking a table retrieves
+ * its columns in parallel. Known index boundaries can be passed in
+ * as split points to walk a single large column in parallel as well.
+ *
+ * SNMPv2c agents are walked with GetBulkRequests (falling back to
+ * GetNextRequests if the agent refuses them), SNMPv1 agents with
+ * GetNextRequests.
+ */
+
+typedef struct snmp_walk snmp_walk_t;
+
+struct snmp_segment;
+
+struct snmp_walk
+{
+   uint32_t window;					/* maximum number of requests in flight (1 by default)				*/
+   uint32_t repetitions;			/* max-repetitions of GetBulkRequests (0 to always use GetNext)		*/
+   uint32_t **split;				/* known boundaries in the subtree (optional)						*/
+   size_t n;						/* number of boundaries												*/
+   int (*found) (snmp_walk_t *walk,const snmp_next_value_t *next);
+   void (*done) (snmp_walk_t *walk,int status);
+   void *arg;						/* for use by the caller											*/
+
+   /* private */
+   snmp_session_t *session;
+   snmp_peer_t *peer;
+   uint32_t *root;
+   struct snmp_segment *segment;
+   uint32_t outstanding;
+   int status;
+   char error[256];
+};
+
+/*
+ * Initialize walk structure.
+ *
+ *     walk         walk parameters and state
+ *
+ * The caller should set the found and done callbacks (and any
+ * other parameters) before calling snmp_session_walk().
+ *
+ * found() is called for every object in the subtree. Objects are
+ * passed in lexicographical order within each segment, but objects
+ * of different segments are interleaved (unless the window is 1).
+ * If found() returns nonzero, the walk is stopped. The value is
+ * only valid for the duration of the call.
+ *
+ * done() is called exactly once when the walk finished, was stopped,
+ * or failed. status is 0 if the walk was successful, -1 if some error
+ * occurred, in which case the error message may be retrieved with
+ * abz_get_error(). The walk structure may be freed or reused from
+ * within done().
+ */
+extern void snmp_walk_init (snmp_walk_t *walk);
+
+/*
+ * Start walking a subtree.
+ *
+ *     session      manager session
+ *     walk         walk parameters and state
+ *     peer         agent address and credentials
+ *     oid          root of the subtree
+ *
+ * Returns 0 if successful, -1 if some error occurred. The caller
+ * may retrieve the error message with abz_get_error(). done() is
+ * only ever called if this function succeeded.
+ *
+ * The walk and the peer must remain valid until done() is called.
+ * The root and the split points are copied.
+ */
+extern int snmp_session_walk (snmp_session_t *session,snmp_walk_t *walk,snmp_peer_t *peer,const uint32_t *oid);
+
+#endif	/* #ifndef _MANAGER_WALK_H */
@@ -33,15 +33,51 @@
 #include <ber/ber.h>
 
 #define SNMP_VERSION_1	0
+#define SNMP_VERSION_2C	1
+
+/* error status values (RFC 1157, RFC 3416) */
+enum
+{
+   noError				= 0,
+   tooBig				= 1,
+   noSuchName			= 2,
+   badValue				= 3,
+   readOnly				= 4,
+   genErr				= 5,
+   noAccess				= 6,
+   wrongType			= 7,
+   wrongLength			= 8,
+   wrongEncoding		= 9,
+   wrongValue			= 10,
+   noCreation			= 11,
+   inconsistentValue	= 12,
+   resourceUnavailable	= 13,
+   commitFailed			= 14,
+   undoFailed			= 15,
+   authorizationError	= 16,
+   notWritable			= 17,
+   inconsistentName		= 18
+};
+
+/* SNMPv2 exceptions (RFC 3416), reported in place of a value */
+enum
+{
+   noSuchObject			= 0x80,
+   noSuchInstance		= 0x81,
+   endOfMibView			= 0x82
+};
 
 typedef struct
 {
-   uint8_t type;					/* PDU type (either BER_GetRequest, BER_GetResponse, or BER_GetNextRequest)	*/
+   uint8_t type;					/* PDU type (e.g. BER_GetRequest, BER_GetResponse, or BER_GetNextRequest)	*/
    int32_t version;					/* what SNMP version we should use											*/
    octet_string_t community;		/* the SNMP community string												*/
    int32_t RequestID;				/* Request ID used to ensure we got the right packet from the agent			*/
    uint32_t **oid;					/* a list of object identifiers to retrieve from agent						*/
    uint32_t n;						/* the number of object identifiers in the list								*/
+   uint32_t NonRepeaters;			/* GetBulkRequest: number of object identifiers retrieved only once			*/
+   uint32_t MaxRepetitions;			/* GetBulkRequest: number of successors retrieved for the others			*/
+   struct snmp_value *value;		/* SetRequest: the values to assign to the object identifiers				*/
 } snmp_pdu_t;
 
 typedef union
@@ -56,7 +92,7 @@ typedef union
    octet_string_t OCTET_STRING;
 } snmp_data_t;
 
-typedef struct
+typedef struct snmp_value
 {
    uint8_t type;
    snmp_data_t data;
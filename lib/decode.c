@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <ber/ber.h>
+#include <abz/error.h>
+
+#include "decode.h"
+
+int snmp_ber_decode_header (ber_t *ber,uint8_t type,uint32_t *len)
+{
+   uint32_t n;
+
+   if (ber->size - ber->offset < 2 || ber->buf[ber->offset] != type)
+	 {
+		abz_set_error ("expected type 0x%02x at offset %u",type,ber->offset);
+		return (-1);
+	 }
+
+   *len = ber->buf[ber->offset + 1];
+   ber->offset += 2;
+
+   if (*len & 0x80)
+	 {
+		n = *len & 0x7f;
+
+		if (!n || n > sizeof (uint32_t) || n > ber->size - ber->offset)
+		  {
+			 abz_set_error ("invalid length at offset %u",ber->offset);
+			 return (-1);
+		  }
+
+		for (*len = 0; n; n--)
+		  *len = (*len << 8) | ber->buf[ber->offset++];
+	 }
+
+   if (*len > ber->size - ber->offset)
+	 {
+		abz_set_error ("length (%u) exceeds packet size",*len);
+		return (-1);
+	 }
+
+   return (0);
+}
+
+int snmp_ber_decode_octet_string_view (octet_string_t *str,ber_t *ber)
+{
+   if (snmp_ber_decode_header (ber,BER_OCTET_STRING,&str->len))
+	 return (-1);
+
+   str->buf = str->len ? ber->buf + ber->offset : NULL;
+   ber->offset += str->len;
+
+   return (0);
+}
+
+int snmp_ber_decode_octet_string (octet_string_t *str,ber_t *ber,snmp_ber_alloc_t alloc,void *arena)
+{
+   octet_string_t tmp;
+
+   if (snmp_ber_decode_octet_string_view (&tmp,ber))
+	 return (-1);
+
+   str->len = tmp.len;
+   str->buf = NULL;
+
+   if (str->len)
+	 {
+		if ((str->buf = alloc (arena,str->len)) == NULL)
+		  return (-1);
+
+		memcpy (str->buf,tmp.buf,str->len);
+	 }
+
+   return (0);
+}
+
+int snmp_ber_decode_oid (uint32_t **oid,ber_t *ber,snmp_ber_alloc_t alloc,void *arena)
+{
+   uint32_t i,n,len,*tmp;
+   const uint8_t *p;
+
+   if (snmp_ber_decode_header (ber,BER_OID,&len))
+	 return (-1);
+
+   p = ber->buf + ber->offset;
+
+   if (!len || (p[len - 1] & 0x80))
+	 {
+		abz_set_error ("invalid OBJECT IDENTIFIER at offset %u",ber->offset);
+		return (-1);
+	 }
+
+   /* the last byte of every sub-identifier has the high bit clear */
+   for (n = 0, i = 0; i < len; i++)
+	 if (!(p[i] & 0x80))
+	   n++;
+
+   if ((tmp = alloc (arena,(n + 1) * sizeof (uint32_t))) == NULL)
+	 return (-1);
+
+   for (tmp[0] = n, i = 1; i <= n; i++)
+	 {
+		for (tmp[i] = 0; *p & 0x80; p++)
+		  {
+			 if (tmp[i] & 0xfe000000)
+			   {
+				  abz_set_error ("sub-identifier %u of OBJECT IDENTIFIER too large",i);
+				  return (-1);
+			   }
+
+			 tmp[i] = (tmp[i] << 7) | (*p & 0x7f);
+		  }
+
+		if (tmp[i] & 0xfe000000)
+		  {
+			 abz_set_error ("sub-identifier %u of OBJECT IDENTIFIER too large",i);
+			 return (-1);
+		  }
+
+		tmp[i] = (tmp[i] << 7) | *p++;
+	 }
+
+   ber->offset += len;
+   *oid = tmp;
+
+   return (0);
+}
@@ -0,0 +1,76 @@
+#ifndef DECODE_H
+#define DECODE_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ber/ber.h>
+
+/*
+ * libber allocates memory for every ObjectID and octet string it
+ * decodes. The decoders below are used by both the agent and the
+ * manager library to decode into memory handed out by an arena
+ * instead. Each of them allocates memory with alloc (arena,size),
+ * which should return NULL and set the error message if it fails.
+ */
+typedef void *(*snmp_ber_alloc_t) (void *arena,size_t size);
+
+/*
+ * Decode the type and length of the next value, which should be of
+ * the specified type. On success, the offset points to the contents
+ * of the value. Returns 0 if successful, -1 if some error occurred.
+ * Call abz_get_error() to retrieve the error message.
+ */
+extern int snmp_ber_decode_header (ber_t *ber,uint8_t type,uint32_t *len);
+
+/*
+ * Decode an OCTET STRING without copying it. The string points
+ * into the packet and is only valid as long as the packet is.
+ * Returns 0 if successful, -1 if some error occurred. Call
+ * abz_get_error() to retrieve the error message.
+ */
+extern int snmp_ber_decode_octet_string_view (octet_string_t *str,ber_t *ber);
+
+/*
+ * Decode an OCTET STRING into the arena. Returns 0 if successful,
+ * -1 if some error occurred. Call abz_get_error() to retrieve the
+ * error message.
+ */
+extern int snmp_ber_decode_octet_string (octet_string_t *str,ber_t *ber,snmp_ber_alloc_t alloc,void *arena);
+
+/*
+ * Decode an OBJECT IDENTIFIER into the arena. Returns 0 if
+ * successful, -1 if some error occurred. Call abz_get_error() to
+ * retrieve the error message.
+ */
+extern int snmp_ber_decode_oid (uint32_t **oid,ber_t *ber,snmp_ber_alloc_t alloc,void *arena);
+
+#endif	/* #ifndef DECODE_H */
@@ -0,0 +1,67 @@
+#ifndef OIDCMP_H
+#define OIDCMP_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+
+/*
+ * Compare two ObjectID's lexicographically. Returns an integer less
+ * than, equal to, or greater than zero if a is found to be less than,
+ * to match, or to be greater than b.
+ */
+static __inline__ int oidcmp (const uint32_t *a,const uint32_t *b)
+{
+   uint32_t i,n = a[0] < b[0] ? a[0] : b[0];
+
+   for (i = 1; i <= n; i++)
+	 if (a[i] != b[i])
+	   return (a[i] < b[i] ? -1 : 1);
+
+   return (a[0] < b[0] ? -1 : a[0] > b[0]);
+}
+
+/*
+ * Returns 1 if base is a prefix of (or equal to) oid, 0 otherwise.
+ */
+static __inline__ int oidsub (const uint32_t *base,const uint32_t *oid)
+{
+   uint32_t i;
+
+   if (base[0] > oid[0])
+	 return (0);
+
+   for (i = 1; i <= base[0]; i++)
+	 if (base[i] != oid[i])
+	   return (0);
+
+   return (1);
+}
+
+#endif	/* #ifndef OIDCMP_H */
@@ -0,0 +1,77 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <abz/error.h>
+#include <abz/atoa.h>
+#include <abz/atop.h>
+
+#include "addr.h"
+
+int manager_addr_parse (struct sockaddr_in *addr,char *host)
+{
+   char *port = NULL;
+
+   abz_clear_error ();
+
+   memset (addr,0L,sizeof (struct sockaddr_in));
+   addr->sin_family = PF_INET;
+
+   if ((port = strchr (host,':')) != NULL)
+	 *port++ = '\0';
+
+   if (atoa (&addr->sin_addr.s_addr,host))
+	 {
+		abz_set_error ("invalid hostname: %s",host);
+		return (-1);
+	 }
+
+   if (port != NULL)
+	 {
+		if (atop (&addr->sin_port,port))
+		  {
+			 abz_set_error ("invalid service/port: %s",port);
+			 return (-1);
+		  }
+
+		*--port = ':';
+	 }
+   else
+	 {
+#ifdef GETSERVBYNAME
+		if (atop (&addr->sin_port,"snmp"))
+#endif	/* #ifdef GETSERVBYNAME */
+		  addr->sin_port = htons (161);
+	 }
+
+   return (0);
+}
@@ -0,0 +1,130 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <abz/error.h>
+#include <debug/memory.h>
+
+#include <tinysnmp/manager/arena.h>
+
+/* default size of arena blocks (excluding the block header) */
+#define ARENA_BLOCK 16384
+
+/* alignment of memory returned by snmp_arena_alloc() */
+#define ARENA_ALIGN sizeof (uint64_t)
+
+#define ALIGN(x) (((x) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+struct snmp_arena_block
+{
+   struct snmp_arena_block *next;
+   size_t size;
+   size_t used;
+};
+
+/* offset of the first usable byte in a block */
+#define BLOCK_HEADER ALIGN (sizeof (struct snmp_arena_block))
+
+void snmp_arena_init (snmp_arena_t *arena)
+{
+   arena->block = arena->current = NULL;
+   arena->used = arena->size = 0;
+}
+
+void snmp_arena_destroy (snmp_arena_t *arena)
+{
+   struct snmp_arena_block *block;
+
+   while ((block = arena->block) != NULL)
+	 {
+		arena->block = block->next;
+		mem_free (block);
+	 }
+
+   snmp_arena_init (arena);
+}
+
+void *snmp_arena_alloc (snmp_arena_t *arena,size_t size)
+{
+   struct snmp_arena_block *block,*last = NULL;
+   void *ptr;
+
+   size = ALIGN (size);
+
+   /*
+	* blocks left over from before the last reset are reused in
+	* order. the tail of a block which is too small is wasted
+	*/
+
+   for (block = arena->current; block != NULL; last = block, block = block->next)
+	 if (block->size - block->used >= size)
+	   break;
+
+   if (block == NULL)
+	 {
+		size_t n = size > ARENA_BLOCK ? size : ARENA_BLOCK;
+
+		if ((block = mem_alloc (BLOCK_HEADER + n)) == NULL)
+		  {
+			 abz_set_error ("failed to allocate memory: %m");
+			 return (NULL);
+		  }
+
+		block->next = NULL;
+		block->size = n;
+		block->used = 0;
+
+		if (last != NULL)
+		  last->next = block;
+		else
+		  arena->block = block;
+
+		arena->size += n;
+	 }
+
+   ptr = (uint8_t *) block + BLOCK_HEADER + block->used;
+   block->used += size;
+   arena->current = block;
+   arena->used += size;
+
+   return (ptr);
+}
+
+void snmp_arena_reset (snmp_arena_t *arena)
+{
+   struct snmp_arena_block *block;
+
+   for (block = arena->block; block != NULL; block = block->next)
+	 block->used = 0;
+
+   arena->current = arena->block;
+   arena->used = 0;
+}
@@ -0,0 +1,71 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <debug/memory.h>
+
+#include <abz/error.h>
+
+#include "oid.h"
+
+uint32_t *manager_oid_dup (const uint32_t *oid)
+{
+   uint32_t *tmp;
+
+   if ((tmp = mem_alloc ((oid[0] + 1) * sizeof (uint32_t))) == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		return (NULL);
+	 }
+
+   return (memcpy (tmp,oid,(oid[0] + 1) * sizeof (uint32_t)));
+}
+
+int manager_oid_copy (uint32_t **dst,uint32_t *size,const uint32_t *src)
+{
+   uint32_t *tmp;
+
+   if (src[0] > *size)
+	 {
+		if ((tmp = mem_realloc (*dst,(src[0] + 1) * sizeof (uint32_t))) == NULL)
+		  {
+			 abz_set_error ("failed to allocate memory: %m");
+			 return (-1);
+		  }
+
+		*dst = tmp;
+		*size = src[0];
+	 }
+
+   memcpy (*dst,src,(src[0] + 1) * sizeof (uint32_t));
+
+   return (0);
+}
@@ -33,12 +33,14 @@
 
 #include <tinysnmp/tinysnmp.h>
 #include <tinysnmp/manager/snmp.h>
+#include <tinysnmp/manager/arena.h>
 
 #include <ber/ber.h>
 #include <abz/error.h>
 #include <debug/memory.h>
 
 #include "pdu.h"
+#include "decode.h"
 
 int pdu_encode (ber_t *ber,const snmp_pdu_t *pdu)
 {
@@ -62,14 +64,14 @@ int pdu_encode (ber_t *ber,const snmp_pdu_t *pdu)
 
    /*
 	* VarBindList ::= SEQUENCE OF
-	* ErrorIndex INTEGER
-	* ErrorStatus INTEGER { noError(0) }
+	* ErrorIndex INTEGER (max-repetitions for GetBulkRequest-PDU)
+	* ErrorStatus INTEGER { noError(0) } (non-repeaters for GetBulkRequest-PDU)
 	* Request-ID INTEGER
 	*/
 
    if (ber_encode_sequence (ber,ber->offset) ||
-	   ber_encode_integer (ber,0) ||
-	   ber_encode_integer (ber,0) ||
+	   ber_encode_integer (ber,pdu->type == BER_GetBulkRequest ? pdu->MaxRepetitions : 0) ||
+	   ber_encode_integer (ber,pdu->type == BER_GetBulkRequest ? pdu->NonRepeaters : 0) ||
 	   ber_encode_integer (ber,pdu->RequestID))
 	 return (-1);
 
@@ -83,6 +85,15 @@ int pdu_encode (ber_t *ber,const snmp_pdu_t *pdu)
 		if (ber_encode_get_next_request (ber))
 		  return (-1);
 		break;
+	  case BER_GetBulkRequest:
+		/*
+		 * libber doesn't know about GetBulkRequest-PDU, but apart
+		 * from the tag, it is encoded just like GetRequest-PDU
+		 */
+		if (ber_encode_get_request (ber))
+		  return (-1);
+		ber->buf[ber->size - ber->offset] = BER_GetBulkRequest;
+		break;
 	  default:
 		abz_set_error ("unsupported pdu: 0x%02x",pdu->type);
 		return (-1);
@@ -113,6 +124,30 @@ static int octet_string_compare (const octet_string_t *a,const octet_string_t *b
    return (memcmp (a->buf,b->buf,a->len));
 }
 
+static void *pdu_alloc (void *arena,size_t size)
+{
+   return (snmp_arena_alloc (arena,size));
+}
+
+/*
+ * Without an arena, strings and object identifiers are allocated by
+ * libber and have to be freed by the caller. With an arena, they are
+ * decoded into the arena and freed by resetting it.
+ */
+static int pdu_decode_octet_string (octet_string_t *str,ber_t *ber,snmp_arena_t *arena)
+{
+   return (arena != NULL ?
+		   snmp_ber_decode_octet_string (str,ber,pdu_alloc,arena) :
+		   ber_decode_octet_string (str,ber));
+}
+
+static int pdu_decode_oid (uint32_t **oid,ber_t *ber,snmp_arena_t *arena)
+{
+   return (arena != NULL ?
+		   snmp_ber_decode_oid (oid,ber,pdu_alloc,arena) :
+		   ber_decode_oid (oid,ber));
+}
+
 static int decode_response_prefix (ber_t *ber,const snmp_pdu_t *pdu)
 {
    int32_t version,RequestID,ErrorStatus,ErrorIndex;
@@ -131,21 +166,13 @@ static int decode_response_prefix (ber_t *ber,const snmp_pdu_t *pdu)
 
    if (ber_decode_sequence (ber) ||
 	   ber_decode_integer (&version,ber) ||
-	   ber_decode_octet_string (&community,ber) ||
+	   snmp_ber_decode_octet_string_view (&community,ber) ||
 	   ber_decode_get_response (ber) ||
 	   ber_decode_integer (&RequestID,ber) ||
 	   ber_decode_integer (&ErrorStatus,ber) ||
 	   ber_decode_integer (&ErrorIndex,ber) ||
 	   ber_decode_sequence (ber))
-	 {
-		if (community.len)
-		  mem_free (community.buf);
-
-		return (-1);
-	 }
-
-   if (community.len)
-	 mem_free (community.buf);
+	 return (-1);
 
    if (version != pdu->version)
 	 {
@@ -168,7 +195,25 @@ static int decode_response_prefix (ber_t *ber,const snmp_pdu_t *pdu)
    return (0);
 }
 
-static int decode_oid_sequence (snmp_next_value_t *seq,ber_t *ber)
+static int decode_exception (ber_t *ber)
+{
+   /*
+	* noSuchObject, noSuchInstance, and endOfMibView are all
+	* encoded as an implicit NULL
+	*/
+
+   if (ber->offset + 2 > ber->size || ber->buf[ber->offset + 1])
+	 {
+		abz_set_error ("invalid exception encoding");
+		return (-1);
+	 }
+
+   ber->offset += 2;
+
+   return (0);
+}
+
+static int decode_oid_sequence (snmp_next_value_t *seq,ber_t *ber,snmp_arena_t *arena)
 {
    int result;
 
@@ -177,13 +222,16 @@ static int decode_oid_sequence (snmp_next_value_t *seq,ber_t *ber)
 	* name OBJECT IDENTIFIER
 	*/
 
-   if (ber_decode_sequence (ber) || ber_decode_oid (&seq->oid,ber))
+   if (ber_decode_sequence (ber) || pdu_decode_oid (&seq->oid,ber,arena))
 	 return (-1);
 
    if (ber->offset >= ber->size)
 	 {
 		abz_set_error ("buffer offset exceed buffer size");
-		mem_free (seq->oid);
+
+		if (arena == NULL)
+		  mem_free (seq->oid);
+
 		return (-1);
 	 }
 
@@ -215,11 +263,11 @@ static int decode_oid_sequence (snmp_next_value_t *seq,ber_t *ber)
 		break;
 	  case BER_OID:
 		seq->value.type = BER_OID;
-		result = ber_decode_oid (&seq->value.data.OID,ber);
+		result = pdu_decode_oid (&seq->value.data.OID,ber,arena);
 		break;
 	  case BER_OCTET_STRING:
 		seq->value.type = BER_OCTET_STRING;
-		result = ber_decode_octet_string (&seq->value.data.OCTET_STRING,ber);
+		result = pdu_decode_octet_string (&seq->value.data.OCTET_STRING,ber,arena);
 		break;
 	  case BER_NULL:
 		seq->value.type = BER_NULL;
@@ -229,21 +277,28 @@ static int decode_oid_sequence (snmp_next_value_t *seq,ber_t *ber)
 		seq->value.type = BER_IpAddress;
 		result = ber_decode_ipaddress (&seq->value.data.IpAddress,ber);
 		break;
+	  case noSuchObject:
+	  case noSuchInstance:
+	  case endOfMibView:
+		seq->value.type = ber->buf[ber->offset];
+		result = decode_exception (ber);
+		break;
 	  default:
 		abz_set_error ("unsupported ber value: 0x%02x",ber->buf[ber->offset]);
 		result = -1;
 	 }
 
-   if (result)
+   if (result && arena == NULL)
 	 mem_free (seq->oid);
 
    return (result);
 }
 
-int pdu_decode (ber_t *ber,const snmp_pdu_t *pdu,snmp_value_t *value)
+int pdu_decode (ber_t *ber,const snmp_pdu_t *pdu,snmp_value_t *value,snmp_arena_t *arena)
 {
    uint32_t i;
    snmp_next_value_t tmp;
+   int result = 0;
 
    abz_clear_error ();
 
@@ -252,36 +307,43 @@ int pdu_decode (ber_t *ber,const snmp_pdu_t *pdu,snmp_value_t *value)
 
    for (i = 0; i < pdu->n; i++)
 	 {
-		if (decode_oid_sequence (&tmp,ber))
+		if (decode_oid_sequence (&tmp,ber,arena))
 		  {
-			 snmp_free (value,i);
-			 return (-1);
+			 result = -1;
+			 break;
 		  }
 
+		memcpy (value + i,&tmp.value,sizeof (snmp_value_t));
+
 		if (memcmp (tmp.oid,pdu->oid[i],(tmp.oid[0] + 1) * sizeof (uint32_t)))
 		  {
 			 abz_set_error ("object identifier mismatch");
-			 snmp_free (value,i);
-			 mem_free (tmp.oid);
-			 return (-1);
+			 result = -1;
 		  }
 
-		mem_free (tmp.oid);
+		if (arena == NULL)
+		  mem_free (tmp.oid);
 
-		memcpy (value + i,&tmp.value,sizeof (snmp_value_t));
+		if (result)
+		  {
+			 i++;
+			 break;
+		  }
 	 }
 
-   if (ber->offset != ber->size)
+   if (!result && ber->offset != ber->size)
 	 {
 		abz_set_error ("buffer contains garbage at the end");
-		snmp_free (value,pdu->n);
-		return (-1);
+		result = -1;
 	 }
 
-   return (0);
+   if (result && arena == NULL)
+	 snmp_free (value,i);
+
+   return (result);
 }
 
-int pdu_decode_next (ber_t *ber,const snmp_pdu_t *pdu,snmp_next_value_t *next)
+int pdu_decode_next (ber_t *ber,const snmp_pdu_t *pdu,snmp_next_value_t *next,snmp_arena_t *arena)
 {
    uint32_t i;
 
@@ -299,15 +361,14 @@ int pdu_decode_next (ber_t *ber,const snmp_pdu_t *pdu,snmp_next_value_t *next)
    if (ber->offset != ber->size)
 	 {
 		for (i = 0; i < pdu->n; i++)
-		  if (decode_oid_sequence (next + i,ber))
-			{
-			   snmp_free_next (next,i);
-			   return (-1);
-			}
+		  if (decode_oid_sequence (next + i,ber,arena))
+			break;
 
-		if (ber->offset != ber->size)
+		if (i < pdu->n || ber->offset != ber->size)
 		  {
-			 snmp_free_next (next,i);
+			 if (arena == NULL)
+			   snmp_free_next (next,i);
+
 			 return (-1);
 		  }
 	 }
@@ -315,3 +376,80 @@ int pdu_decode_next (ber_t *ber,const snmp_pdu_t *pdu,snmp_next_value_t *next)
    return (0);
 }
 
+int pdu_decode_header (ber_t *ber,snmp_pdu_t *pdu,int32_t *ErrorStatus,int32_t *ErrorIndex)
+{
+   abz_clear_error ();
+
+   if (ber_decode_sequence (ber) ||
+	   ber_decode_integer (&pdu->version,ber) ||
+	   snmp_ber_decode_octet_string_view (&pdu->community,ber) ||
+	   ber_decode_get_response (ber) ||
+	   ber_decode_integer (&pdu->RequestID,ber) ||
+	   ber_decode_integer (ErrorStatus,ber) ||
+	   ber_decode_integer (ErrorIndex,ber) ||
+	   ber_decode_sequence (ber))
+	 return (-1);
+
+   pdu->type = BER_GetResponse;
+
+   return (0);
+}
+
+int pdu_decode_varbinds (ber_t *ber,snmp_next_value_t **next,size_t *n,snmp_arena_t *arena)
+{
+   snmp_next_value_t *tmp = NULL;
+   uint32_t len,offset = ber->offset;
+   size_t i,count = 0;
+
+   /* count the variable bindings first so we only allocate once */
+   while (ber->offset < ber->size)
+	 {
+		if (snmp_ber_decode_header (ber,BER_SEQUENCE,&len))
+		  {
+			 ber->offset = offset;
+			 return (-1);
+		  }
+
+		ber->offset += len;
+		count++;
+	 }
+
+   ber->offset = offset;
+
+   if (count)
+	 {
+		tmp = arena != NULL ?
+		  snmp_arena_alloc (arena,count * sizeof (snmp_next_value_t)) :
+		  mem_alloc (count * sizeof (snmp_next_value_t));
+
+		if (tmp == NULL)
+		  {
+			 if (arena == NULL)
+			   abz_set_error ("failed to allocate memory: %m");
+
+			 return (-1);
+		  }
+	 }
+
+   for (i = 0; i < count; i++)
+	 if (decode_oid_sequence (tmp + i,ber,arena))
+	   break;
+
+   if (i < count)
+	 {
+		if (arena == NULL)
+		  {
+			 if (i)
+			   snmp_free_next (tmp,i);
+
+			 mem_free (tmp);
+		  }
+
+		return (-1);
+	 }
+
+   *next = tmp;
+   *n = count;
+
+   return (0);
+}
@@ -30,10 +30,33 @@
  */
 
 #include <tinysnmp/tinysnmp.h>
+#include <tinysnmp/manager/arena.h>
 #include <ber/ber.h>
 
 extern int pdu_encode (ber_t *ber,const snmp_pdu_t *pdu);
-extern int pdu_decode (ber_t *ber,const snmp_pdu_t *pdu,snmp_value_t *value);
-extern int pdu_decode_next (ber_t *ber,const snmp_pdu_t *pdu,snmp_next_value_t *next);
+
+/*
+ * Decode a GetResponse-PDU. If arena is NULL, strings and object
+ * identifiers in the values are allocated and must be freed with
+ * snmp_free() or snmp_free_next(). Otherwise they are decoded into
+ * the arena and nothing needs to be freed.
+ */
+extern int pdu_decode (ber_t *ber,const snmp_pdu_t *pdu,snmp_value_t *value,snmp_arena_t *arena);
+extern int pdu_decode_next (ber_t *ber,const snmp_pdu_t *pdu,snmp_next_value_t *next,snmp_arena_t *arena);
+
+/*
+ * Decode a GetResponse-PDU up to the start of the variable bindings,
+ * filling in the version, community and request id of pdu. The
+ * community points into the packet, so nothing is allocated.
+ */
+extern int pdu_decode_header (ber_t *ber,snmp_pdu_t *pdu,int32_t *ErrorStatus,int32_t *ErrorIndex);
+
+/*
+ * Decode all the remaining variable bindings. If arena is NULL, the
+ * array is allocated and must be freed with snmp_free_next() and
+ * mem_free() if *n is nonzero. Otherwise everything is decoded into
+ * the arena.
+ */
+extern int pdu_decode_varbinds (ber_t *ber,snmp_next_value_t **next,size_t *n,snmp_arena_t *arena);
 
 #endif	/* #ifndef PDU_H */
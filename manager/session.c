@@ -0,0 +1,686 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <debug/memory.h>
+
+#include <abz/error.h>
+
+#include <tinysnmp/tinysnmp.h>
+#include <tinysnmp/manager/snmp.h>
+#include <tinysnmp/manager/session.h>
+#include <ber/ber.h>
+
+#include "pdu.h"
+#include "addr.h"
+
+/* timer wheel resolution (in milliseconds) and number of slots */
+#define TICK	10
+#define WHEEL	1024
+
+/* socket receive buffer, large enough to absorb a burst of responses */
+#define RCVBUF	(1 << 20)
+
+struct snmp_request
+{
+   struct snmp_request *chain;			/* next request in the same hash bucket		*/
+   struct snmp_request *prev,*next;		/* neighbours in the same timer wheel slot	*/
+   uint64_t expires;					/* tick at which the request times out		*/
+   snmp_peer_t *peer;
+   snmp_callback_t callback;
+   void *arg;
+   int32_t RequestID;
+   uint32_t retries;					/* retransmissions left						*/
+   uint32_t transmissions;
+   uint32_t timeout;					/* timeout of the last transmission			*/
+   uint64_t sent;						/* time of the first transmission			*/
+   size_t length;
+   uint8_t packet[];
+};
+
+void snmp_peer_init (snmp_peer_t *peer)
+{
+   assert (peer != NULL);
+   memset (peer,0L,sizeof (snmp_peer_t));
+   peer->version = SNMP_VERSION_1;
+}
+
+int snmp_peer_addr (snmp_peer_t *peer,char *host)
+{
+   assert (peer != NULL && host != NULL);
+   return (manager_addr_parse (&peer->addr,host));
+}
+
+void snmp_peer_community (snmp_peer_t *peer,char *string)
+{
+   assert (peer != NULL && string != NULL);
+   peer->community.buf = (uint8_t *) string;
+   peer->community.len = strlen (string);
+}
+
+static uint64_t getusec (void)
+{
+   struct timespec ts;
+
+   clock_gettime (CLOCK_MONOTONIC,&ts);
+
+   return ((uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+static uint64_t gettick (void)
+{
+   return (getusec () / (TICK * 1000));
+}
+
+static uint32_t rto_clamp (const snmp_session_t *session,uint32_t rto)
+{
+   if (rto < session->timeout_min)
+	 rto = session->timeout_min;
+
+   if (rto > session->timeout_max)
+	 rto = session->timeout_max;
+
+   return (rto);
+}
+
+static uint32_t rto_initial (const snmp_session_t *session,const snmp_peer_t *peer)
+{
+   return (peer->rtt.rto ? peer->rtt.rto : rto_clamp (session,session->timeout));
+}
+
+/*
+ * Update the round-trip time estimate of the peer with a new
+ * sample (RFC 6298, section 2).
+ */
+static void rto_update (const snmp_session_t *session,snmp_rtt_t *rtt,uint64_t sample)
+{
+   uint32_t rtt_us = sample < 1 ? 1 : sample > UINT32_MAX / 8 ? UINT32_MAX / 8 : sample;
+   uint32_t delta,variance;
+
+   if (!rtt->srtt)
+	 {
+		rtt->srtt = rtt_us;
+		rtt->rttvar = rtt_us / 2;
+	 }
+   else
+	 {
+		delta = rtt->srtt > rtt_us ? rtt->srtt - rtt_us : rtt_us - rtt->srtt;
+		rtt->rttvar = rtt->rttvar - rtt->rttvar / 4 + delta / 4;
+		rtt->srtt = rtt->srtt - rtt->srtt / 8 + rtt_us / 8;
+	 }
+
+   /* the variance can't usefully be smaller than our timer resolution */
+   variance = 4 * rtt->rttvar < TICK * 1000 ? TICK * 1000 : 4 * rtt->rttvar;
+
+   rtt->rto = rto_clamp (session,((uint64_t) rtt->srtt + variance + 999) / 1000);
+}
+
+/*
+ * Double the timeout of a request, and make sure new requests to
+ * the same peer start with at least that timeout until we get a
+ * fresh sample (RFC 6298, section 5).
+ */
+static uint32_t rto_backoff (snmp_session_t *session,struct snmp_request *request)
+{
+   snmp_rtt_t *rtt = &request->peer->rtt;
+   uint32_t jitter;
+
+   request->timeout = rto_clamp (session,request->timeout > UINT32_MAX / 2 ? UINT32_MAX : request->timeout * 2);
+
+   if (rtt->rto < request->timeout)
+	 rtt->rto = request->timeout;
+
+   /* xorshift32 */
+   session->seed ^= session->seed << 13;
+   session->seed ^= session->seed >> 17;
+   session->seed ^= session->seed << 5;
+
+   jitter = session->seed % (request->timeout / 4 + 1);
+
+   return (request->timeout + jitter);
+}
+
+static void timer_add (snmp_session_t *session,struct snmp_request *request,uint32_t timeout)
+{
+   struct snmp_request **slot;
+
+   request->expires = gettick () + (timeout + TICK - 1) / TICK;
+
+   if (request->expires <= session->tick)
+	 request->expires = session->tick + 1;
+
+   slot = session->wheel + (request->expires & (WHEEL - 1));
+
+   request->prev = NULL;
+   if ((request->next = *slot) != NULL)
+	 request->next->prev = request;
+   *slot = request;
+}
+
+static void timer_del (snmp_session_t *session,struct snmp_request *request)
+{
+   if (request->prev != NULL)
+	 request->prev->next = request->next;
+   else
+	 session->wheel[request->expires & (WHEEL - 1)] = request->next;
+
+   if (request->next != NULL)
+	 request->next->prev = request->prev;
+}
+
+static struct snmp_request **request_find (snmp_session_t *session,int32_t RequestID)
+{
+   struct snmp_request **request = session->bucket + (RequestID & session->mask);
+
+   while (*request != NULL && (*request)->RequestID != RequestID)
+	 request = &(*request)->chain;
+
+   return (request);
+}
+
+static int request_send (snmp_session_t *session,const struct snmp_request *request)
+{
+   int result;
+
+   result = sendto (session->fd,
+					request->packet,
+					request->length,
+					session->flags,
+					(const struct sockaddr *) &request->peer->addr,
+					sizeof (struct sockaddr_in));
+
+   /* a full socket buffer just looks like a lost packet */
+   if (result < 0 &&
+	   errno != EAGAIN && errno != EWOULDBLOCK &&
+	   errno != EINTR && errno != ENOBUFS)
+	 {
+		abz_set_error ("sendto: %m");
+		return (-1);
+	 }
+
+   return (0);
+}
+
+/*
+ * Remove the request from the session and hand the result to the
+ * callback. The timer should already have been removed.
+ */
+static void request_done (snmp_session_t *session,struct snmp_request *request,snmp_response_t *response)
+{
+   struct snmp_request **ptr = request_find (session,request->RequestID);
+
+   *ptr = request->chain;
+   session->pending--;
+
+   response->peer = request->peer;
+   request->callback (session,response,request->arg);
+
+   mem_free (request);
+}
+
+static void request_fail (snmp_session_t *session,struct snmp_request *request)
+{
+   snmp_response_t response;
+
+   memset (&response,0L,sizeof (snmp_response_t));
+   response.status = SNMP_ERROR;
+
+   request_done (session,request,&response);
+}
+
+int snmp_session_open (snmp_session_t *session,size_t n)
+{
+   struct timeval tv;
+   int size = RCVBUF;
+
+   assert (session != NULL);
+   abz_clear_error ();
+
+   session->fd = -1;
+   session->flags = 0;
+   session->timeout = 1000;
+   session->timeout_min = 100;
+   session->timeout_max = 30000;
+   session->retries = 3;
+   session->pending = 0;
+   session->tick = gettick ();
+
+   snmp_arena_init (&session->arena);
+
+#ifdef MSG_NOSIGNAL
+   session->flags |= MSG_NOSIGNAL;
+#endif	/* #ifdef MSG_NOSIGNAL */
+
+   session->RequestID = gettimeofday (&tv,NULL) ? 0x13a48f75 : tv.tv_sec ^ tv.tv_usec << 12;
+   session->seed = session->RequestID | 1;
+
+   for (session->mask = 1; session->mask < n; session->mask <<= 1) ;
+   session->mask--;
+
+   session->bucket = mem_alloc ((session->mask + 1) * sizeof (struct snmp_request *));
+   session->wheel = mem_alloc (WHEEL * sizeof (struct snmp_request *));
+
+   if (session->bucket == NULL || session->wheel == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		snmp_session_close (session);
+		return (-1);
+	 }
+
+   memset (session->bucket,0L,(session->mask + 1) * sizeof (struct snmp_request *));
+   memset (session->wheel,0L,WHEEL * sizeof (struct snmp_request *));
+
+   if ((session->fd = socket (PF_INET,SOCK_DGRAM,0)) < 0)
+	 {
+		abz_set_error ("failed to create socket: %m");
+		snmp_session_close (session);
+		return (-1);
+	 }
+
+   if (fcntl (session->fd,F_SETFL,O_NONBLOCK) < 0)
+	 {
+		abz_set_error ("failed to set socket to non-blocking mode: %m");
+		snmp_session_close (session);
+		return (-1);
+	 }
+
+   /* not fatal, we'll just drop more responses */
+   setsockopt (session->fd,SOL_SOCKET,SO_RCVBUF,&size,sizeof (size));
+
+   return (0);
+}
+
+void snmp_session_close (snmp_session_t *session)
+{
+   struct snmp_request *request;
+   uint32_t i;
+
+   assert (session != NULL);
+
+   if (session->bucket != NULL)
+	 {
+		for (i = 0; i <= session->mask; i++)
+		  while ((request = session->bucket[i]) != NULL)
+			{
+			   session->bucket[i] = request->chain;
+			   mem_free (request);
+			}
+
+		mem_free (session->bucket);
+		session->bucket = NULL;
+	 }
+
+   if (session->wheel != NULL)
+	 {
+		mem_free (session->wheel);
+		session->wheel = NULL;
+	 }
+
+   if (session->fd != -1)
+	 {
+		close (session->fd);
+		session->fd = -1;
+	 }
+
+   snmp_arena_destroy (&session->arena);
+
+   session->pending = 0;
+}
+
+static int session_request (snmp_session_t *session,snmp_peer_t *peer,snmp_pdu_t *pdu,snmp_callback_t callback,void *arg)
+{
+   struct snmp_request *request;
+   ber_t ber;
+
+   abz_clear_error ();
+
+   pdu->version = peer->version;
+   pdu->community = peer->community;
+
+   /* skip request ids that are still in flight after wrapping */
+   do
+	 session->RequestID = (session->RequestID + 1) & 0x7fffffff;
+   while (*request_find (session,session->RequestID) != NULL);
+
+   pdu->RequestID = session->RequestID;
+
+   ber.buf = session->data;
+   ber.size = sizeof (session->data);
+   ber.offset = 0;
+
+   if (pdu_encode (&ber,pdu))
+	 return (-1);
+
+   if ((request = mem_alloc (sizeof (struct snmp_request) + ber.offset)) == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		return (-1);
+	 }
+
+   request->peer = peer;
+   request->callback = callback;
+   request->arg = arg;
+   request->RequestID = pdu->RequestID;
+   request->retries = session->retries;
+   request->transmissions = 1;
+   request->timeout = rto_initial (session,peer);
+   request->sent = getusec ();
+   request->length = ber.offset;
+   memcpy (request->packet,ber.buf + ber.size - ber.offset,ber.offset);
+
+   if (request_send (session,request))
+	 {
+		mem_free (request);
+		return (-1);
+	 }
+
+   request->chain = session->bucket[request->RequestID & session->mask];
+   session->bucket[request->RequestID & session->mask] = request;
+   session->pending++;
+   peer->rtt.requests++;
+
+   timer_add (session,request,request->timeout);
+
+   return (0);
+}
+
+int snmp_session_get (snmp_session_t *session,snmp_peer_t *peer,uint32_t **oid,size_t n,snmp_callback_t callback,void *arg)
+{
+   snmp_pdu_t pdu;
+
+   assert (session != NULL && peer != NULL && oid != NULL && n && callback != NULL);
+
+   memset (&pdu,0L,sizeof (snmp_pdu_t));
+   pdu.type = BER_GetRequest;
+   pdu.oid = oid;
+   pdu.n = n;
+
+   return (session_request (session,peer,&pdu,callback,arg));
+}
+
+int snmp_session_get_next (snmp_session_t *session,snmp_peer_t *peer,uint32_t **oid,size_t n,snmp_callback_t callback,void *arg)
+{
+   snmp_pdu_t pdu;
+
+   assert (session != NULL && peer != NULL && oid != NULL && n && callback != NULL);
+
+   memset (&pdu,0L,sizeof (snmp_pdu_t));
+   pdu.type = BER_GetNextRequest;
+   pdu.oid = oid;
+   pdu.n = n;
+
+   return (session_request (session,peer,&pdu,callback,arg));
+}
+
+int snmp_session_get_bulk (snmp_session_t *session,snmp_peer_t *peer,uint32_t **oid,size_t n,
+						   uint32_t NonRepeaters,uint32_t MaxRepetitions,snmp_callback_t callback,void *arg)
+{
+   snmp_pdu_t pdu;
+
+   assert (session != NULL && peer != NULL && oid != NULL && n && callback != NULL);
+
+   if (peer->version == SNMP_VERSION_1)
+	 {
+		abz_set_error ("GetBulkRequest is not supported by SNMPv1 agents");
+		return (-1);
+	 }
+
+   memset (&pdu,0L,sizeof (snmp_pdu_t));
+   pdu.type = BER_GetBulkRequest;
+   pdu.oid = oid;
+   pdu.n = n;
+   pdu.NonRepeaters = NonRepeaters;
+   pdu.MaxRepetitions = MaxRepetitions;
+
+   return (session_request (session,peer,&pdu,callback,arg));
+}
+
+int snmp_session_fd (const snmp_session_t *session)
+{
+   assert (session != NULL);
+   return (session->fd);
+}
+
+size_t snmp_session_timeout (snmp_session_t *session,struct timeval *tv)
+{
+   uint64_t now;
+   uint32_t i;
+
+   assert (session != NULL && tv != NULL);
+
+   if (!session->pending)
+	 return (0);
+
+   /*
+	* wake up at the next occupied slot. it might hold requests that
+	* only expire a few rotations later, but that just costs us an
+	* extra call to snmp_session_process()
+	*/
+
+   now = gettick ();
+
+   for (i = 1; i < WHEEL; i++)
+	 if (session->wheel[(session->tick + i) & (WHEEL - 1)] != NULL)
+	   break;
+
+   if (session->tick + i <= now)
+	 i = 0;
+   else
+	 i = session->tick + i - now;
+
+   tv->tv_sec = i * TICK / 1000;
+   tv->tv_usec = i * TICK % 1000 * 1000;
+
+   return (session->pending);
+}
+
+static void session_dispatch (snmp_session_t *session,ber_t *ber,const struct sockaddr_in *addr)
+{
+   struct snmp_request *request;
+   snmp_response_t response;
+   snmp_pdu_t pdu;
+   int mismatch;
+
+   memset (&response,0L,sizeof (snmp_response_t));
+
+   /* anything we can't make sense of is silently dropped */
+   if (pdu_decode_header (ber,&pdu,&response.ErrorStatus,&response.ErrorIndex))
+	 return;
+
+   request = *request_find (session,pdu.RequestID);
+
+   mismatch = request == NULL ||
+	 addr->sin_addr.s_addr != request->peer->addr.sin_addr.s_addr ||
+	 addr->sin_port != request->peer->addr.sin_port ||
+	 pdu.version != request->peer->version ||
+	 pdu.community.len != request->peer->community.len ||
+	 (pdu.community.len && memcmp (pdu.community.buf,request->peer->community.buf,pdu.community.len));
+
+   if (mismatch)
+	 return;
+
+   timer_del (session,request);
+
+   /* karn's algorithm: we can't tell which transmission was answered */
+   if (request->transmissions == 1)
+	 rto_update (session,&request->peer->rtt,getusec () - request->sent);
+
+   request->peer->rtt.responses++;
+
+   response.status = pdu_decode_varbinds (ber,&response.next,&response.n,&session->arena) ? SNMP_ERROR : SNMP_SUCCESS;
+
+   request_done (session,request,&response);
+
+   snmp_arena_reset (&session->arena);
+}
+
+static int session_receive (snmp_session_t *session)
+{
+   struct sockaddr_in addr;
+   socklen_t addrlen;
+   ber_t ber;
+   int result;
+
+   for (;;)
+	 {
+		addrlen = sizeof (addr);
+
+		result = recvfrom (session->fd,
+						   session->data,
+						   sizeof (session->data),
+						   0,
+						   (struct sockaddr *) &addr,
+						   &addrlen);
+
+		if (result < 0)
+		  {
+			 if (errno == EINTR)
+			   continue;
+
+			 if (errno == EAGAIN || errno == EWOULDBLOCK)
+			   break;
+
+			 abz_set_error ("recvfrom: %m");
+			 return (-1);
+		  }
+
+		if (addr.sin_family != AF_INET)
+		  continue;
+
+		ber.buf = session->data;
+		ber.size = result;
+		ber.offset = 0;
+
+		session_dispatch (session,&ber,&addr);
+	 }
+
+   return (0);
+}
+
+static void session_expire (snmp_session_t *session)
+{
+   struct snmp_request *expired = NULL,*request,*next;
+   uint64_t now = gettick ();
+   uint64_t i,n;
+
+   n = now - session->tick < WHEEL ? now - session->tick : WHEEL;
+
+   /*
+	* unlink everything that expired first, since callbacks are
+	* free to add new timers while we're busy
+	*/
+
+   for (i = 1; i <= n; i++)
+	 for (request = session->wheel[(session->tick + i) & (WHEEL - 1)]; request != NULL; request = next)
+	   {
+		  next = request->next;
+
+		  if (request->expires <= now)
+			{
+			   timer_del (session,request);
+			   request->next = expired;
+			   expired = request;
+			}
+	   }
+
+   session->tick = now;
+
+   while ((request = expired) != NULL)
+	 {
+		expired = request->next;
+
+		if (!request->retries)
+		  {
+			 request->peer->rtt.timeouts++;
+			 abz_set_error ("request timed out");
+			 request_fail (session,request);
+		  }
+		else if (request_send (session,request))
+		  request_fail (session,request);
+		else
+		  {
+			 if (request->transmissions++ == 1)
+			   request->peer->rtt.retransmits++;
+
+			 request->retries--;
+
+			 timer_add (session,request,rto_backoff (session,request));
+		  }
+	 }
+}
+
+int snmp_session_process (snmp_session_t *session)
+{
+   assert (session != NULL);
+   abz_clear_error ();
+
+   if (session_receive (session))
+	 return (-1);
+
+   session_expire (session);
+
+   return (0);
+}
+
+int snmp_session_run (snmp_session_t *session)
+{
+   struct timeval tv;
+   fd_set rfds;
+
+   assert (session != NULL);
+
+   while (snmp_session_timeout (session,&tv))
+	 {
+		FD_ZERO (&rfds);
+		FD_SET (session->fd,&rfds);
+
+		if (select (session->fd + 1,&rfds,NULL,NULL,&tv) < 0 && errno != EINTR)
+		  {
+			 abz_set_error ("select: %m");
+			 return (-1);
+		  }
+
+		if (snmp_session_process (session))
+		  return (-1);
+	 }
+
+   return (0);
+}
@@ -43,14 +43,13 @@
 #include <debug/memory.h>
 
 #include <abz/error.h>
-#include <abz/atoa.h>
-#include <abz/atop.h>
 
 #include <tinysnmp/tinysnmp.h>
 #include <tinysnmp/manager/snmp.h>
 #include <ber/ber.h>
 
 #include "pdu.h"
+#include "addr.h"
 
 void snmp_init (snmp_agent_t *agent)
 {
@@ -71,42 +70,8 @@ void snmp_init (snmp_agent_t *agent)
 
 int snmp_init_addr (snmp_agent_t *agent,char *host)
 {
-   char *port = NULL;
-
    assert (agent != NULL && host != NULL);
-   abz_clear_error ();
-
-   memset (&agent->addr,0L,sizeof (agent->addr));
-   agent->addr.sin_family = PF_INET;
-
-   if ((port = strchr (host,':')) != NULL)
-	 *port++ = '\0';
-
-   if (atoa (&agent->addr.sin_addr.s_addr,host))
-	 {
-		abz_set_error ("invalid hostname: %s",host);
-		return (-1);
-	 }
-
-   if (port != NULL)
-	 {
-		if (atop (&agent->addr.sin_port,port))
-		  {
-			 abz_set_error ("invalid service/port: %s",port);
-			 return (-1);
-		  }
-
-		*--port = ':';
-	 }
-   else
-	 {
-#ifdef GETSERVBYNAME
-		if (atop (&agent->addr.sin_port,"snmp"))
-#endif	/* #ifdef GETSERVBYNAME */
-		  agent->addr.sin_port = htons (161);
-	 }
-
-   return (0);
+   return (manager_addr_parse (&agent->addr,host));
 }
 
 void snmp_init_community (snmp_agent_t *agent,char *string)
@@ -116,6 +81,12 @@ void snmp_init_community (snmp_agent_t *agent,char *string)
    agent->community.len = strlen (string);
 }
 
+void snmp_init_arena (snmp_agent_t *agent,snmp_arena_t *arena)
+{
+   assert (agent != NULL);
+   agent->arena = arena;
+}
+
 void snmp_close (snmp_agent_t *agent)
 {
    assert (agent != NULL);
@@ -291,7 +262,7 @@ int snmp_get (snmp_agent_t *agent,uint32_t **oid,snmp_value_t *value,size_t n)
 
    result = getpdu (agent,oid,n);
 
-   if (result == SNMP_SUCCESS && pdu_decode (&agent->ber,&agent->pdu,value))
+   if (result == SNMP_SUCCESS && pdu_decode (&agent->ber,&agent->pdu,value,agent->arena))
 	 return (SNMP_ERROR);
 
    return (result);
@@ -308,7 +279,7 @@ int snmp_get_next (snmp_agent_t *agent,uint32_t **oid,snmp_next_value_t *next,si
 
    result = getpdu (agent,oid,n);
 
-   if (result == SNMP_SUCCESS && pdu_decode_next (&agent->ber,&agent->pdu,next))
+   if (result == SNMP_SUCCESS && pdu_decode_next (&agent->ber,&agent->pdu,next,agent->arena))
 	 return (SNMP_ERROR);
 
    return (result);
@@ -0,0 +1,522 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <debug/memory.h>
+
+#include <abz/error.h>
+
+#include <tinysnmp/tinysnmp.h>
+#include <tinysnmp/manager/snmp.h>
+#include <tinysnmp/manager/session.h>
+#include <tinysnmp/manager/table.h>
+#include <ber/ber.h>
+
+#include "oid.h"
+#include "oidcmp.h"
+
+struct cell
+{
+   uint32_t *index;
+   snmp_value_t value;
+};
+
+struct snmp_column
+{
+   uint32_t *oid;					/* the column							*/
+   uint32_t *cursor;				/* the last instance retrieved			*/
+   uint32_t length;					/* sub-identifiers cursor has room for	*/
+   struct cell *cell;				/* instances, sorted by index			*/
+   size_t n,size;
+   int done;
+};
+
+static int value_copy (snmp_value_t *dst,const snmp_value_t *src)
+{
+   *dst = *src;
+
+   if (src->type == BER_OID)
+	 {
+		if ((dst->data.OID = manager_oid_dup (src->data.OID)) == NULL)
+		  return (-1);
+	 }
+   else if (src->type == BER_OCTET_STRING && src->data.OCTET_STRING.len)
+	 {
+		if ((dst->data.OCTET_STRING.buf = mem_alloc (src->data.OCTET_STRING.len)) == NULL)
+		  {
+			 abz_set_error ("failed to allocate memory: %m");
+			 return (-1);
+		  }
+
+		memcpy (dst->data.OCTET_STRING.buf,src->data.OCTET_STRING.buf,src->data.OCTET_STRING.len);
+	 }
+
+   return (0);
+}
+
+static void table_cleanup (snmp_rows_t *rows)
+{
+   struct snmp_column *column;
+   size_t i,j;
+
+   if (rows->column != NULL)
+	 {
+		for (i = 0; i < rows->ncolumns; i++)
+		  {
+			 column = rows->column + i;
+
+			 for (j = 0; j < column->n; j++)
+			   {
+				  mem_free (column->cell[j].index);
+				  snmp_free (&column->cell[j].value,1);
+			   }
+
+			 if (column->cell != NULL)
+			   mem_free (column->cell);
+
+			 if (column->cursor != NULL)
+			   mem_free (column->cursor);
+
+			 if (column->oid != NULL)
+			   mem_free (column->oid);
+		  }
+
+		mem_free (rows->column);
+		rows->column = NULL;
+	 }
+
+   if (rows->active != NULL)
+	 {
+		mem_free (rows->active);
+		rows->active = NULL;
+	 }
+
+   if (rows->oid != NULL)
+	 {
+		mem_free (rows->oid);
+		rows->oid = NULL;
+	 }
+}
+
+static void table_fail (snmp_rows_t *rows)
+{
+   if (!rows->status)
+	 {
+		snprintf (rows->error,sizeof (rows->error),"%s",abz_get_error ());
+		rows->status = -1;
+	 }
+}
+
+static void table_response (snmp_session_t *session,const snmp_response_t *response,void *arg);
+
+/*
+ * Ask for the next instance of every column that hasn't been
+ * exhausted yet. Returns 0 if a request was sent, 1 if all the
+ * columns are done, or -1 if some error occurred.
+ */
+static int table_request (snmp_rows_t *rows)
+{
+   int result;
+   size_t i;
+
+   for (rows->nactive = i = 0; i < rows->ncolumns; i++)
+	 if (!rows->column[i].done)
+	   {
+		  rows->active[rows->nactive] = i;
+		  rows->oid[rows->nactive++] = rows->column[i].cursor;
+	   }
+
+   if (!rows->nactive)
+	 return (1);
+
+   if (rows->repetitions && rows->peer->version != SNMP_VERSION_1)
+	 result = snmp_session_get_bulk (rows->session,rows->peer,rows->oid,rows->nactive,0,rows->repetitions,table_response,rows);
+   else
+	 result = snmp_session_get_next (rows->session,rows->peer,rows->oid,rows->nactive,table_response,rows);
+
+   if (result)
+	 {
+		table_fail (rows);
+		return (-1);
+	 }
+
+   return (0);
+}
+
+static void table_add (snmp_rows_t *rows,struct snmp_column *column,const snmp_next_value_t *next)
+{
+   struct cell *cell;
+
+   if (next->value.type == noSuchObject ||
+	   next->value.type == noSuchInstance ||
+	   next->value.type == endOfMibView ||
+	   next->oid[0] <= column->oid[0] ||
+	   memcmp (next->oid + 1,column->oid + 1,column->oid[0] * sizeof (uint32_t)))
+	 {
+		column->done = 1;
+		return;
+	 }
+
+   if (oidcmp (next->oid,column->cursor) <= 0)
+	 {
+		abz_set_error ("agent returned object identifiers out of order");
+		table_fail (rows);
+		return;
+	 }
+
+   if (column->n == column->size)
+	 {
+		column->size = column->size ? column->size << 1 : 64;
+
+		if ((cell = mem_realloc (column->cell,column->size * sizeof (struct cell))) == NULL)
+		  {
+			 abz_set_error ("failed to allocate memory: %m");
+			 table_fail (rows);
+			 return;
+		  }
+
+		column->cell = cell;
+	 }
+
+   cell = column->cell + column->n;
+
+   if ((cell->index = mem_alloc ((next->oid[0] - column->oid[0] + 1) * sizeof (uint32_t))) == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		table_fail (rows);
+		return;
+	 }
+
+   cell->index[0] = next->oid[0] - column->oid[0];
+   memcpy (cell->index + 1,next->oid + column->oid[0] + 1,cell->index[0] * sizeof (uint32_t));
+
+   if (value_copy (&cell->value,&next->value))
+	 {
+		mem_free (cell->index);
+		table_fail (rows);
+		return;
+	 }
+
+   if (manager_oid_copy (&column->cursor,&column->length,next->oid))
+	 {
+		mem_free (cell->index);
+		snmp_free (&cell->value,1);
+		table_fail (rows);
+		return;
+	 }
+
+   column->n++;
+}
+
+static void table_process (snmp_rows_t *rows,const snmp_response_t *response)
+{
+   struct snmp_column *column;
+   size_t i;
+
+   if (response->status != SNMP_SUCCESS)
+	 {
+		table_fail (rows);
+		return;
+	 }
+
+   /* SNMPv1 agents tell us which column was exhausted with noSuchName */
+   if (response->ErrorStatus == noSuchName && rows->peer->version == SNMP_VERSION_1)
+	 {
+		if (response->ErrorIndex < 1 || response->ErrorIndex > rows->nactive)
+		  {
+			 abz_set_error ("agent returned invalid error index %d",response->ErrorIndex);
+			 table_fail (rows);
+			 return;
+		  }
+
+		rows->column[rows->active[response->ErrorIndex - 1]].done = 1;
+		return;
+	 }
+
+   if (response->ErrorStatus != noError)
+	 {
+		if (rows->repetitions && rows->peer->version != SNMP_VERSION_1)
+		  {
+			 /* try again with GetNextRequests */
+			 rows->repetitions = 0;
+			 return;
+		  }
+
+		abz_set_error ("agent returned error status %d",response->ErrorStatus);
+		table_fail (rows);
+		return;
+	 }
+
+   if (!response->n)
+	 {
+		abz_set_error ("agent returned no variable bindings");
+		table_fail (rows);
+		return;
+	 }
+
+   /*
+	* GetBulkRequest repetitions are interleaved column by column. the
+	* agent may truncate the response anywhere, in which case the columns
+	* it left out are simply asked for again
+	*/
+   for (i = 0; i < response->n && !rows->status; i++)
+	 {
+		column = rows->column + rows->active[i % rows->nactive];
+
+		if (!column->done)
+		  table_add (rows,column,response->next + i);
+	 }
+}
+
+/*
+ * Find the smallest index that hasn't been assigned to a row yet.
+ */
+static const uint32_t *table_min (const snmp_rows_t *rows,const size_t *pos)
+{
+   const uint32_t *min = NULL,*index;
+   size_t i;
+
+   for (i = 0; i < rows->ncolumns; i++)
+	 if (pos[i] < rows->column[i].n)
+	   {
+		  index = rows->column[i].cell[pos[i]].index;
+
+		  if (min == NULL || oidcmp (index,min) < 0)
+			min = index;
+	   }
+
+   return (min);
+}
+
+/*
+ * Merge the (sorted) instances of all the columns into rows.
+ */
+static void table_assemble (snmp_rows_t *rows)
+{
+   struct snmp_column *column;
+   const uint32_t *min;
+   size_t i,*pos,row;
+
+   if ((pos = mem_alloc (rows->ncolumns * sizeof (size_t))) == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		table_fail (rows);
+		return;
+	 }
+
+   memset (pos,0L,rows->ncolumns * sizeof (size_t));
+
+   for (rows->nrows = 0; (min = table_min (rows,pos)) != NULL; rows->nrows++)
+	 for (i = 0; i < rows->ncolumns; i++)
+	   if (pos[i] < rows->column[i].n && !oidcmp (rows->column[i].cell[pos[i]].index,min))
+		 pos[i]++;
+
+   rows->index = mem_alloc ((rows->nrows + 1) * sizeof (uint32_t *));
+
+   if ((rows->value = mem_alloc (rows->ncolumns * sizeof (snmp_value_t *))) != NULL)
+	 for (i = 0; i < rows->ncolumns; i++)
+	   if ((rows->value[i] = mem_alloc ((rows->nrows + 1) * sizeof (snmp_value_t))) == NULL)
+		 break;
+
+   if (rows->index == NULL || rows->value == NULL || i < rows->ncolumns)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		table_fail (rows);
+
+		if (rows->value != NULL)
+		  {
+			 while (i)
+			   mem_free (rows->value[--i]);
+
+			 mem_free (rows->value);
+			 rows->value = NULL;
+		  }
+
+		if (rows->index != NULL)
+		  {
+			 mem_free (rows->index);
+			 rows->index = NULL;
+		  }
+
+		rows->nrows = 0;
+		mem_free (pos);
+		return;
+	 }
+
+   /* the cells are moved into the rows, so nothing is copied */
+   memset (pos,0L,rows->ncolumns * sizeof (size_t));
+
+   for (row = 0; (min = table_min (rows,pos)) != NULL; row++)
+	 {
+		rows->index[row] = NULL;
+
+		for (i = 0; i < rows->ncolumns; i++)
+		  {
+			 column = rows->column + i;
+
+			 if (pos[i] < column->n && !oidcmp (column->cell[pos[i]].index,min))
+			   {
+				  rows->value[i][row] = column->cell[pos[i]].value;
+
+				  if (rows->index[row] == NULL)
+					rows->index[row] = column->cell[pos[i]].index;
+				  else
+					mem_free (column->cell[pos[i]].index);
+
+				  pos[i]++;
+			   }
+			 else
+			   {
+				  memset (rows->value[i] + row,0L,sizeof (snmp_value_t));
+				  rows->value[i][row].type = SNMP_HOLE;
+				  rows->holes++;
+			   }
+		  }
+	 }
+
+   for (i = 0; i < rows->ncolumns; i++)
+	 rows->column[i].n = 0;
+
+   mem_free (pos);
+}
+
+static void table_response (snmp_session_t *session,const snmp_response_t *response,void *arg)
+{
+   snmp_rows_t *rows = arg;
+
+   table_process (rows,response);
+
+   if (!rows->status && !table_request (rows))
+	 return;
+
+   if (!rows->status)
+	 table_assemble (rows);
+
+   table_cleanup (rows);
+
+   if (rows->status)
+	 abz_set_error ("%s",rows->error);
+
+   rows->done (rows,rows->status);
+}
+
+void snmp_rows_init (snmp_rows_t *rows)
+{
+   assert (rows != NULL);
+   memset (rows,0L,sizeof (snmp_rows_t));
+   rows->repetitions = 10;
+}
+
+int snmp_session_table (snmp_session_t *session,snmp_rows_t *rows,snmp_peer_t *peer,uint32_t **column,size_t n)
+{
+   size_t i;
+
+   assert (session != NULL && rows != NULL && peer != NULL && column != NULL && n);
+   assert (rows->done != NULL);
+
+   abz_clear_error ();
+
+   rows->session = session;
+   rows->peer = peer;
+   rows->ncolumns = n;
+   rows->nrows = 0;
+   rows->index = NULL;
+   rows->value = NULL;
+   rows->holes = 0;
+   rows->status = 0;
+
+   rows->active = mem_alloc (n * sizeof (size_t));
+   rows->oid = mem_alloc (n * sizeof (uint32_t *));
+
+   if ((rows->column = mem_alloc (n * sizeof (struct snmp_column))) != NULL)
+	 memset (rows->column,0L,n * sizeof (struct snmp_column));
+
+   if (rows->active == NULL || rows->oid == NULL || rows->column == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		table_cleanup (rows);
+		return (-1);
+	 }
+
+   for (i = 0; i < n; i++)
+	 {
+		if ((rows->column[i].oid = manager_oid_dup (column[i])) == NULL ||
+			(rows->column[i].cursor = manager_oid_dup (column[i])) == NULL)
+		  {
+			 table_cleanup (rows);
+			 return (-1);
+		  }
+
+		rows->column[i].length = column[i][0];
+	 }
+
+   if (table_request (rows))
+	 {
+		table_cleanup (rows);
+		abz_set_error ("%s",rows->error);
+		return (-1);
+	 }
+
+   return (0);
+}
+
+void snmp_rows_free (snmp_rows_t *rows)
+{
+   size_t i;
+
+   assert (rows != NULL);
+
+   if (rows->index != NULL)
+	 {
+		for (i = 0; i < rows->nrows; i++)
+		  mem_free (rows->index[i]);
+
+		mem_free (rows->index);
+		rows->index = NULL;
+	 }
+
+   if (rows->value != NULL)
+	 {
+		for (i = 0; i < rows->ncolumns; i++)
+		  {
+			 snmp_free (rows->value[i],rows->nrows);
+			 mem_free (rows->value[i]);
+		  }
+
+		mem_free (rows->value);
+		rows->value = NULL;
+	 }
+
+   rows->nrows = rows->holes = 0;
+}
@@ -0,0 +1,391 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <debug/memory.h>
+
+#include <abz/error.h>
+
+#include <tinysnmp/tinysnmp.h>
+#include <tinysnmp/manager/snmp.h>
+#include <tinysnmp/manager/session.h>
+#include <tinysnmp/manager/walk.h>
+#include <ber/ber.h>
+
+#include "oid.h"
+#include "oidcmp.h"
+
+struct snmp_segment
+{
+   struct snmp_segment *next;
+   snmp_walk_t *walk;
+   uint32_t *cursor;				/* last object identifier retrieved (or the start)			*/
+   uint32_t size;					/* number of sub-identifiers cursor has room for			*/
+   uint32_t *end;					/* last object identifier in segment, NULL if unbounded		*/
+   int busy;
+   int done;
+};
+
+/* a root of 0 (the same as the tools accept) means the whole mib */
+static int subtree (const uint32_t *root,const uint32_t *oid)
+{
+   if (root[0] == 1 && root[1] == 0)
+	 return (1);
+
+   return (oid[0] > root[0] && !memcmp (oid + 1,root + 1,root[0] * sizeof (uint32_t)));
+}
+
+static struct snmp_segment *segment_alloc (snmp_walk_t *walk,const uint32_t *cursor)
+{
+   struct snmp_segment *segment;
+
+   if ((segment = mem_alloc (sizeof (struct snmp_segment))) == NULL)
+	 {
+		abz_set_error ("failed to allocate memory: %m");
+		return (NULL);
+	 }
+
+   if ((segment->cursor = manager_oid_dup (cursor)) == NULL)
+	 {
+		mem_free (segment);
+		return (NULL);
+	 }
+
+   segment->size = cursor[0];
+   segment->next = NULL;
+   segment->walk = walk;
+   segment->end = NULL;
+   segment->busy = segment->done = 0;
+
+   return (segment);
+}
+
+static void walk_free (snmp_walk_t *walk)
+{
+   struct snmp_segment *segment;
+
+   while ((segment = walk->segment) != NULL)
+	 {
+		walk->segment = segment->next;
+
+		if (segment->end != NULL)
+		  mem_free (segment->end);
+
+		mem_free (segment->cursor);
+		mem_free (segment);
+	 }
+
+   if (walk->root != NULL)
+	 {
+		mem_free (walk->root);
+		walk->root = NULL;
+	 }
+}
+
+static void walk_fail (snmp_walk_t *walk)
+{
+   if (walk->status >= 0)
+	 {
+		snprintf (walk->error,sizeof (walk->error),"%s",abz_get_error ());
+		walk->status = -1;
+	 }
+}
+
+static void walk_response (snmp_session_t *session,const snmp_response_t *response,void *arg);
+
+static int walk_request (snmp_walk_t *walk,struct snmp_segment *segment)
+{
+   int result;
+
+   if (walk->repetitions && walk->peer->version != SNMP_VERSION_1)
+	 result = snmp_session_get_bulk (walk->session,walk->peer,&segment->cursor,1,0,walk->repetitions,walk_response,segment);
+   else
+	 result = snmp_session_get_next (walk->session,walk->peer,&segment->cursor,1,walk_response,segment);
+
+   if (result)
+	 {
+		walk_fail (walk);
+		return (-1);
+	 }
+
+   segment->busy = 1;
+   walk->outstanding++;
+
+   return (0);
+}
+
+/*
+ * Split the segment at the second level below the root, behind
+ * the last object we've seen, so that another request can start
+ * at the next column of a table while this one finishes the
+ * current column.
+ */
+static void walk_split (snmp_walk_t *walk,struct snmp_segment *segment)
+{
+   const struct snmp_segment *tmp;
+   struct snmp_segment *split;
+   uint32_t depth = walk->root[0] + 2,live = 0;
+   uint32_t *end;
+
+   for (tmp = walk->segment; tmp != NULL; tmp = tmp->next)
+	 live += !tmp->done;
+
+   if (live >= walk->window || segment->cursor[0] <= depth)
+	 return;
+
+   if ((end = mem_alloc ((depth + 2) * sizeof (uint32_t))) == NULL)
+	 return;
+
+   memcpy (end,segment->cursor,(depth + 1) * sizeof (uint32_t));
+   end[0] = depth + 1;
+   end[depth + 1] = UINT32_MAX;
+
+   if (oidcmp (end,segment->cursor) <= 0 ||
+	   (segment->end != NULL && oidcmp (end,segment->end) >= 0) ||
+	   (split = segment_alloc (walk,end)) == NULL)
+	 {
+		mem_free (end);
+		return;
+	 }
+
+   split->end = segment->end;
+   segment->end = end;
+
+   split->next = segment->next;
+   segment->next = split;
+}
+
+static void walk_process (snmp_walk_t *walk,struct snmp_segment *segment,const snmp_response_t *response)
+{
+   const snmp_next_value_t *next;
+   size_t i;
+
+   if (response->status != SNMP_SUCCESS)
+	 {
+		walk_fail (walk);
+		return;
+	 }
+
+   /* SNMPv1 agents signal the end of the mib view with noSuchName */
+   if (response->ErrorStatus == noSuchName && walk->peer->version == SNMP_VERSION_1)
+	 {
+		segment->done = 1;
+		return;
+	 }
+
+   if (response->ErrorStatus != noError)
+	 {
+		if (walk->repetitions && walk->peer->version != SNMP_VERSION_1)
+		  {
+			 /* try again with GetNextRequests */
+			 walk->repetitions = 0;
+			 return;
+		  }
+
+		abz_set_error ("agent returned error status %d",response->ErrorStatus);
+		walk_fail (walk);
+		return;
+	 }
+
+   if (!response->n)
+	 {
+		segment->done = 1;
+		return;
+	 }
+
+   for (i = 0; i < response->n; i++)
+	 {
+		next = response->next + i;
+
+		if (next->value.type == noSuchObject ||
+			next->value.type == noSuchInstance ||
+			next->value.type == endOfMibView ||
+			!subtree (walk->root,next->oid) ||
+			(segment->end != NULL && oidcmp (next->oid,segment->end) > 0))
+		  {
+			 segment->done = 1;
+			 return;
+		  }
+
+		if (oidcmp (next->oid,segment->cursor) <= 0)
+		  {
+			 abz_set_error ("agent returned object identifiers out of order");
+			 walk_fail (walk);
+			 return;
+		  }
+
+		if (manager_oid_copy (&segment->cursor,&segment->size,next->oid))
+		  {
+			 walk_fail (walk);
+			 return;
+		  }
+
+		if (walk->found (walk,next))
+		  {
+			 walk->status = 1;
+			 return;
+		  }
+	 }
+
+   walk_split (walk,segment);
+}
+
+static void walk_schedule (snmp_walk_t *walk)
+{
+   struct snmp_segment *segment;
+
+   for (segment = walk->segment; !walk->status && segment != NULL; segment = segment->next)
+	 {
+		if (walk->outstanding >= walk->window)
+		  break;
+
+		if (!segment->done && !segment->busy)
+		  walk_request (walk,segment);
+	 }
+}
+
+static void walk_response (snmp_session_t *session,const snmp_response_t *response,void *arg)
+{
+   struct snmp_segment *segment = arg;
+   snmp_walk_t *walk = segment->walk;
+
+   segment->busy = 0;
+   walk->outstanding--;
+
+   if (!walk->status)
+	 walk_process (walk,segment,response);
+
+   walk_schedule (walk);
+
+   if (!walk->outstanding)
+	 {
+		walk_free (walk);
+
+		if (walk->status < 0)
+		  abz_set_error ("%s",walk->error);
+
+		walk->done (walk,walk->status < 0 ? -1 : 0);
+	 }
+}
+
+void snmp_walk_init (snmp_walk_t *walk)
+{
+   assert (walk != NULL);
+   memset (walk,0L,sizeof (snmp_walk_t));
+   walk->window = 1;
+   walk->repetitions = 10;
+}
+
+static int compare (const void *a,const void *b)
+{
+   return (oidcmp (*(uint32_t * const *) a,*(uint32_t * const *) b));
+}
+
+int snmp_session_walk (snmp_session_t *session,snmp_walk_t *walk,snmp_peer_t *peer,const uint32_t *oid)
+{
+   struct snmp_segment **segment;
+   uint32_t **split = NULL;
+   size_t i;
+
+   assert (session != NULL && walk != NULL && peer != NULL && oid != NULL);
+   assert (walk->found != NULL && walk->done != NULL && walk->window);
+
+   abz_clear_error ();
+
+   walk->session = session;
+   walk->peer = peer;
+   walk->segment = NULL;
+   walk->outstanding = 0;
+   walk->status = 0;
+
+   if ((walk->root = manager_oid_dup (oid)) == NULL ||
+	   (walk->segment = segment_alloc (walk,oid)) == NULL)
+	 {
+		walk_free (walk);
+		return (-1);
+	 }
+
+   if (walk->n)
+	 {
+		if ((split = mem_alloc (walk->n * sizeof (uint32_t *))) == NULL)
+		  {
+			 abz_set_error ("failed to allocate memory: %m");
+			 walk_free (walk);
+			 return (-1);
+		  }
+
+		memcpy (split,walk->split,walk->n * sizeof (uint32_t *));
+		qsort (split,walk->n,sizeof (uint32_t *),compare);
+	 }
+
+   /* each split point ends one segment and starts the next */
+   for (segment = &walk->segment, i = 0; i < walk->n; i++)
+	 {
+		if (!subtree (walk->root,split[i]))
+		  {
+			 abz_set_error ("split point outside of subtree");
+			 break;
+		  }
+
+		if (i && !oidcmp (split[i - 1],split[i]))
+		  continue;
+
+		if (((*segment)->end = manager_oid_dup (split[i])) == NULL ||
+			((*segment)->next = segment_alloc (walk,split[i])) == NULL)
+		  break;
+
+		segment = &(*segment)->next;
+	 }
+
+   if (split != NULL)
+	 mem_free (split);
+
+   if (i < walk->n)
+	 {
+		walk_free (walk);
+		return (-1);
+	 }
+
+   walk_schedule (walk);
+
+   if (!walk->outstanding)
+	 {
+		abz_set_error ("%s",walk->error);
+		walk_free (walk);
+		return (-1);
+	 }
+
+   return (0);
+}
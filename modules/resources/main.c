@@ -279,3 +279,5 @@ struct module module =
    .close	= res_close
 };
 
+const uint32_t module_abi = MODULE_ABI;
+
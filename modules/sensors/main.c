@@ -57,3 +57,5 @@ struct module module =
    .close	= NULL
 };
 
+const uint32_t module_abi = MODULE_ABI;
+
@@ -43,6 +43,7 @@
 #include <tinysnmp/tinysnmp.h>
 #include <tinysnmp/agent/odb.h>
 #include <tinysnmp/agent/module.h>
+#include <tinysnmp/agent/notify.h>
 
 #include <abz/typedefs.h>
 #include <abz/error.h>
@@ -101,6 +102,15 @@ static struct sockaddr_in apcupsd;
 static char *identifier = NULL;
 static char *attached = NULL;
 
+/* low battery threshold assigned by set requests (or -1 if none) */
+static int32_t lowbatt = -1;
+
+/* alarms present after the last update (or -1 before the first one) */
+static int32_t present = -1;
+
+/* ups status flags of the update which is about to be published */
+static unsigned int latest = 0;
+
 /* scalar object identifiers */
 static const uint32_t upsIdentManufacturer[11] = { 10, 43, 6, 1, 2, 1, 33, 1, 1, 1, 0 };
 static const uint32_t upsIdentModel[11] = { 10, 43, 6, 1, 2, 1, 33, 1, 1, 2, 0 };
@@ -209,6 +219,10 @@ static uint32_t upsAlarmDiagnosticTestFailed[11] = { 10, 43, 6, 1, 2, 1, 33, 1,
 static uint32_t upsAlarmCommunicationsLost[11] = { 10, 43, 6, 1, 2, 1, 33, 1, 6, 3, 20 };
 static uint32_t upsAlarmShutdownImminent[11] = { 10, 43, 6, 1, 2, 1, 33, 1, 6, 3, 23 };
 
+/* notification object identifiers */
+static const uint32_t upsTrapAlarmEntryAdded[10] = { 9, 43, 6, 1, 2, 1, 33, 2, 0, 3 };
+static const uint32_t upsTrapAlarmEntryRemoved[10] = { 9, 43, 6, 1, 2, 1, 33, 2, 0, 4 };
+
 static const struct alarm alarms[] =
 {
    { upsAlarmBatteryBad, UPS_REPLACEBATT },
@@ -244,6 +258,9 @@ static int ups_open (void)
    apcupsd.sin_addr.s_addr = INADDR_NONE;
    identifier = NULL;
    attached = NULL;
+   lowbatt = -1;
+   present = -1;
+   latest = 0;
 
    return (0);
 }
@@ -851,7 +868,9 @@ static int config_lowtime (snmp_value_t *value,char *str)
 {
    int minutes;
 
-   if (sscanf (str,"%d Minutes",&minutes) != 1 || minutes < 0)
+   /* a threshold assigned by a set request overrides that of the ups */
+   if ((minutes = __atomic_load_n (&lowbatt,__ATOMIC_RELAXED)) < 0 &&
+	   (sscanf (str,"%d Minutes",&minutes) != 1 || minutes < 0))
 	 {
 		abz_set_error ("invalid low-batt time: %s",str);
 		return (-1);
@@ -979,12 +998,58 @@ static int update_alarms (struct odb **odb,unsigned int status)
    return (0);
 }
 
+/*
+ * Send upsTrapAlarmEntryAdded or upsTrapAlarmEntryRemoved for each
+ * alarm which appeared or went away since the last update. Nothing
+ * is sent after the first update, since we don't know what changed.
+ * This is only done once the new upsAlarmTable is published, so that
+ * a manager which reacts to the trap finds the alarms it describes.
+ */
+static void ups_published (void)
+{
+   uint32_t id[13],descr[13];
+   snmp_next_value_t varbind[2];
+   int32_t previous,current = 0;
+   size_t i;
+
+   for (i = 0; i < ARRAYSIZE (alarms); i++)
+	 if (latest & alarms[i].mask)
+	   current |= 1 << i;
+
+   previous = present;
+   present = current;
+
+   if (previous < 0 || previous == current)
+	 return;
+
+   memcpy (id,upsAlarmId,sizeof (id));
+   memcpy (descr,upsAlarmDescr,sizeof (descr));
+
+   varbind[0].oid = id;
+   varbind[0].value.type = BER_INTEGER;
+   varbind[1].oid = descr;
+   varbind[1].value.type = BER_OID;
+
+   for (i = 0; i < ARRAYSIZE (alarms); i++)
+	 if ((previous ^ current) & (1 << i))
+	   {
+		  id[12] = descr[12] = i + 1;
+		  varbind[0].value.data.INTEGER = i + 1;
+		  varbind[1].value.data.OID = alarms[i].oid;
+
+		  notify_send (current & (1 << i) ? upsTrapAlarmEntryAdded : upsTrapAlarmEntryRemoved,
+					   varbind,ARRAYSIZE (varbind));
+	   }
+}
+
 static int ups_update (struct odb **odb)
 {
    static char buf[BUFFER_SIZE];
    char *arg;
    int fd,result;
    unsigned int s1 = 0,s2 = 0;
+   float timeleft = -1;
+   int32_t minutes;
 
    if (update_static (odb))
 	 return (-1);
@@ -1027,16 +1092,61 @@ static int ups_update (struct odb **odb)
 
 		if (!strcmp (buf,"SELFTEST") && (!strcmp (arg,"BT") || !strcmp (arg,"NG")))
 		  s2 = UPS_SELFTEST;
+
+		if (!strcmp (buf,"TIMELEFT") && sscanf (arg,"%f Minutes",&timeleft) != 1)
+		  timeleft = -1;
 	 }
 
    apc_close (fd);
 
-   if (!result)
-	 result = update_alarms (odb,s1 | s2);
+   /* declare a low battery condition at the threshold assigned to us */
+   if ((minutes = __atomic_load_n (&lowbatt,__ATOMIC_RELAXED)) >= 0 &&
+	   (s1 & UPS_ONBATT) && timeleft >= 0 && timeleft <= minutes)
+	 s1 |= UPS_BATTLOW;
+
+   if (!result && !(result = update_alarms (odb,s1 | s2)))
+	 latest = s1 | s2;
 
    return (result);
 }
 
+/*
+ * apcupsd doesn't let us change the configuration of the ups, so the
+ * low battery threshold is applied by the module itself. It is not
+ * saved anywhere and reverts to that of the ups when the agent is
+ * restarted.
+ */
+static int ups_set (int phase,const uint32_t *oid,const snmp_value_t *value)
+{
+   static int32_t saved;
+
+   if (oid[0] != upsConfigLowBattTime[0] ||
+	   memcmp (oid,upsConfigLowBattTime,sizeof (upsConfigLowBattTime)))
+	 return (notWritable);
+
+   switch (phase)
+	 {
+	  case MODULE_SET_TEST:
+		if (value->type != BER_INTEGER)
+		  return (wrongType);
+
+		if (value->data.INTEGER < 0)
+		  return (wrongValue);
+
+		saved = __atomic_load_n (&lowbatt,__ATOMIC_RELAXED);
+		break;
+
+	  case MODULE_SET_COMMIT:
+		__atomic_store_n (&lowbatt,value->data.INTEGER,__ATOMIC_RELAXED);
+		break;
+
+	  case MODULE_SET_UNDO:
+		__atomic_store_n (&lowbatt,saved,__ATOMIC_RELAXED);
+	 }
+
+   return (noError);
+}
+
 /* iso.org.dod.internet.mgmt.mib-2.upsMIB.upsObjects */
 static const uint32_t upsObjects[8] = { 7, 43, 6, 1, 2, 1, 33, 1 };
 
@@ -1052,6 +1162,10 @@ struct module module =
    .parse	= ups_parse,
    .open	= ups_open,
    .update	= ups_update,
+   .published	= ups_published,
+   .set		= ups_set,
    .close	= ups_close
 };
 
+const uint32_t module_abi = MODULE_ABI;
+
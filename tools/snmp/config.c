@@ -40,7 +40,7 @@
 #include <abz/atou32.h>
 
 #include <tinysnmp/tinysnmp.h>
-#include <tinysnmp/manager/snmp.h>
+#include <tinysnmp/manager/session.h>
 
 #include <ber/ber.h>
 
@@ -69,7 +69,7 @@ static __attribute__ ((noreturn)) void help (const char *progname,int applet,int
    if (verbose)
 	 log_printf (LOG_ERROR,
 				 "\n"
-				 "   -t | --timeout=<seconds>   timeout between operations (default: %u)\n"
+				 "   -t | --timeout=<seconds>   initial timeout of requests (default: %u)\n"
 				 "   -r | --retries=<n>         times to retry sending requests to agent (default: %u)\n"
 				 "   -h | --help                show this help message\n"
 				 "\n",
@@ -120,7 +120,7 @@ struct config *config_parse (int argc,char *argv[])
 	 error ("failed to allocate memory: %m\n");
 
    memset (config,0L,sizeof (struct config));
-   snmp_init (&config->agent);
+   snmp_peer_init (&config->peer);
    config->timeout = TIMEOUT;
    config->retries = RETRIES;
 
@@ -172,10 +172,10 @@ struct config *config_parse (int argc,char *argv[])
    if (optind + 2 > argc)
 	 help (progname,config->applet,0);
 
-   if (snmp_init_addr (&config->agent,argv[optind++]))
+   if (snmp_peer_addr (&config->peer,argv[optind++]))
 	 error ("%s: %s\n",abz_get_error ());
 
-   snmp_init_community (&config->agent,argv[optind++]);
+   snmp_peer_community (&config->peer,argv[optind++]);
 
    config->n = argc - optind;
 
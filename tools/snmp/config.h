@@ -33,13 +33,13 @@
 #include <sys/types.h>
 #include <netinet/in.h>
 
-#include <tinysnmp/manager/snmp.h>
+#include <tinysnmp/manager/session.h>
 
-/* default to 5 seconds */
-#define TIMEOUT 5
+/* wait 1 second for the first response (retransmissions back off) */
+#define TIMEOUT 1
 
-/* default to no retries */
-#define RETRIES 0
+/* retransmit three times */
+#define RETRIES 3
 
 typedef enum
 {
@@ -51,7 +51,7 @@ typedef enum
 struct config
 {
    applet_t applet;
-   snmp_agent_t agent;
+   snmp_peer_t peer;
    time_t timeout;
    size_t retries;
    uint32_t **oid;
@@ -33,126 +33,97 @@
 #include <debug/memory.h>
 #include <abz/error.h>
 #include <tinysnmp/manager/snmp.h>
+#include <tinysnmp/manager/session.h>
+#include <tinysnmp/manager/walk.h>
 
 #include "config.h"
 #include "show.h"
 
-static int snmpget (struct config *config)
-{
-   snmp_value_t *value;
-   size_t i;
+static snmp_session_t session;
+static int failed;
 
-   if ((value = mem_alloc (config->n * sizeof (snmp_value_t))) == NULL)
+static int response_error (const snmp_response_t *response)
+{
+   if (response->status != SNMP_SUCCESS)
 	 {
-		log_printf (LOG_ERROR,"failed to allocate memory: %m\n");
-		return (-1);
+		log_printf (LOG_WARNING,"%s\n",abz_get_error ());
+		failed = 1;
+		return (1);
 	 }
 
-   for (i = 0; i <= config->retries; i++)
+   if (response->ErrorStatus != noError)
 	 {
-		if (!snmp_get_s (&config->agent,config->oid,value,config->n,config->timeout))
-		  {
-			 for (i = 0; i < config->n; i++)
-			   show (config->oid[i],value + i);
-
-			 snmp_free (value,config->n);
-			 mem_free (value);
-
-			 return (0);
-		  }
-
-		log_printf (LOG_WARNING,"%s\n",abz_get_error ());
+		log_printf (LOG_WARNING,
+					"agent returned error status %d (index %d)\n",
+					response->ErrorStatus,response->ErrorIndex);
+		failed = 1;
+		return (1);
 	 }
 
-   mem_free (value);
    return (0);
 }
 
-static int snmpgetnext (struct config *config)
+static void show_response (snmp_session_t *session,const snmp_response_t *response,void *arg)
 {
-   snmp_next_value_t *next;
    size_t i;
 
-   if ((next = mem_alloc (config->n * sizeof (snmp_next_value_t))) == NULL)
+   if (!response_error (response))
+	 for (i = 0; i < response->n; i++)
+	   show (response->next[i].oid,&response->next[i].value);
+}
+
+static int snmpget (struct config *config)
+{
+   if (snmp_session_get (&session,&config->peer,config->oid,config->n,show_response,config))
 	 {
-		log_printf (LOG_ERROR,"failed to allocate memory: %m\n");
+		log_printf (LOG_ERROR,"%s\n",abz_get_error ());
 		return (-1);
 	 }
 
-   for (i = 0; i <= config->retries; i++)
-	 {
-		if (!snmp_get_next_s (&config->agent,config->oid,next,config->n,config->timeout))
-		  {
-			 for (i = 0; i < config->n; i++)
-			   show (next[i].oid,&next[i].value);
-
-			 snmp_free_next (next,config->n);
-			 mem_free (next);
-
-			 return (0);
-		  }
+   return (0);
+}
 
-		log_printf (LOG_WARNING,"%s\n",abz_get_error ());
+static int snmpgetnext (struct config *config)
+{
+   if (snmp_session_get_next (&session,&config->peer,config->oid,config->n,show_response,config))
+	 {
+		log_printf (LOG_ERROR,"%s\n",abz_get_error ());
+		return (-1);
 	 }
 
-   mem_free (next);
    return (0);
 }
 
-static int subtree (const uint32_t *base,const uint32_t *leaf)
+static int found (snmp_walk_t *walk,const snmp_next_value_t *next)
 {
-   uint32_t i = 0;
-
-   if (base[0] == 1 && base[1] == 0)
-	 return (1);
-
-   if (base[i] >= leaf[0])
-	 return (0);
-
-   for (i = 1; i <= base[0]; i++)
-	 if (base[i] != leaf[i])
-	   return (0);
-
-   return (1);
+   show (next->oid,&next->value);
+   return (0);
 }
 
-static int snmpwalk (struct config *config)
+static void done (snmp_walk_t *walk,int status)
 {
-   snmp_next_value_t prev,next;
-   size_t i;
-
-   for (i = 0; i <= config->retries; i++)
+   if (status)
 	 {
-		if (!snmp_get_next_s (&config->agent,config->oid,&next,1,config->timeout))
-		  break;
-
 		log_printf (LOG_WARNING,"%s\n",abz_get_error ());
+		failed = 1;
 	 }
+}
 
-   if (i > config->retries)
-	 return (-1);
-
-   while (next.value.type != BER_NULL && subtree (config->oid[0],next.oid))
-	 {
-		show (next.oid,&next.value);
-		prev = next;
-
-		for (i = 0; i <= config->retries; i++)
-		  {
-			 if (!snmp_get_next_s (&config->agent,&prev.oid,&next,1,config->timeout))
-			   break;
-
-			 log_printf (LOG_WARNING,"%s\n",abz_get_error ());
-		  }
+static int snmpwalk (struct config *config)
+{
+   static snmp_walk_t walk;
 
-		snmp_free_next (&prev,1);
+   /* a window of one keeps the output in order */
+   snmp_walk_init (&walk);
+   walk.found = found;
+   walk.done = done;
 
-		if (i > config->retries)
-		  return (-1);
+   if (snmp_session_walk (&session,&walk,&config->peer,config->oid[0]))
+	 {
+		log_printf (LOG_ERROR,"%s\n",abz_get_error ());
+		return (-1);
 	 }
 
-   snmp_free_next (&next,1);
-
    return (0);
 }
 
@@ -175,16 +146,30 @@ int main (int argc,char *argv[])
    config = config_parse (argc,argv);
    atexit (config_destroy);
 
-   if (snmp_open_s (&config->agent,config->timeout))
+   if (snmp_session_open (&session,1))
 	 {
 		log_printf (LOG_ERROR,"%s\n",abz_get_error ());
 		exit (EXIT_FAILURE);
 	 }
 
-   result = callback[config->applet] (config);
+   session.timeout = config->timeout * 1000;
+   session.retries = config->retries;
 
-   snmp_close (&config->agent);
+   if (session.timeout_max < session.timeout)
+	 session.timeout_max = session.timeout;
+
+   if ((result = callback[config->applet] (config)) == 0)
+	 {
+		if (snmp_session_run (&session))
+		  {
+			 log_printf (LOG_ERROR,"%s\n",abz_get_error ());
+			 result = -1;
+		  }
+		else if (failed)
+		  result = -1;
+	 }
+
+   snmp_session_close (&session);
 
    exit (result ? EXIT_FAILURE : EXIT_SUCCESS);
 }
-
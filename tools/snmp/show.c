@@ -141,10 +141,21 @@ static void show_null (const char *filename,int line,const char *function,
    my_puts ("No Such Name");
 }
 
+static void show_exception (const char *filename,int line,const char *function,
+							int level,const snmp_value_t *value)
+{
+   if (value->type == noSuchObject)
+	 my_puts ("No Such Object");
+   else if (value->type == noSuchInstance)
+	 my_puts ("No Such Instance");
+   else
+	 my_puts ("End of MIB View");
+}
+
 void show_stub (const char *filename,int line,const char *function,
 				const uint32_t *oid,const snmp_value_t *value)
 {
-   int level = value->type == BER_NULL ? LOG_WARNING : LOG_NORMAL;
+   int level = value->type == BER_NULL || value->type >= noSuchObject ? LOG_WARNING : LOG_NORMAL;
    static const struct
 	 {
 		uint8_t type;
@@ -159,7 +170,10 @@ void show_stub (const char *filename,int line,const char *function,
 		{ BER_OID, show_oid },
 		{ BER_OCTET_STRING, show_octet_string },
 		{ BER_IpAddress, show_ipaddress },
-		{ BER_NULL, show_null }
+		{ BER_NULL, show_null },
+		{ noSuchObject, show_exception },
+		{ noSuchInstance, show_exception },
+		{ endOfMibView, show_exception }
 	 };
    size_t i;
 
@@ -43,6 +43,10 @@ ifeq ($(RESOLVE),"yes")
 CPPFLAGS += -DGETHOSTBYNAME -DGETSERVBYNAME
 endif	# ifeq ($(RESOLVE),"yes")
 
+ifeq ($(ODB),"array")
+CPPFLAGS += -DODB_ARRAY
+endif	# ifeq ($(ODB),"array")
+
 _STRIP = "yes"
 
 ifeq ($(DEBUG),"yes")